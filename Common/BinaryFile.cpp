@@ -0,0 +1,194 @@
+#include "BinaryFile.h"
+#include <stdexcept>
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+using namespace std;
+
+uint64_t hash_bytes(const char* data, size_t size, uint64_t seed) {
+  uint64_t hash = seed;
+  for (size_t i = 0; i < size; ++i) {
+    hash ^= static_cast<unsigned char>(data[i]);
+    hash *= 1099511628211ULL;
+  }
+  return hash;
+}
+
+
+uint64_t hash_file(const string& path) {
+  MappedFile file(path);
+  return hash_bytes(file.data(), file.size());
+}
+
+
+MappedFile::MappedFile(const string& path) : bytes(nullptr), length(0), mapped(false) {
+#ifndef _WIN32
+  int fd = open(path.c_str(), O_RDONLY);
+  if (fd < 0) throw runtime_error("Could not open file: " + path);
+  struct stat info{};
+  if (fstat(fd, &info) == 0 && info.st_size > 0) {
+    void* address = mmap(nullptr, static_cast<size_t>(info.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+    if (address != MAP_FAILED) {
+      bytes = static_cast<const char*>(address);
+      length = static_cast<size_t>(info.st_size);
+      mapped = true;
+    }
+  }
+  close(fd);
+  if (mapped || info.st_size == 0) return;
+#endif
+  // No mmap (or mapping failed), read the whole file instead
+  ifstream file(path, ios::binary);
+  if (!file.is_open()) throw runtime_error("Could not open file: " + path);
+  fallback.assign(istreambuf_iterator<char>(file), istreambuf_iterator<char>());
+  bytes = fallback.data();
+  length = fallback.size();
+}
+
+
+MappedFile::~MappedFile() {
+#ifndef _WIN32
+  if (mapped) munmap(const_cast<char*>(bytes), length);
+#endif
+}
+
+
+BinaryWriter::BinaryWriter(const string& path) : file(path, ios::binary | ios::trunc), out(&file) {}
+
+
+BinaryWriter::BinaryWriter() : out(&memory) {}
+
+
+void BinaryWriter::write_u8(uint8_t value) {
+  out->put(static_cast<char>(value));
+}
+
+
+void BinaryWriter::write_u32(uint32_t value) {
+  char buffer[4];
+  for (int i = 0; i < 4; ++i) buffer[i] = static_cast<char>((value >> (8 * i)) & 0xFF);
+  out->write(buffer, 4);
+}
+
+
+void BinaryWriter::write_i32(int32_t value) {
+  write_u32(static_cast<uint32_t>(value));
+}
+
+
+void BinaryWriter::write_u64(uint64_t value) {
+  char buffer[8];
+  for (int i = 0; i < 8; ++i) buffer[i] = static_cast<char>((value >> (8 * i)) & 0xFF);
+  out->write(buffer, 8);
+}
+
+
+void BinaryWriter::write_varint(uint64_t value) {
+  while (value >= 0x80) {
+    out->put(static_cast<char>((value & 0x7F) | 0x80));
+    value >>= 7;
+  }
+  out->put(static_cast<char>(value));
+}
+
+
+void BinaryWriter::write_bytes(const char* data, size_t size) {
+  out->write(data, static_cast<streamsize>(size));
+}
+
+
+void BinaryWriter::write_string(const string& value) {
+  write_u32(static_cast<uint32_t>(value.size()));
+  write_bytes(value.data(), value.size());
+}
+
+
+void BinaryWriter::align(size_t alignment) {
+  while (tell() % alignment != 0) out->put('\0');
+}
+
+
+uint64_t BinaryWriter::tell() {
+  return static_cast<uint64_t>(out->tellp());
+}
+
+
+bool BinaryWriter::ok() const {
+  return !out->fail();
+}
+
+
+void BinaryWriter::close() {
+  file.close();
+}
+
+
+BinaryReader::BinaryReader(const char* data, size_t size) : bytes(data), length(size), pos(0) {}
+
+
+void BinaryReader::require(size_t count) const {
+  if (count > length - pos) throw runtime_error("Unexpected end of binary file.");
+}
+
+
+uint8_t BinaryReader::read_u8() {
+  require(1);
+  return static_cast<uint8_t>(bytes[pos++]);
+}
+
+
+uint32_t BinaryReader::read_u32() {
+  require(4);
+  uint32_t value = 0;
+  for (int i = 0; i < 4; ++i) value |= static_cast<uint32_t>(static_cast<unsigned char>(bytes[pos + i])) << (8 * i);
+  pos += 4;
+  return value;
+}
+
+
+int32_t BinaryReader::read_i32() {
+  return static_cast<int32_t>(read_u32());
+}
+
+
+uint64_t BinaryReader::read_u64() {
+  require(8);
+  uint64_t value = 0;
+  for (int i = 0; i < 8; ++i) value |= static_cast<uint64_t>(static_cast<unsigned char>(bytes[pos + i])) << (8 * i);
+  pos += 8;
+  return value;
+}
+
+
+uint64_t BinaryReader::read_varint() {
+  uint64_t value = 0;
+  for (int shift = 0; shift < 64; shift += 7) {
+    uint8_t byte = read_u8();
+    value |= static_cast<uint64_t>(byte & 0x7F) << shift;
+    if ((byte & 0x80) == 0) return value;
+  }
+  throw runtime_error("Malformed varint in binary file.");
+}
+
+
+string BinaryReader::read_string() {
+  uint32_t size = read_u32();
+  return string(read_bytes(size), size);
+}
+
+
+const char* BinaryReader::read_bytes(size_t size) {
+  require(size);
+  const char* start = bytes + pos;
+  pos += size;
+  return start;
+}
+
+
+void BinaryReader::align(size_t alignment) {
+  size_t padding = (alignment - pos % alignment) % alignment;
+  read_bytes(padding);
+}
@@ -0,0 +1,94 @@
+#ifndef BINARY_FILE_H
+#define BINARY_FILE_H
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#include <vector>
+#include <fstream>
+#include <sstream>
+
+/** Returns the 64-bit FNV-1a hash of a byte range, optionally continuing from a previous hash. */
+uint64_t hash_bytes(const char* data, size_t size, uint64_t seed = 14695981039346656037ULL);
+/** Returns the FNV-1a hash of a file's contents. Throws if the file cannot be read. */
+uint64_t hash_file(const std::string& path);
+
+
+/** Read-only view of a whole file. Uses mmap where available and falls back to reading the file into memory. */
+class MappedFile {
+  private:
+    const char* bytes;
+    size_t length;
+    bool mapped;
+    std::string fallback;
+  public:
+    /** Maps the file at path. Throws if the file cannot be opened. */
+    explicit MappedFile(const std::string& path);
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+    ~MappedFile();
+
+    const char* data() const { return bytes; }
+    size_t size() const { return length; }
+};
+
+
+/** Sequential little-endian writer for binary artifacts and messages. */
+class BinaryWriter {
+  private:
+    std::ofstream file;
+    std::ostringstream memory;
+    std::ostream* out;
+  public:
+    /** Opens (and truncates) the file at path. Check ok() before relying on the output. */
+    explicit BinaryWriter(const std::string& path);
+    /** Writes into memory, see str() */
+    BinaryWriter();
+
+    void write_u8(uint8_t value);
+    void write_u32(uint32_t value);
+    void write_i32(int32_t value);
+    void write_u64(uint64_t value);
+    /** Writes an unsigned LEB128 varint: 7 bits per byte, high bit set on all but the last. */
+    void write_varint(uint64_t value);
+    void write_bytes(const char* data, size_t size);
+    /** Writes a length-prefixed string. */
+    void write_string(const std::string& value);
+    /** Pads the output with zero bytes up to a multiple of alignment. */
+    void align(size_t alignment);
+    /** Returns the number of bytes written so far. */
+    uint64_t tell();
+    /** Returns true if every write so far succeeded. */
+    bool ok() const;
+    void close();
+    /** Returns everything written so far by an in-memory writer */
+    std::string str() const { return memory.str(); }
+};
+
+
+/** Bounds-checked sequential reader over an in-memory (typically mapped) binary artifact. */
+class BinaryReader {
+  private:
+    const char* bytes;
+    size_t length;
+    size_t pos;
+    /** Throws if fewer than count bytes are left. */
+    void require(size_t count) const;
+  public:
+    BinaryReader(const char* data, size_t size);
+
+    uint8_t read_u8();
+    uint32_t read_u32();
+    int32_t read_i32();
+    uint64_t read_u64();
+    uint64_t read_varint();
+    /** Reads a length-prefixed string. */
+    std::string read_string();
+    /** Returns a pointer to the next size bytes and skips them without copying. */
+    const char* read_bytes(size_t size);
+    /** Skips padding up to a multiple of alignment. */
+    void align(size_t alignment);
+    size_t position() const { return pos; }
+    bool at_end() const { return pos == length; }
+};
+
+#endif
@@ -0,0 +1,337 @@
+#include "FilePrefetcher.h"
+#include "Stats.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <system_error>
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+#if defined(__linux__) && defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#define PREFETCH_IO_URING 1
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#endif
+#endif
+using namespace std;
+
+// Largest single read handed to the kernel, longer files take several
+static const size_t MAX_READ = 1 << 30;
+// Most reads in flight on the ring at once
+static const size_t MAX_RING_ENTRIES = 4096;
+
+#ifdef PREFETCH_IO_URING
+/** A minimal io_uring, set up with the raw system calls (no liburing), used by one thread */
+struct FilePrefetcher::Ring {
+  int fd = -1;
+  void* sq_ring = MAP_FAILED;
+  void* cq_ring = MAP_FAILED;
+  size_t sq_ring_size = 0, cq_ring_size = 0, sqes_size = 0;
+  io_uring_sqe* sqes = static_cast<io_uring_sqe*>(MAP_FAILED);
+  unsigned *sq_tail = nullptr, *sq_mask = nullptr, *sq_array = nullptr;
+  unsigned *cq_head = nullptr, *cq_tail = nullptr, *cq_mask = nullptr;
+  io_uring_cqe* cqes = nullptr;
+  unsigned queued = 0;  // Entries not submitted yet
+
+  /** Returns a ring with room for entries reads, or nullptr if the kernel does not provide io_uring */
+  static unique_ptr<Ring> create(unsigned entries) {
+    unique_ptr<Ring> ring(new Ring());
+    io_uring_params params;
+    memset(&params, 0, sizeof(params));
+    ring->fd = static_cast<int>(syscall(__NR_io_uring_setup, entries, &params));
+    if (ring->fd < 0) return nullptr;
+    ring->sq_ring_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    ring->cq_ring_size = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+    bool single = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+    if (single) ring->sq_ring_size = ring->cq_ring_size = max(ring->sq_ring_size, ring->cq_ring_size);
+    ring->sq_ring = mmap(nullptr, ring->sq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                         ring->fd, IORING_OFF_SQ_RING);
+    if (ring->sq_ring == MAP_FAILED) return nullptr;
+    ring->cq_ring = single ? ring->sq_ring
+                           : mmap(nullptr, ring->cq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                                  ring->fd, IORING_OFF_CQ_RING);
+    if (ring->cq_ring == MAP_FAILED) return nullptr;
+    ring->sqes_size = params.sq_entries * sizeof(io_uring_sqe);
+    ring->sqes = static_cast<io_uring_sqe*>(mmap(nullptr, ring->sqes_size, PROT_READ | PROT_WRITE,
+                                                 MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_SQES));
+    if (ring->sqes == MAP_FAILED) return nullptr;
+    char* sq = static_cast<char*>(ring->sq_ring);
+    char* cq = static_cast<char*>(ring->cq_ring);
+    ring->sq_tail = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+    ring->sq_mask = reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+    ring->sq_array = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+    ring->cq_head = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+    ring->cq_tail = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+    ring->cq_mask = reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+    ring->cqes = reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes);
+    return ring;
+  }
+
+  ~Ring() {
+    if (sqes != MAP_FAILED) munmap(sqes, sqes_size);
+    if (cq_ring != MAP_FAILED && cq_ring != sq_ring) munmap(cq_ring, cq_ring_size);
+    if (sq_ring != MAP_FAILED) munmap(sq_ring, sq_ring_size);
+    if (fd >= 0) close(fd);
+  }
+
+  /** Queues a read of size bytes at offset of file into target, tagged with user_data */
+  void queue_read(int file, char* target, size_t size, size_t offset, uint64_t user_data) {
+    unsigned tail = *sq_tail;
+    unsigned index = tail & *sq_mask;
+    io_uring_sqe& sqe = sqes[index];
+    memset(&sqe, 0, sizeof(sqe));
+    sqe.opcode = IORING_OP_READ;
+    sqe.fd = file;
+    sqe.addr = reinterpret_cast<uint64_t>(target);
+    sqe.len = static_cast<uint32_t>(size);
+    sqe.off = offset;
+    sqe.user_data = user_data;
+    sq_array[index] = index;
+    __atomic_store_n(sq_tail, tail + 1, __ATOMIC_RELEASE);
+    ++queued;
+  }
+
+  /** Submits the queued reads and waits until at least one read has completed */
+  void submit_and_wait() {
+    while (true) {
+      long result = syscall(__NR_io_uring_enter, fd, queued, 1, IORING_ENTER_GETEVENTS, nullptr, 0);
+      if (result >= 0) {
+        queued -= static_cast<unsigned>(result);
+        if (queued == 0) return;
+      } else if (errno != EINTR && errno != EAGAIN && errno != EBUSY) {
+        throw system_error(errno, generic_category(), "io_uring_enter");
+      }
+    }
+  }
+
+  /** Takes the next completed read, if there is one */
+  bool completion(io_uring_cqe& cqe) {
+    unsigned head = *cq_head;
+    if (head == __atomic_load_n(cq_tail, __ATOMIC_ACQUIRE)) return false;
+    cqe = cqes[head & *cq_mask];
+    __atomic_store_n(cq_head, head + 1, __ATOMIC_RELEASE);
+    return true;
+  }
+};
+#else
+struct FilePrefetcher::Ring {};
+#endif
+
+
+FilePrefetcher::FilePrefetcher(const vector<string>& paths, size_t window, unsigned readers)
+    : paths(paths), window(max<size_t>(1, window)) {
+  if (paths.empty()) return;
+#ifdef PREFETCH_IO_URING
+  ring = Ring::create(static_cast<unsigned>(min(this->window, MAX_RING_ENTRIES)));
+  if (ring) {
+    threads.emplace_back(&FilePrefetcher::run_io_uring, this);
+    return;
+  }
+#endif
+  unsigned count = static_cast<unsigned>(min<size_t>(max(1u, readers), paths.size()));
+  for (unsigned i = 0; i < count; ++i) threads.emplace_back(&FilePrefetcher::run_pread, this);
+}
+
+
+FilePrefetcher::~FilePrefetcher() {
+  {
+    lock_guard<mutex> guard(lock);
+    stopping = true;
+  }
+  room_cond.notify_all();
+  for (thread& reader : threads) reader.join();
+}
+
+
+bool FilePrefetcher::claim(bool block, size_t& index) {
+  unique_lock<mutex> guard(lock);
+  auto room = [&]() { return ready.size() + reading < window; };
+  if (block) room_cond.wait(guard, [&]() { return stopping || next_path == paths.size() || room(); });
+  if (stopping || next_path == paths.size() || !room()) return false;
+  index = next_path++;
+  ++reading;
+  return true;
+}
+
+
+void FilePrefetcher::finish(File&& file) {
+  stats::count("batch.prefetched_bytes", static_cast<long long>(file.data.size()));
+  {
+    lock_guard<mutex> guard(lock);
+    --reading;
+    ready.push_back(move(file));
+  }
+  ready_cond.notify_one();
+}
+
+
+bool FilePrefetcher::next(File& file) {
+  unique_lock<mutex> guard(lock);
+  // Count the file as taken before waiting, so no more callers wait than there are files left
+  if (taken == paths.size()) return false;
+  ++taken;
+  ready_cond.wait(guard, [&]() { return !ready.empty(); });
+  file = move(ready.front());
+  ready.pop_front();
+  guard.unlock();
+  room_cond.notify_all();
+  return true;
+}
+
+
+string FilePrefetcher::read_file(const string& path) {
+#ifndef _WIN32
+  int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0) throw runtime_error("could not open the file");
+  struct stat info{};
+  bool regular = fstat(fd, &info) == 0 && S_ISREG(info.st_mode);
+  // Regular files are read at their size (plus a byte to notice growth), anything else in growing blocks
+  string data(regular ? static_cast<size_t>(info.st_size) + 1 : 1 << 16, '\0');
+  size_t used = 0;
+  while (true) {
+    if (used == data.size()) data.resize(data.size() * 2);
+    size_t size = min(data.size() - used, MAX_READ);
+    ssize_t count = regular ? pread(fd, &data[used], size, static_cast<off_t>(used)) : read(fd, &data[used], size);
+    if (count < 0 && errno == EINTR) continue;
+    if (count < 0) {
+      close(fd);
+      throw runtime_error("could not read the file");
+    }
+    if (count == 0) break;
+    used += static_cast<size_t>(count);
+  }
+  close(fd);
+  data.resize(used);
+  return data;
+#else
+  ifstream file(path, ios::binary);
+  if (!file.is_open()) throw runtime_error("could not open the file");
+  return string(istreambuf_iterator<char>(file), istreambuf_iterator<char>());
+#endif
+}
+
+
+void FilePrefetcher::run_pread() {
+  size_t index;
+  while (claim(true, index)) {
+    File file;
+    file.index = index;
+    try {
+      file.data = read_file(paths[index]);
+    } catch (const exception& e) {
+      file.error = e.what();
+    }
+    finish(move(file));
+  }
+}
+
+
+void FilePrefetcher::run_io_uring() {
+#ifdef PREFETCH_IO_URING
+  // Every file being read owns a slot, its user_data in the ring
+  struct Slot {
+    File file;
+    int fd = -1;
+    size_t done = 0;
+  };
+  vector<Slot> slots(min(window, MAX_RING_ENTRIES));
+  vector<size_t> free_slots;
+  for (size_t s = slots.size(); s-- > 0;) free_slots.push_back(s);
+  size_t in_flight = 0;
+  auto queue_rest = [&](size_t s) {
+    Slot& slot = slots[s];
+    size_t size = min(slot.file.data.size() - slot.done, MAX_READ);
+    ring->queue_read(slot.fd, &slot.file.data[slot.done], size, slot.done, s);
+  };
+  auto complete = [&](size_t s) {
+    close(slots[s].fd);
+    finish(move(slots[s].file));
+    slots[s] = Slot();
+    free_slots.push_back(s);
+    --in_flight;
+  };
+
+  while (true) {
+    // Start reading every file the window has room for; only wait for room when nothing is in flight
+    size_t index;
+    while (!free_slots.empty() && claim(in_flight == 0, index)) {
+      File file;
+      file.index = index;
+      int fd = open(paths[index].c_str(), O_RDONLY | O_CLOEXEC);
+      struct stat info{};
+      if (fd < 0 || fstat(fd, &info) != 0 || !S_ISREG(info.st_mode) || info.st_size == 0) {
+        // Missing, empty or not a regular file (a pipe, say): nothing to gain from the ring
+        if (fd >= 0) close(fd);
+        try {
+          file.data = read_file(paths[index]);
+        } catch (const exception& e) {
+          file.error = e.what();
+        }
+        finish(move(file));
+        continue;
+      }
+      size_t s = free_slots.back();
+      free_slots.pop_back();
+      slots[s].file = move(file);
+      slots[s].file.data.resize(static_cast<size_t>(info.st_size));
+      slots[s].fd = fd;
+      queue_rest(s);
+      ++in_flight;
+    }
+    if (in_flight == 0) break;
+
+    try {
+      ring->submit_and_wait();
+    } catch (const system_error&) {
+      // The ring stopped working. Reads already submitted may still land in the slots' buffers, so those are
+      // kept until the ring is closed and the files in flight are read again; the rest are read with pread
+      for (Slot& slot : slots) {
+        if (slot.fd < 0) continue;
+        close(slot.fd);
+        File file;
+        file.index = slot.file.index;
+        try {
+          file.data = read_file(paths[file.index]);
+        } catch (const exception& e) {
+          file.error = e.what();
+        }
+        abandoned.push_back(move(slot.file.data));
+        finish(move(file));
+      }
+      run_pread();
+      return;
+    }
+    io_uring_cqe cqe;
+    while (ring->completion(cqe)) {
+      size_t s = static_cast<size_t>(cqe.user_data);
+      Slot& slot = slots[s];
+      if (cqe.res == -EINTR || cqe.res == -EAGAIN) {
+        queue_rest(s);
+      } else if (cqe.res < 0) {
+        // The kernel cannot read this file through the ring (IORING_OP_READ needs Linux 5.6), read it here
+        slot.file.data.clear();
+        try {
+          slot.file.data = read_file(paths[slot.file.index]);
+        } catch (const exception& e) {
+          slot.file.error = e.what();
+        }
+        complete(s);
+      } else if (cqe.res == 0) {
+        // The file shrank since it was opened
+        slot.file.data.resize(slot.done);
+        complete(s);
+      } else {
+        slot.done += static_cast<size_t>(cqe.res);
+        if (slot.done < slot.file.data.size()) queue_rest(s);
+        else complete(s);
+      }
+    }
+  }
+#endif
+}
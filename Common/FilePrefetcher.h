@@ -0,0 +1,67 @@
+#ifndef FILE_PREFETCHER_H
+#define FILE_PREFETCHER_H
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+/**
+ * Reads a list of files ahead of the threads that process them. Up to window files are being read or waiting
+ * to be taken at any time. On Linux the reads go through one io_uring, so a single thread keeps all of them in
+ * flight; where io_uring is unavailable a few threads read whole files with pread instead.
+ * Files are handed out in the order their reads finish, not in list order.
+ */
+class FilePrefetcher {
+  public:
+    struct File {
+      size_t index = 0;    // Position of the file in the list
+      std::string data;    // Whole contents; like any std::string, followed by a NUL
+      std::string error;   // Set instead of data if the file could not be read
+    };
+
+  private:
+    struct Ring;
+    std::vector<std::string> paths;
+    size_t window;
+    std::mutex lock;
+    std::condition_variable ready_cond;  // A file was read
+    std::condition_variable room_cond;   // A file was taken, or the prefetcher is stopping
+    std::deque<File> ready;
+    size_t next_path = 0;                // First file not being read yet
+    size_t reading = 0;                  // Files being read
+    size_t taken = 0;
+    bool stopping = false;
+    std::vector<std::string> abandoned;  // Buffers of reads left on a failed ring, freed after it is closed
+    std::unique_ptr<Ring> ring;
+    std::vector<std::thread> threads;
+
+    /** Claims the next file to read if the window has room. With block, waits for room instead of failing. */
+    bool claim(bool block, size_t& index);
+    void finish(File&& file);
+    void run_pread();
+    void run_io_uring();
+
+  public:
+    /**
+     * Starts reading paths.
+     * @param window Most files read but not taken yet (at least 1).
+     * @param readers Threads reading files when io_uring is unavailable.
+     */
+    FilePrefetcher(const std::vector<std::string>& paths, size_t window, unsigned readers = 4);
+    FilePrefetcher(const FilePrefetcher&) = delete;
+    FilePrefetcher& operator=(const FilePrefetcher&) = delete;
+    /** Stops reading ahead and waits for the reads in flight */
+    ~FilePrefetcher();
+
+    /** Waits for the next file read. Returns false once every file has been taken. */
+    bool next(File& file);
+    bool uses_io_uring() const { return ring != nullptr; }
+    /** Reads a whole file synchronously. Throws if it cannot be read. */
+    static std::string read_file(const std::string& path);
+};
+
+#endif // FILE_PREFETCHER_H
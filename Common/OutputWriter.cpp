@@ -0,0 +1,91 @@
+#include "OutputWriter.h"
+using namespace std;
+
+const size_t OutputWriter::DEFAULT_BUFFER_SIZE;
+
+// Full buffers waiting for the background thread before the writer waits for it
+static const size_t MAX_QUEUED_BUFFERS = 4;
+
+
+OutputWriter::OutputWriter(const string& path, bool background, size_t buffer_size)
+    : file(fopen(path.c_str(), "w")), buffer_size(buffer_size == 0 ? 1 : buffer_size), background(background) {
+  if (!file) return;
+  // The buffers here are already large, a second copy through stdio's would only cost time
+  setvbuf(file, nullptr, _IONBF, 0);
+  buffer.reserve(this->buffer_size + 256);
+  if (background) thread = std::thread(&OutputWriter::run, this);
+}
+
+
+OutputWriter::~OutputWriter() {
+  close();
+}
+
+
+void OutputWriter::write_out(const string& data) {
+  if (!data.empty() && fwrite(data.data(), 1, data.size(), file) != data.size()) failed = true;
+}
+
+
+void OutputWriter::flush_buffer() {
+  if (!file || buffer.empty()) return;
+  if (!background) {
+    write_out(buffer);
+    buffer.clear();
+    return;
+  }
+  string next;
+  {
+    unique_lock<mutex> guard(lock);
+    space_cond.wait(guard, [&]() { return queue.size() < MAX_QUEUED_BUFFERS; });
+    queue.push_back(move(buffer));
+    if (!spare.empty()) {
+      next = move(spare.back());
+      spare.pop_back();
+    }
+  }
+  queue_cond.notify_one();
+  buffer = move(next);
+  buffer.clear();
+  buffer.reserve(buffer_size + 256);
+}
+
+
+void OutputWriter::run() {
+  unique_lock<mutex> guard(lock);
+  while (true) {
+    queue_cond.wait(guard, [&]() { return closing || !queue.empty(); });
+    if (queue.empty()) return;
+    string data = move(queue.front());
+    queue.pop_front();
+    guard.unlock();
+    write_out(data);
+    guard.lock();
+    spare.push_back(move(data));
+    space_cond.notify_one();
+  }
+}
+
+
+OutputWriter& OutputWriter::padded(const string& text, size_t width) {
+  *this << text;
+  if (text.size() < width) *this << string(width - text.size(), ' ');
+  return *this;
+}
+
+
+bool OutputWriter::close() {
+  if (!file) return !failed;
+  flush_buffer();
+  if (thread.joinable()) {
+    {
+      lock_guard<mutex> guard(lock);
+      closing = true;
+    }
+    queue_cond.notify_one();
+    thread.join();
+  }
+  if (fclose(file) != 0) failed = true;
+  file = nullptr;
+  return !failed;
+}
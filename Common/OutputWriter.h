@@ -0,0 +1,74 @@
+#ifndef OUTPUT_WRITER_H
+#define OUTPUT_WRITER_H
+#include <condition_variable>
+#include <cstddef>
+#include <cstdio>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+/**
+ * Buffered text file writer for the reports. Output collects in a large buffer that goes to the file in
+ * one write when it fills, nothing is flushed per line. With a background thread the full buffers are
+ * written there instead, so formatting the next one overlaps the disk; at most a few buffers wait at once.
+ */
+class OutputWriter {
+  public:
+    static const size_t DEFAULT_BUFFER_SIZE = 1 << 20;
+
+  private:
+    std::FILE* file;
+    size_t buffer_size;
+    std::string buffer;
+    bool failed = false;
+    // Background writing
+    bool background;
+    std::mutex lock;
+    std::condition_variable queue_cond;  // A buffer was queued, or the writer is closing
+    std::condition_variable space_cond;  // A queued buffer was written
+    std::deque<std::string> queue;
+    std::vector<std::string> spare;      // Written buffers kept for reuse
+    bool closing = false;
+    std::thread thread;
+
+    /** Hands the buffer to the file, or to the background thread */
+    void flush_buffer();
+    void write_out(const std::string& data);
+    void run();
+
+  public:
+    /** Opens (and truncates) the file at path. Check is_open() before writing */
+    explicit OutputWriter(const std::string& path, bool background = false, size_t buffer_size = DEFAULT_BUFFER_SIZE);
+    OutputWriter(const OutputWriter&) = delete;
+    OutputWriter& operator=(const OutputWriter&) = delete;
+    ~OutputWriter();
+
+    bool is_open() const { return file != nullptr; }
+    void write(const char* data, size_t size) {
+      if (!file) return;
+      // A range longer than the buffer goes out in buffer sized parts, so the buffer never outgrows its size
+      while (buffer.size() + size > buffer_size) {
+        size_t part = buffer_size - buffer.size();
+        buffer.append(data, part);
+        flush_buffer();
+        data += part;
+        size -= part;
+      }
+      buffer.append(data, size);
+      if (buffer.size() >= buffer_size) flush_buffer();
+    }
+    OutputWriter& operator<<(const std::string& text) { write(text.data(), text.size()); return *this; }
+    OutputWriter& operator<<(const char* text) { return *this << std::string(text); }
+    OutputWriter& operator<<(char c) { write(&c, 1); return *this; }
+    template <typename T, typename = typename std::enable_if<std::is_arithmetic<T>::value>::type>
+    OutputWriter& operator<<(T value) { return *this << std::to_string(value); }
+    /** Writes text left aligned in a column of width characters, like std::left << std::setw(width) */
+    OutputWriter& padded(const std::string& text, size_t width);
+    /** Writes everything still buffered and closes the file. Returns false if any write failed */
+    bool close();
+};
+
+#endif // OUTPUT_WRITER_H
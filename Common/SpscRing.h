@@ -0,0 +1,103 @@
+#ifndef DFA_CPP_SPSCRING_H
+#define DFA_CPP_SPSCRING_H
+
+#include <atomic>
+#include <cstddef>
+#include <thread>
+#include <utility>
+#include <vector>
+
+/**
+ * Bounded lock-free single producer / single consumer queue.
+ * The producer only writes tail and the consumer only writes head, each keeping a cached copy of the other
+ * index so the shared cache lines are only touched when the ring looks full (or empty).
+ * Blocking push and pop spin briefly and then yield. close() marks the end of the stream.
+ */
+template <typename T>
+class SpscRing {
+  private:
+    static const size_t CACHE_LINE = 64;
+    std::vector<T> slots;
+    size_t mask;
+    // Consumer side
+    alignas(CACHE_LINE) std::atomic<size_t> head;
+    size_t cached_tail;
+    // Producer side
+    alignas(CACHE_LINE) std::atomic<size_t> tail;
+    size_t cached_head;
+    alignas(CACHE_LINE) std::atomic<bool> closed;
+
+    static size_t round_up(size_t capacity) {
+      size_t size = 2;
+      while (size < capacity) size <<= 1;
+      return size;
+    }
+
+    static void backoff(unsigned &spins) {
+      if (++spins < 64) return;
+      std::this_thread::yield();
+    }
+
+  public:
+    /** capacity is rounded up to a power of two */
+    explicit SpscRing(size_t capacity)
+        : slots(round_up(capacity)), mask(slots.size() - 1), head(0), cached_tail(0), tail(0), cached_head(0),
+          closed(false) {}
+
+    SpscRing(const SpscRing &) = delete;
+    SpscRing &operator=(const SpscRing &) = delete;
+
+    size_t capacity() const { return slots.size(); }
+
+    /** Producer: returns false if the ring is full */
+    bool try_push(T &&value) {
+      size_t t = tail.load(std::memory_order_relaxed);
+      if (t - cached_head == slots.size()) {
+        cached_head = head.load(std::memory_order_acquire);
+        if (t - cached_head == slots.size()) return false;
+      }
+      slots[t & mask] = std::move(value);
+      tail.store(t + 1, std::memory_order_release);
+      return true;
+    }
+
+    /** Producer: waits until there is room */
+    void push(T value) {
+      unsigned spins = 0;
+      while (!try_push(std::move(value))) backoff(spins);
+    }
+
+    /** Producer: no more values will be pushed */
+    void close() {
+      closed.store(true, std::memory_order_release);
+    }
+
+    /** Consumer: returns false if the ring is empty */
+    bool try_pop(T &value) {
+      size_t h = head.load(std::memory_order_relaxed);
+      if (h == cached_tail) {
+        cached_tail = tail.load(std::memory_order_acquire);
+        if (h == cached_tail) return false;
+      }
+      value = std::move(slots[h & mask]);
+      head.store(h + 1, std::memory_order_release);
+      return true;
+    }
+
+    /** Consumer: waits for a value. Returns false once the ring is closed and drained */
+    bool pop(T &value) {
+      unsigned spins = 0;
+      while (!try_pop(value)) {
+        // Check closed before retrying so a value pushed right before close() is not lost
+        if (closed.load(std::memory_order_acquire)) return try_pop(value);
+        backoff(spins);
+      }
+      return true;
+    }
+};
+
+template <typename T>
+const size_t SpscRing<T>::CACHE_LINE;
+
+
+#endif //DFA_CPP_SPSCRING_H
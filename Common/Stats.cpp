@@ -0,0 +1,84 @@
+#include "Stats.h"
+#include <fstream>
+#include <iomanip>
+#include <map>
+#include <mutex>
+using namespace std;
+
+namespace stats {
+  atomic<bool> active(false);
+
+  namespace {
+    struct Timer {
+      long long calls = 0;
+      double seconds = 0;
+    };
+    mutex lock;
+    map<string, Timer> timers;
+    map<string, long long> counters;
+
+    void write_name(ostream& out, const string& name) {
+      out << '"';
+      for (char c : name) {
+        if (c == '"' || c == '\\') out << '\\';
+        out << c;
+      }
+      out << '"';
+    }
+  }
+
+  void enable() {
+    active.store(true, memory_order_relaxed);
+  }
+
+
+  void count(const char* name, long long delta) {
+    if (!enabled()) return;
+    lock_guard<mutex> guard(lock);
+    counters[name] += delta;
+  }
+
+
+  void maximum(const char* name, long long value) {
+    if (!enabled()) return;
+    lock_guard<mutex> guard(lock);
+    auto found = counters.find(name);
+    if (found == counters.end()) counters[name] = value;
+    else if (found->second < value) found->second = value;
+  }
+
+
+  void record_time(const char* name, double seconds) {
+    if (!enabled()) return;
+    lock_guard<mutex> guard(lock);
+    Timer& timer = timers[name];
+    timer.calls++;
+    timer.seconds += seconds;
+  }
+
+
+  bool write_json(const string& path) {
+    ofstream out(path);
+    if (!out.is_open()) return false;
+    lock_guard<mutex> guard(lock);
+    out << "{\n  \"timers\": {";
+    bool first = true;
+    for (const auto& timer : timers) {
+      out << (first ? "\n    " : ",\n    ");
+      write_name(out, timer.first);
+      out << ": {\"calls\": " << timer.second.calls << ", \"total_ms\": " << fixed << setprecision(3)
+          << timer.second.seconds * 1000 << "}";
+      first = false;
+    }
+    out << (first ? "},\n" : "\n  },\n") << "  \"counters\": {";
+    first = true;
+    for (const auto& counter : counters) {
+      out << (first ? "\n    " : ",\n    ");
+      write_name(out, counter.first);
+      out << ": " << counter.second;
+      first = false;
+    }
+    out << (first ? "}\n" : "\n  }\n") << "}\n";
+    return !out.fail();
+  }
+}
@@ -0,0 +1,45 @@
+#ifndef STATS_H
+#define STATS_H
+#include <atomic>
+#include <chrono>
+#include <string>
+
+/**
+ * Process wide timers and counters for finding where each stage spends its time.
+ * Collection is off until enable() is called; while off every call is a single relaxed load, so the
+ * instrumentation can stay in the code. Safe to use from several threads.
+ */
+namespace stats {
+  extern std::atomic<bool> active;
+
+  void enable();
+  inline bool enabled() { return active.load(std::memory_order_relaxed); }
+
+  /** Adds delta to a counter */
+  void count(const char* name, long long delta = 1);
+  /** Raises a counter to value if it is below it */
+  void maximum(const char* name, long long value);
+  /** Adds one call taking seconds to a timer */
+  void record_time(const char* name, double seconds);
+  /** Writes every timer and counter as a JSON object. Returns false if the file could not be written */
+  bool write_json(const std::string& path);
+
+  /** Times the enclosing scope under name */
+  class ScopedTimer {
+    private:
+      const char* name;
+      bool running;
+      std::chrono::steady_clock::time_point start;
+    public:
+      explicit ScopedTimer(const char* name) : name(name), running(enabled()) {
+        if (running) start = std::chrono::steady_clock::now();
+      }
+      ScopedTimer(const ScopedTimer&) = delete;
+      ScopedTimer& operator=(const ScopedTimer&) = delete;
+      ~ScopedTimer() {
+        if (running) record_time(name, std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+      }
+  };
+}
+
+#endif // STATS_H
@@ -0,0 +1,229 @@
+#include "UnixSocket.h"
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+#include <system_error>
+#ifndef _WIN32
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+using namespace std;
+
+namespace {
+  /** The payload size in a frame header. Throws if it is larger than max_size */
+  uint32_t payload_size(const char* header, size_t max_size) {
+    uint32_t size = 0;
+    for (int i = 0; i < 4; ++i) size |= static_cast<uint32_t>(static_cast<unsigned char>(header[1 + i])) << (8 * i);
+    if (size > max_size) throw runtime_error("Frame of " + to_string(size) + " bytes is too large.");
+    return size;
+  }
+
+#ifndef _WIN32
+  sockaddr_un address_of(const string& path) {
+    sockaddr_un address{};
+    address.sun_family = AF_UNIX;
+    if (path.size() >= sizeof(address.sun_path)) throw runtime_error("Socket path is too long: " + path);
+    memcpy(address.sun_path, path.c_str(), path.size() + 1);
+    return address;
+  }
+
+  /** Reads exactly size bytes. Returns the number read before the peer closed the connection */
+  size_t read_exact(int fd, char* target, size_t size) {
+    size_t done = 0;
+    while (done < size) {
+      ssize_t count = read(fd, target + done, size - done);
+      if (count < 0 && errno == EINTR) continue;
+      if (count < 0) throw system_error(errno, generic_category(), "read");
+      if (count == 0) break;
+      done += static_cast<size_t>(count);
+    }
+    return done;
+  }
+
+  void write_all(int fd, const char* data, size_t size) {
+    while (size > 0) {
+      // MSG_NOSIGNAL: a client that went away is an error here, not a SIGPIPE for the whole server
+      ssize_t count = send(fd, data, size, MSG_NOSIGNAL);
+      if (count < 0 && errno == EINTR) continue;
+      if (count < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+        // A non-blocking socket with a full send buffer: wait until the peer reads, or the connection is shut down
+        pollfd writable = {fd, POLLOUT, 0};
+        if (poll(&writable, 1, -1) < 0 && errno != EINTR) throw system_error(errno, generic_category(), "poll");
+        continue;
+      }
+      if (count < 0) throw system_error(errno, generic_category(), "send");
+      data += count;
+      size -= static_cast<size_t>(count);
+    }
+  }
+#endif
+}
+
+
+UnixSocket& UnixSocket::operator=(UnixSocket&& other) noexcept {
+  if (this != &other) {
+#ifndef _WIN32
+    if (fd != -1) close(fd);
+#endif
+    fd = other.fd;
+    other.fd = -1;
+  }
+  return *this;
+}
+
+
+UnixSocket::~UnixSocket() {
+#ifndef _WIN32
+  if (fd != -1) close(fd);
+#endif
+}
+
+
+UnixSocket UnixSocket::listen(const string& path) {
+#ifndef _WIN32
+  sockaddr_un address = address_of(path);
+  UnixSocket socket(::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0));
+  if (!socket.is_open()) throw system_error(errno, generic_category(), "socket");
+  unlink(path.c_str());
+  if (bind(socket.fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0)
+    throw system_error(errno, generic_category(), "Could not bind " + path);
+  if (::listen(socket.fd, SOMAXCONN) != 0) throw system_error(errno, generic_category(), "listen");
+  return socket;
+#else
+  throw runtime_error("Unix domain sockets are not supported on this platform.");
+#endif
+}
+
+
+UnixSocket UnixSocket::connect(const string& path) {
+#ifndef _WIN32
+  sockaddr_un address = address_of(path);
+  UnixSocket socket(::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0));
+  if (!socket.is_open()) throw system_error(errno, generic_category(), "socket");
+  if (::connect(socket.fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0)
+    throw system_error(errno, generic_category(), "Could not connect to " + path);
+  return socket;
+#else
+  throw runtime_error("Unix domain sockets are not supported on this platform.");
+#endif
+}
+
+
+void UnixSocket::pair(UnixSocket& first, UnixSocket& second) {
+#ifndef _WIN32
+  int fds[2];
+  if (socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, fds) != 0)
+    throw system_error(errno, generic_category(), "socketpair");
+  first = UnixSocket(fds[0]);
+  second = UnixSocket(fds[1]);
+#else
+  throw runtime_error("Unix domain sockets are not supported on this platform.");
+#endif
+}
+
+
+void UnixSocket::wait_readable(const vector<const UnixSocket*>& sockets, vector<bool>& readable) {
+#ifndef _WIN32
+  vector<pollfd> fds(sockets.size());
+  for (size_t i = 0; i < sockets.size(); ++i) fds[i] = {sockets[i]->fd, POLLIN, 0};
+  while (poll(fds.data(), static_cast<nfds_t>(fds.size()), -1) < 0) {
+    if (errno != EINTR) throw system_error(errno, generic_category(), "poll");
+  }
+  readable.assign(sockets.size(), false);
+  // A closed or failed connection counts as readable, reading it is what reports the end
+  for (size_t i = 0; i < fds.size(); ++i) readable[i] = (fds[i].revents & (POLLIN | POLLHUP | POLLERR)) != 0;
+#else
+  throw runtime_error("Unix domain sockets are not supported on this platform.");
+#endif
+}
+
+
+UnixSocket UnixSocket::accept() const {
+#ifndef _WIN32
+  while (true) {
+    int client = ::accept4(fd, nullptr, nullptr, SOCK_CLOEXEC);
+    if (client >= 0) return UnixSocket(client);
+    if (errno == EINTR || errno == ECONNABORTED) continue;
+    // Shut down (EINVAL), or out of descriptors: either way this listener is done
+    return UnixSocket();
+  }
+#else
+  return UnixSocket();
+#endif
+}
+
+
+void UnixSocket::shutdown() const {
+#ifndef _WIN32
+  ::shutdown(fd, SHUT_RDWR);
+#endif
+}
+
+
+void UnixSocket::set_nonblocking() const {
+#ifndef _WIN32
+  int flags = fcntl(fd, F_GETFL);
+  if (flags < 0 || fcntl(fd, F_SETFL, flags | O_NONBLOCK) < 0) throw system_error(errno, generic_category(), "fcntl");
+#endif
+}
+
+
+void UnixSocket::send_frame(uint8_t kind, const string& payload) const {
+#ifndef _WIN32
+  char header[5];
+  header[0] = static_cast<char>(kind);
+  uint32_t size = static_cast<uint32_t>(payload.size());
+  for (int i = 0; i < 4; ++i) header[1 + i] = static_cast<char>((size >> (8 * i)) & 0xFF);
+  write_all(fd, header, sizeof(header));
+  write_all(fd, payload.data(), payload.size());
+#endif
+}
+
+
+bool UnixSocket::receive_frame(uint8_t& kind, string& payload, size_t max_size) const {
+#ifndef _WIN32
+  char header[5];
+  size_t count = read_exact(fd, header, sizeof(header));
+  if (count == 0) return false;
+  if (count < sizeof(header)) throw runtime_error("Connection closed inside a frame.");
+  kind = static_cast<uint8_t>(header[0]);
+  uint32_t size = payload_size(header, max_size);
+  payload.resize(size);
+  if (size > 0 && read_exact(fd, &payload[0], size) < size) throw runtime_error("Connection closed inside a frame.");
+  return true;
+#else
+  return false;
+#endif
+}
+
+
+bool UnixSocket::receive_available(string& buffer) const {
+#ifndef _WIN32
+  char chunk[65536];
+  while (true) {
+    ssize_t count = read(fd, chunk, sizeof(chunk));
+    if (count < 0 && errno == EINTR) continue;
+    if (count < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) return true;
+    if (count < 0) throw system_error(errno, generic_category(), "read");
+    buffer.append(chunk, static_cast<size_t>(count));
+    return count > 0;
+  }
+#else
+  return false;
+#endif
+}
+
+
+bool UnixSocket::take_frame(string& buffer, uint8_t& kind, string& payload, size_t max_size) {
+  const size_t header = 5;
+  if (buffer.size() < header) return false;
+  uint32_t size = payload_size(buffer.data(), max_size);
+  if (buffer.size() - header < size) return false;
+  kind = static_cast<uint8_t>(buffer[0]);
+  payload.assign(buffer, header, size);
+  buffer.erase(0, header + size);
+  return true;
+}
@@ -0,0 +1,61 @@
+#ifndef UNIX_SOCKET_H
+#define UNIX_SOCKET_H
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/**
+ * Stream socket in the Unix domain, closed when destroyed. Messages on it are frames: a kind byte, a
+ * little-endian u32 payload size and the payload.
+ * Only available on POSIX systems; elsewhere every constructor throws.
+ */
+class UnixSocket {
+  private:
+    int fd;
+    explicit UnixSocket(int fd) : fd(fd) {}
+
+  public:
+    UnixSocket() : fd(-1) {}
+    UnixSocket(UnixSocket&& other) noexcept : fd(other.fd) { other.fd = -1; }
+    UnixSocket& operator=(UnixSocket&& other) noexcept;
+    UnixSocket(const UnixSocket&) = delete;
+    UnixSocket& operator=(const UnixSocket&) = delete;
+    ~UnixSocket();
+
+    /** Listens on path, replacing a socket file left behind by an earlier server. Throws on failure */
+    static UnixSocket listen(const std::string& path);
+    /** Connects to a server listening on path. Throws on failure */
+    static UnixSocket connect(const std::string& path);
+    /** Connects first and second to each other. Throws on failure */
+    static void pair(UnixSocket& first, UnixSocket& second);
+    /**
+     * Waits until at least one of sockets can be read without blocking (a client is waiting on a listener, or
+     * a peer sent data or closed the connection) and sets readable[i] for every such socket. Throws on failure
+     */
+    static void wait_readable(const std::vector<const UnixSocket*>& sockets, std::vector<bool>& readable);
+    /** Waits for a client. Returns a closed socket once the listener is shut down */
+    UnixSocket accept() const;
+    /** Stops a listener: accept() returns in every thread waiting in it. On a connection, ends every read and send */
+    void shutdown() const;
+    /** Makes reads return what has arrived instead of waiting, see receive_available(). Throws on failure */
+    void set_nonblocking() const;
+    bool is_open() const { return fd != -1; }
+
+    /** Sends one frame. Throws if the peer is gone */
+    void send_frame(uint8_t kind, const std::string& payload) const;
+    /** Receives one frame. Returns false if the peer closed the connection between frames, throws on a cut frame */
+    bool receive_frame(uint8_t& kind, std::string& payload, size_t max_size = 1u << 30) const;
+    /**
+     * Non-blocking sockets only: appends the bytes that have arrived, up to 64 KiB, to buffer without waiting
+     * for more. Returns false once the peer closed the connection. Throws on failure
+     */
+    bool receive_available(std::string& buffer) const;
+    /**
+     * Takes the first frame off the front of buffer if all of it has arrived. Returns false if it has not,
+     * throws if its payload is larger than max_size
+     */
+    static bool take_frame(std::string& buffer, uint8_t& kind, std::string& payload, size_t max_size = 1u << 30);
+};
+
+#endif // UNIX_SOCKET_H
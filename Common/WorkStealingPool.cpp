@@ -0,0 +1,72 @@
+#include "WorkStealingPool.h"
+#include <algorithm>
+#include <exception>
+#include <thread>
+using namespace std;
+
+WorkStealingPool::WorkStealingPool(unsigned threads) : threads(threads) {
+  if (this->threads == 0) this->threads = max(1u, thread::hardware_concurrency());
+}
+
+
+bool WorkStealingPool::take(Slice& slice, size_t& index) {
+  lock_guard<mutex> guard(slice.lock);
+  if (slice.begin == slice.end) return false;
+  index = slice.begin++;
+  return true;
+}
+
+
+bool WorkStealingPool::steal(Slice& victim, Slice& thief, size_t& index) {
+  size_t begin, end;
+  {
+    lock_guard<mutex> guard(victim.lock);
+    if (victim.begin == victim.end) return false;
+    // Leave the victim the front half, it is working through it from the front
+    size_t middle = victim.begin + (victim.end - victim.begin) / 2;
+    begin = middle;
+    end = victim.end;
+    victim.end = middle;
+  }
+  index = begin;
+  lock_guard<mutex> guard(thief.lock);
+  thief.begin = begin + 1;
+  thief.end = end;
+  return true;
+}
+
+
+void WorkStealingPool::for_each(size_t count, const function<void(size_t, unsigned)>& job) const {
+  if (count == 0) return;
+  unsigned workers = static_cast<unsigned>(min<size_t>(threads, count));
+  unique_ptr<Slice[]> slices(new Slice[workers]);
+  for (unsigned w = 0; w < workers; ++w) {
+    slices[w].begin = count * w / workers;
+    slices[w].end = count * (w + 1) / workers;
+  }
+
+  mutex error_lock;
+  exception_ptr error;
+  auto run = [&](unsigned worker) {
+    size_t index;
+    while (true) {
+      bool found = take(slices[worker], index);
+      // Nothing left locally, try everyone else once. Jobs are never added, so if all slices are empty we are done.
+      for (unsigned offset = 1; !found && offset < workers; ++offset)
+        found = steal(slices[(worker + offset) % workers], slices[worker], index);
+      if (!found) return;
+      try {
+        job(index, worker);
+      } catch (...) {
+        lock_guard<mutex> guard(error_lock);
+        if (!error) error = current_exception();
+      }
+    }
+  };
+
+  vector<thread> pool;
+  for (unsigned w = 1; w < workers; ++w) pool.emplace_back(run, w);
+  run(0);
+  for (auto& t : pool) t.join();
+  if (error) rethrow_exception(error);
+}
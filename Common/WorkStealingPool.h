@@ -0,0 +1,38 @@
+#ifndef WORK_STEALING_POOL_H
+#define WORK_STEALING_POOL_H
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+/**
+ * Runs a batch of independent jobs on a fixed number of threads.
+ * Every worker starts with an equal slice of the job indices and takes jobs from the front of it. A worker that
+ * runs out steals the back half of another worker's slice, so a few slow jobs don't leave the other threads idle.
+ */
+class WorkStealingPool {
+  private:
+    /** Unclaimed job indices [begin, end) of one worker */
+    struct Slice {
+      std::mutex lock;
+      size_t begin = 0;
+      size_t end = 0;
+    };
+    unsigned threads;
+
+    static bool take(Slice& slice, size_t& index);
+    static bool steal(Slice& victim, Slice& thief, size_t& index);
+
+  public:
+    /** 0 threads means one per hardware thread */
+    explicit WorkStealingPool(unsigned threads = 0);
+    unsigned size() const { return threads; }
+    /**
+     * Calls job(index, worker) for every index in [0, count) and returns when all of them are done.
+     * If a job throws, the remaining jobs still run and the first exception is rethrown afterwards.
+     */
+    void for_each(size_t count, const std::function<void(size_t, unsigned)>& job) const;
+};
+
+#endif // WORK_STEALING_POOL_H
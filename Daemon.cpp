@@ -0,0 +1,270 @@
+#include "Daemon.h"
+# include <algorithm>
+# include <condition_variable>
+# include <cstdio>
+# include <deque>
+# include <iomanip>
+# include <iostream>
+# include <iterator>
+# include <mutex>
+# include <thread>
+# include <unordered_map>
+# include "BinaryFile.h"
+# include "FilePrefetcher.h"
+# include "UnixSocket.h"
+# include "Stats.h"
+
+Daemon::Daemon(const LexicalAnalyzer &lexical_analyzer, const ParserGenerator &parserGenerator, unsigned workers)
+        : lexical_analyzer(lexical_analyzer), parserGenerator(parserGenerator), workers(workers) {
+    if (this->workers == 0) this->workers = std::max(1u, std::thread::hardware_concurrency());
+}
+
+std::string Daemon::handle(uint8_t kind, const std::string &payload, bool &stop) const {
+    stats::count("daemon.requests");
+    BinaryWriter reply;
+    if (kind == SHUTDOWN) {
+        stop = true;
+        return reply.str();
+    }
+    if (kind != TOKENIZE && kind != PARSE) throw std::runtime_error("Unknown request " + std::to_string(kind));
+
+    InputBuffer input(payload.data(), payload.size());
+    std::vector<Symbol> symbol_table = lexical_analyzer.analyze(input);
+    if (kind == TOKENIZE) {
+        // Token names are sent once, every token refers to its name by index
+        std::unordered_map<std::string, uint32_t> name_index;
+        std::vector<const std::string *> names;
+        std::vector<uint32_t> indices;
+        for (const Symbol &symbol : symbol_table) {
+            auto found = name_index.emplace(symbol.token_name, static_cast<uint32_t>(names.size()));
+            if (found.second) names.push_back(&found.first->first);
+            indices.push_back(found.first->second);
+        }
+        reply.write_u32(static_cast<uint32_t>(names.size()));
+        for (const std::string *name : names) reply.write_string(*name);
+        reply.write_u32(static_cast<uint32_t>(symbol_table.size()));
+        for (size_t i = 0; i < symbol_table.size(); i++) {
+            reply.write_u32(indices[i]);
+            reply.write_string(symbol_table[i].lexeme);
+        }
+        return reply.str();
+    }
+
+    std::vector<std::string> parser_input;
+    for (const Symbol &symbol : symbol_table) {
+        parser_input.push_back(symbol.token_name);
+    }
+    parser_input.push_back("$");
+    VectorTokenStream tokens(parser_input);
+    ParseResult result = parserGenerator.getParser().parse(tokens);
+    reply.write_u8(result.accepted ? 1 : 0);
+    reply.write_u32(static_cast<uint32_t>(result.errorCount));
+    reply.write_u32(static_cast<uint32_t>(symbol_table.size()));
+    reply.write_u32(static_cast<uint32_t>(result.messages.size()));
+    for (const std::string &message : result.messages) reply.write_string(message);
+    return reply.str();
+}
+
+namespace {
+    /** A client connection and the bytes it sent that are not a whole request yet */
+    struct Connection {
+        UnixSocket socket;
+        std::string received;
+    };
+
+    /** A connection with a whole request taken off its bytes */
+    struct Pending {
+        Connection connection;
+        uint8_t kind;
+        std::string payload;
+    };
+}
+
+int Daemon::serve(const std::string &socket_path) const {
+    UnixSocket listener = UnixSocket::listen(socket_path);
+    std::cout << "Listening on " << socket_path << " with " << workers << " workers" << std::endl;
+    // This thread polls the listener and every idle connection, collects the bytes of each connection and queues
+    // it once a whole request has arrived; a worker answers that request and hands its connection back through
+    // wake. So no worker waits on a client, a client that stops inside a frame only holds its own buffer, and
+    // closing the connections on SHUTDOWN ends every client's wait
+    UnixSocket wake, wake_sender;
+    UnixSocket::pair(wake, wake_sender);
+    wake.set_nonblocking();
+    std::mutex lock;
+    std::condition_variable queued_cond;
+    std::deque<Pending> queued;                     // Requests waiting for a worker
+    std::vector<Connection> returned;               // Connections handed back by the workers
+    std::vector<const UnixSocket *> in_flight;      // Connections a worker is answering
+    bool stopping = false;
+    // A connection that failed is not handed back, closing it when the worker lets go of it
+    auto hand_back = [&](Connection &&connection, bool stop, bool failed) {
+        std::lock_guard<std::mutex> guard(lock);
+        in_flight.erase(std::find(in_flight.begin(), in_flight.end(), &connection.socket));
+        if (stop) stopping = true;
+        else if (!stopping && !failed) returned.push_back(std::move(connection));
+        wake_sender.send_frame(0, "");
+    };
+    auto work = [&]() {
+        while (true) {
+            Pending request;
+            {
+                std::unique_lock<std::mutex> guard(lock);
+                queued_cond.wait(guard, [&]() { return stopping || !queued.empty(); });
+                if (stopping) return;
+                request = std::move(queued.front());
+                queued.pop_front();
+                in_flight.push_back(&request.connection.socket);
+            }
+            const UnixSocket &client = request.connection.socket;
+            bool stop = false, failed = false;
+            try {
+                std::string reply;
+                try {
+                    reply = handle(request.kind, request.payload, stop);
+                } catch (const std::exception &e) {
+                    client.send_frame(FAILED, e.what());
+                    hand_back(std::move(request.connection), false, false);
+                    continue;
+                }
+                client.send_frame(OK, reply);
+            } catch (const std::exception &e) {
+                // Only this connection is lost
+                std::cerr << "Connection dropped: " << e.what() << std::endl;
+                failed = true;
+            }
+            hand_back(std::move(request.connection), stop, failed);
+        }
+    };
+    std::vector<std::thread> threads;
+    for (unsigned i = 0; i < workers; i++) threads.emplace_back(work);
+
+    std::vector<Connection> idle;
+    bool listening = true;
+    std::vector<const UnixSocket *> polled;
+    std::vector<bool> readable;
+    // Queues connection if a whole request arrived, keeps it in still_idle if not, and drops it if it failed
+    auto queue_or_keep = [&](Connection &&connection, bool open, std::vector<Connection> &still_idle) {
+        Pending request;
+        try {
+            if (!UnixSocket::take_frame(connection.received, request.kind, request.payload)) {
+                if (open) still_idle.push_back(std::move(connection));
+                else if (!connection.received.empty()) std::cerr << "Connection dropped inside a request" << std::endl;
+                return;
+            }
+        } catch (const std::exception &e) {
+            std::cerr << "Connection dropped: " << e.what() << std::endl;
+            return;
+        }
+        request.connection = std::move(connection);
+        std::lock_guard<std::mutex> guard(lock);
+        queued.push_back(std::move(request));
+    };
+    while (true) {
+        polled.assign({&wake});
+        if (listening) polled.push_back(&listener);
+        for (const Connection &client : idle) polled.push_back(&client.socket);
+        UnixSocket::wait_readable(polled, readable);
+        size_t first_client = polled.size() - idle.size();
+        std::vector<Connection> still_idle;
+        for (size_t i = 0; i < idle.size(); i++) {
+            if (!readable[i + first_client]) {
+                still_idle.push_back(std::move(idle[i]));
+                continue;
+            }
+            bool open;
+            try {
+                open = idle[i].socket.receive_available(idle[i].received);
+            } catch (const std::exception &e) {
+                std::cerr << "Connection dropped: " << e.what() << std::endl;
+                continue;
+            }
+            queue_or_keep(std::move(idle[i]), open, still_idle);
+        }
+        if (readable[0]) {
+            std::string wakes;
+            wake.receive_available(wakes);
+            std::vector<Connection> back;
+            {
+                std::lock_guard<std::mutex> guard(lock);
+                if (stopping) break;
+                back.swap(returned);
+            }
+            // A client may have sent its next request before the last reply
+            for (Connection &connection : back) queue_or_keep(std::move(connection), true, still_idle);
+        }
+        if (listening && readable[1]) {
+            Connection client;
+            client.socket = listener.accept();
+            // Out of descriptors, say: serve the connections already open
+            if (!client.socket.is_open()) {
+                listening = false;
+            } else {
+                client.socket.set_nonblocking();
+                still_idle.push_back(std::move(client));
+            }
+        }
+        queued_cond.notify_all();
+        idle.swap(still_idle);
+    }
+    {
+        // Ends the sends of the workers still answering, so none waits on a client that does not read
+        std::lock_guard<std::mutex> guard(lock);
+        for (const UnixSocket *client : in_flight) client->shutdown();
+    }
+    queued_cond.notify_all();
+    for (std::thread &thread : threads) thread.join();
+    // Closing the connections left tells their clients the daemon is gone
+    idle.clear();
+    queued.clear();
+    std::remove(socket_path.c_str());
+    std::cout << "Daemon stopped" << std::endl;
+    return 0;
+}
+
+int Daemon::request(const std::string &socket_path, Request kind, const std::vector<std::string> &input_paths,
+                     std::ostream &out) {
+    UnixSocket server = UnixSocket::connect(socket_path);
+    int status = 0;
+    std::vector<std::string> paths = input_paths;
+    if (kind == SHUTDOWN) paths.assign(1, "");
+    for (const std::string &path : paths) {
+        std::string input;
+        try {
+            if (path == "-") input.assign(std::istreambuf_iterator<char>(std::cin), std::istreambuf_iterator<char>());
+            else if (kind != SHUTDOWN) input = FilePrefetcher::read_file(path);
+        } catch (const std::exception &e) {
+            out << path << ": failed, " << e.what() << std::endl;
+            status = 1;
+            continue;
+        }
+        server.send_frame(kind, input);
+        uint8_t reply_kind;
+        std::string reply;
+        if (!server.receive_frame(reply_kind, reply)) throw std::runtime_error("The daemon closed the connection.");
+        if (reply_kind != OK) {
+            out << path << ": failed, " << reply << std::endl;
+            status = 1;
+            continue;
+        }
+        BinaryReader reader(reply.data(), reply.size());
+        if (kind == TOKENIZE) {
+            std::vector<std::string> names(reader.read_u32());
+            for (std::string &name : names) name = reader.read_string();
+            uint32_t count = reader.read_u32();
+            for (uint32_t i = 0; i < count; i++) {
+                const std::string &name = names.at(reader.read_u32());
+                out << std::left << std::setw(10) << reader.read_string() << name << std::endl;
+            }
+        } else if (kind == PARSE) {
+            bool accepted = reader.read_u8() != 0;
+            uint32_t errors = reader.read_u32();
+            uint32_t tokens = reader.read_u32();
+            uint32_t messages = reader.read_u32();
+            for (uint32_t i = 0; i < messages; i++) std::cerr << reader.read_string() << std::endl;
+            out << path << ": " << (accepted ? "accepted" : "rejected") << " (" << errors << " errors, "
+                << tokens << " tokens)" << std::endl;
+            if (!accepted) status = 1;
+        }
+    }
+    return status;
+}
@@ -0,0 +1,52 @@
+#ifndef DAEMON_H
+#define DAEMON_H
+
+# include <cstdint>
+# include <ostream>
+# include <string>
+# include <vector>
+# include "Phase 1/LexicalAnalyzer.h"
+# include "Phase 2/ParserGenerator.h"
+
+/**
+ * Serves tokenize and parse requests on a Unix domain socket with a lexer and parse table built once.
+ * Every request and reply is one UnixSocket frame; a connection may carry any number of requests.
+ *
+ * Requests (payload = the input text):
+ *   TOKENIZE  reply: u32 name count, names; u32 token count, then per token a u32 name index and the lexeme
+ *   PARSE     reply: u8 accepted, u32 error count, u32 token count, u32 message count, messages
+ *   SHUTDOWN  (empty payload) reply: empty. The daemon closes every connection and exits.
+ * The reply kind is OK, or FAILED with the error message as its payload. Integers are little-endian and
+ * strings are a u32 length followed by the bytes.
+ */
+class Daemon {
+public:
+    enum Request : uint8_t { TOKENIZE = 1, PARSE = 2, SHUTDOWN = 3 };
+    enum Reply : uint8_t { OK = 0, FAILED = 1 };
+
+private:
+    const LexicalAnalyzer &lexical_analyzer;
+    const ParserGenerator &parserGenerator;
+    unsigned workers;
+
+    /** Answers one request; sets stop for SHUTDOWN */
+    std::string handle(uint8_t kind, const std::string &payload, bool &stop) const;
+
+public:
+    /** 0 workers means one per hardware thread */
+    Daemon(const LexicalAnalyzer &lexical_analyzer, const ParserGenerator &parserGenerator, unsigned workers = 0);
+    /**
+     * Listens on socket_path until a SHUTDOWN request. The open connections are polled together and every request
+     * is answered by the next free worker thread once all of it has arrived, so a connection holds no worker while
+     * it is idle or still sending.
+     */
+    int serve(const std::string &socket_path) const;
+    /**
+     * Client side: sends kind for every input ("-" is standard input) to the daemon on socket_path and
+     * writes the replies to out. Returns 0 only if every request succeeded (and every parse was accepted).
+     */
+    static int request(const std::string &socket_path, Request kind, const std::vector<std::string> &input_paths,
+                       std::ostream &out);
+};
+
+#endif //DAEMON_H
@@ -2,69 +2,410 @@
 // Created by alimedhat on 30/12/2024.
 //
 
+# include <cstdio>
 # include <iostream>
+# include <thread>
+# include <exception>
+# include <limits>
+# include <memory>
 # include "Phase 1/LexicalAnalyzer.h"
 # include "Phase 2/ParserGenerator.h"
+# include "SpscRing.h"
+# include "WorkStealingPool.h"
+# include "FilePrefetcher.h"
+# include "Stats.h"
+# include "Daemon.h"
+# include "BinaryFile.h"
+# include "TokenFile.h"
+# include "OutputWriter.h"
 
+// Number of tokens the lexer may run ahead of the parser in pipeline mode
+const size_t PIPELINE_RING_SIZE = 4096;
+// Files read ahead in batch mode for every thread scanning them
+const size_t PREFETCH_FILES_PER_WORKER = 4;
+
+/** How the tokens of every input are written: the text symbol table, or a binary token file (see TokenFile) */
+enum class TokenFormat { TEXT, BINARY, VARINT };
+
+/**
+ * Writes the tokens of one input next to it while they are scanned. The text format lists the token stream
+ * before the lexeme / token table, so the table rows wait in a spool file until close()
+ */
+class TokenWriter {
+private:
+    std::string path;
+    std::string table_path;
+    std::unique_ptr<OutputWriter> tokens_file, table_file;
+    std::unique_ptr<TokenFile::Writer> token_file;
+    bool closed = false;
+
+public:
+    TokenWriter(const std::string &report_path, TokenFormat format) {
+        std::string base = report_path.substr(0, report_path.find_last_of('.'));
+        if (format != TokenFormat::TEXT) {
+            path = base + "_tokens.bin";
+            token_file.reset(new TokenFile::Writer(path, format == TokenFormat::VARINT));
+            return;
+        }
+        path = base + "_tokens_SymbolTable.txt";
+        table_path = path + ".table";
+        // The token files of large inputs are big, so they are written on a background thread
+        tokens_file.reset(new OutputWriter(path, true));
+        table_file.reset(new OutputWriter(table_path, true));
+    }
+
+    ~TokenWriter() {
+        if (!table_file) return;
+        // A scan that failed leaves no half written token file behind
+        if (!closed) {
+            tokens_file->close();
+            std::remove(path.c_str());
+        }
+        table_file->close();
+        std::remove(table_path.c_str());
+    }
+
+    void add(const Symbol &symbol) {
+        if (token_file) {
+            token_file->add(symbol);
+            return;
+        }
+        *tokens_file << symbol.token_name << '\n';
+        table_file->padded(symbol.lexeme, 10) << symbol.token_name;
+        // Capture positions of tagged rules, as offsets in the lexeme
+        for (size_t submatch : symbol.submatches) {
+            if (submatch == TaggedNFA::UNSET) *table_file << " @-";
+            else *table_file << " @" << submatch;
+        }
+        *table_file << '\n';
+    }
+
+    /** Finishes the file and returns its path */
+    const std::string &close() {
+        closed = true;
+        if (token_file) {
+            token_file->close();
+            return path;
+        }
+        //write the pairs in a table in the same file
+        *tokens_file << "Symbol Table:\n";
+        tokens_file->padded("Lexeme", 10) << "Token ID\n";
+        *tokens_file << std::string(30, '-') << '\n'; // Separator line
+        if (table_file->close()) {
+            MappedFile table(table_path);
+            tokens_file->write(table.data(), table.size());
+        }
+        tokens_file->close();
+        return path;
+    }
+};
+
+/** Writes the tokens next to the input at report_path and returns the path of the file written */
+static std::string write_tokens(const std::string &report_path, const std::vector<Symbol> &symbol_table,
+                                TokenFormat format) {
+    TokenWriter writer(report_path, format);
+    for (const Symbol &symbol : symbol_table) writer.add(symbol);
+    return writer.close();
+}
+
+/**
+ * Lexes and parses every input listed (one path per line) in list_path on a shared lexer and parse table,
+ * writing the usual per-file reports, then prints one summary line per file.
+ * Returns 0 only if every input was read and accepted.
+ */
+static int run_batch(const std::string &list_path, const LexicalAnalyzer &lexical_analyzer,
+                     const ParserGenerator &parserGenerator, unsigned jobs, TokenFormat token_format) {
+    std::ifstream list_file(list_path);
+    if (!list_file.is_open()) {
+        std::cerr << "Could not open the batch list " << list_path << std::endl;
+        return 1;
+    }
+    std::vector<std::string> input_paths;
+    std::string line;
+    while (std::getline(list_file, line)) {
+        if (!line.empty() && line.back() == '\r') line.pop_back();
+        if (!line.empty()) input_paths.push_back(line);
+    }
+
+    // Only the outcome of each file is kept, the reports are written by the worker that parsed it
+    struct Outcome {
+        bool accepted = false;
+        size_t errors = 0;
+        std::string failure;
+    };
+    std::vector<Outcome> outcomes(input_paths.size());
+    WorkStealingPool pool(jobs);
+    // The files are read ahead while the workers scan, each worker takes whichever file finished reading first
+    FilePrefetcher prefetcher(input_paths, PREFETCH_FILES_PER_WORKER * pool.size());
+    pool.for_each(input_paths.size(), [&](size_t, unsigned) {
+        FilePrefetcher::File file;
+        if (!prefetcher.next(file)) return;
+        const std::string &input_file_path = input_paths[file.index];
+        Outcome &outcome = outcomes[file.index];
+        try {
+            if (!file.error.empty()) throw std::runtime_error(file.error);
+            InputBuffer input(file.data.data(), file.data.size());
+            std::vector<Symbol> symbol_table = lexical_analyzer.analyze(input);
+            write_tokens(input_file_path, symbol_table, token_format);
+            std::vector<std::string> parser_input;
+            for (const Symbol &symbol : symbol_table) {
+                parser_input.push_back(symbol.token_name);
+            }
+            parser_input.push_back("$");
+            VectorTokenStream tokens(parser_input);
+            ParseResult result = parserGenerator.generateParser(tokens, input_file_path, true);
+            outcome.accepted = result.accepted;
+            outcome.errors = result.errorCount;
+        } catch (const std::exception &e) {
+            outcome.failure = e.what();
+        }
+    });
+
+    size_t accepted = 0;
+    for (size_t i = 0; i < input_paths.size(); i++) {
+        const Outcome &outcome = outcomes[i];
+        if (!outcome.failure.empty()) {
+            std::cout << input_paths[i] << ": failed, " << outcome.failure << std::endl;
+            continue;
+        }
+        std::cout << input_paths[i] << ": " << (outcome.accepted ? "accepted" : "rejected")
+                  << " (" << outcome.errors << " errors)" << std::endl;
+        if (outcome.accepted) accepted++;
+    }
+    std::cout << accepted << " of " << input_paths.size() << " inputs accepted using "
+              << pool.size() << " threads" << std::endl;
+    return accepted == input_paths.size() ? 0 : 1;
+}
+
+
+/** Reads the count after prefix in arg into value. Prints an error and returns false unless it is a number up to max */
+static bool parse_count(const std::string &arg, const std::string &prefix, unsigned long max, unsigned long &value) {
+    std::string digits = arg.substr(prefix.size());
+    bool valid = !digits.empty() && digits.find_first_not_of("0123456789") == std::string::npos;
+    if (valid) {
+        try {
+            value = std::stoul(digits);
+        } catch (const std::out_of_range &) {
+            valid = false;
+        }
+    }
+    if (!valid || value > max) {
+        std::cerr << "Invalid number in option: " << arg << std::endl;
+        return false;
+    }
+    return true;
+}
 
 
 int main(int argc, char *argv[]){
     std::string rules_file_path, output_file_path, parser_rules_file_path;
-    vector<string> parser_input;
-    if (argc != 3) {
+    std::string emit_parser_prefix;
+    std::string batch_list_path;
+    unsigned jobs = 0;
+    std::string stats_path;
+    std::string serve_path, connect_path;
+    Daemon::Request request = Daemon::TOKENIZE;
+    LexerOptions lexer_options;
+    bool pipeline = false;
+    bool parse_tokens = false;
+    TokenFormat token_format = TokenFormat::TEXT;
+    // Options start with "--", everything else is positional
+    std::vector<std::string> args;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg.rfind("--emit-parser=", 0) == 0) {
+            emit_parser_prefix = arg.substr(std::string("--emit-parser=").size());
+        } else if (arg == "--pipeline") {
+            pipeline = true;
+        } else if (arg == "--parse-tokens") {
+            parse_tokens = true;
+        } else if (arg.rfind("--batch=", 0) == 0) {
+            batch_list_path = arg.substr(std::string("--batch=").size());
+        } else if (arg.rfind("--stats=", 0) == 0) {
+            stats_path = arg.substr(std::string("--stats=").size());
+        } else if (arg == "--dfa=direct") {
+            lexer_options.construction = LexerOptions::DIRECT;
+        } else if (arg == "--dfa=subset") {
+            lexer_options.construction = LexerOptions::SUBSET;
+        } else if (arg == "--dfa=derivative") {
+            lexer_options.construction = LexerOptions::DERIVATIVE;
+        } else if (arg == "--dfa=lazy") {
+            lexer_options.construction = LexerOptions::LAZY;
+        } else if (arg == "--incremental") {
+            lexer_options.incremental = true;
+        } else if (arg == "--keyword-hash") {
+            lexer_options.keyword_hash = true;
+        } else if (arg.rfind("--lazy-cache=", 0) == 0) {
+            unsigned long states;
+            if (!parse_count(arg, "--lazy-cache=", std::numeric_limits<size_t>::max(), states)) return 1;
+            lexer_options.lazy_cache_states = states;
+        } else if (arg.rfind("--dfa-jobs=", 0) == 0) {
+            unsigned long count;
+            if (!parse_count(arg, "--dfa-jobs=", std::numeric_limits<unsigned>::max(), count)) return 1;
+            lexer_options.jobs = static_cast<unsigned>(count);
+        } else if (arg.rfind("--jobs=", 0) == 0) {
+            unsigned long count;
+            if (!parse_count(arg, "--jobs=", std::numeric_limits<unsigned>::max(), count)) return 1;
+            jobs = static_cast<unsigned>(count);
+        } else if (arg == "--token-format=text") {
+            token_format = TokenFormat::TEXT;
+        } else if (arg == "--token-format=binary") {
+            token_format = TokenFormat::BINARY;
+        } else if (arg == "--token-format=varint") {
+            token_format = TokenFormat::VARINT;
+        } else if (arg.rfind("--serve=", 0) == 0) {
+            serve_path = arg.substr(std::string("--serve=").size());
+        } else if (arg.rfind("--connect=", 0) == 0) {
+            connect_path = arg.substr(std::string("--connect=").size());
+        } else if (arg == "--request=tokenize") {
+            request = Daemon::TOKENIZE;
+        } else if (arg == "--request=parse") {
+            request = Daemon::PARSE;
+        } else if (arg == "--request=shutdown") {
+            request = Daemon::SHUTDOWN;
+        } else if (arg.rfind("--", 0) == 0) {
+            std::cerr << "Unknown option: " << arg << std::endl;
+            return 1;
+        } else {
+            args.push_back(arg);
+        }
+    }
+    // Timers and counters are only collected when asked for, and written however main returns
+    struct StatsDump {
+        std::string path;
+        ~StatsDump() {
+            if (path.empty()) return;
+            if (stats::write_json(path)) std::cout << "Stats written to " << path << std::endl;
+            else std::cerr << "Failed to write stats: " << path << std::endl;
+        }
+    } stats_dump{stats_path};
+    if (!stats_path.empty()) stats::enable();
+
+    // A client only needs the daemon, the positional arguments are its inputs
+    if (!connect_path.empty()) {
+        try {
+            return Daemon::request(connect_path, request, args, std::cout);
+        } catch (const std::exception &e) {
+            std::cerr << e.what() << std::endl;
+            return 1;
+        }
+    }
+
+    // Either prompt for every path, or take <lexical rules> <parser rules> <input> and run once.
+    // In batch mode the inputs come from the --batch list instead, and a daemon gets them from its clients.
+    bool batch = !batch_list_path.empty();
+    bool serve = !serve_path.empty();
+    bool interactive = args.size() != (batch || serve ? 2 : 3);
+    if (interactive) {
         std::cout << "Enter the path to the lexical rules file: ";
         std::cin >> rules_file_path;
         std::cout << "Enter the path to the Parser rules file: ";
         std::cin >> parser_rules_file_path;
     } else {
-        rules_file_path = argv[1];
+        rules_file_path = args[0];
+        parser_rules_file_path = args[1];
     }
 
     // Initialize the lexical analyzer based on the rules file
     output_file_path = rules_file_path.substr(0, rules_file_path.find_last_of('.')) + "_minimized_DFA.txt";
-    LexicalAnalyzer lexical_analyzer(rules_file_path, output_file_path);
+    LexicalAnalyzer lexical_analyzer(rules_file_path, output_file_path, lexer_options);
     ParserGenerator parserGenerator(parser_rules_file_path);
     parserGenerator.printAll(parser_rules_file_path);
+    if (!emit_parser_prefix.empty()) parserGenerator.emitParser(emit_parser_prefix);
+    if (batch) return run_batch(batch_list_path, lexical_analyzer, parserGenerator, jobs, token_format);
+    if (serve) return Daemon(lexical_analyzer, parserGenerator, jobs).serve(serve_path);
     while (true)
     {
         std::cout << "To exit, type 'exit'." << std::endl;
         std::string input_file_path;
-        if (argc != 3) {
+        if (interactive) {
             std::cout << "Enter the path to the input file: ";
             std::cin >> input_file_path;
         } else {
-            input_file_path = argv[2];
+            input_file_path = args[2];
         }
-        if (input_file_path == "exit") {
+        if (input_file_path == "exit" || !std::cin) {
             break;
         }
 
-        std::ifstream input_file(input_file_path, std::ios::binary);
-        std::vector<Symbol> symbol_table = lexical_analyzer.analyze(input_file);
-        //close the input file
-        input_file.close();
-        //before the file extension in the input file path add _tokens
-        std::string tokens_file_path = input_file_path.substr(0, input_file_path.find_last_of('.')) + "_tokens_SymbolTable.txt";
-        //write the tokens to the new tokens file
-        std::ofstream tokens_file(tokens_file_path);
-        for (const Symbol &symbol : symbol_table) {
-            // Should be put in a vector of strings as the input for the parser
-            parser_input.push_back(symbol.token_name);
-            tokens_file << symbol.token_name << std::endl;
-        }
-        parser_input.push_back("$");
-        //write the pairs in a table in the same file
-        tokens_file << "Symbol Table:" << std::endl;
-        tokens_file << std::left << std::setw(10) << "Lexeme" << "Token ID" << std::endl;
-        tokens_file << std::string(30, '-') << std::endl; // Separator line
-        for (const Symbol &symbol : symbol_table) {
-            //write only symbols with a token id = id
-            tokens_file << std::left << std::setw(10) << symbol.lexeme << symbol.token_name << std::endl;
-        }
-        parserGenerator.generateParser(parser_input, input_file_path);
-        tokens_file.close();
-        std::cout << "Tokens written to " << tokens_file_path << std::endl;
+        if (parse_tokens) {
+            // A token file written with --token-format=binary or varint feeds the parser straight from its map
+            try {
+                TokenFile token_file(input_file_path);
+                TokenFileStream tokens(token_file);
+                parserGenerator.generateParser(tokens, input_file_path);
+            } catch (const std::exception &e) {
+                std::cerr << "Could not parse " << input_file_path << ": " << e.what() << std::endl;
+                if (!interactive) return 1;
+            }
+            if (!interactive) break;
+            continue;
+        }
 
+        // "-" scans standard input (a pipe, say) as it arrives, its reports are named after "stdin"
+        std::unique_ptr<InputBuffer> input;
+        try {
+            input.reset(new InputBuffer(input_file_path));
+        } catch (const std::exception &e) {
+            std::cerr << e.what() << std::endl;
+            if (!interactive) return 1;
+            continue;
+        }
+        std::string report_path = input_file_path == "-" ? "stdin" : input_file_path;
+        std::string tokens_file_path;
+        if (pipeline) {
+            // The lexer runs on its own thread, writing each token to the token file and handing its name to
+            // the parser as it recognizes it; the parser writes its reports as it goes, so no whole token list
+            // is kept anywhere
+            SpscRing<std::string> ring(PIPELINE_RING_SIZE);
+            std::exception_ptr lexer_error;
+            std::thread lexer_thread([&]() {
+                try {
+                    TokenWriter token_writer(report_path, token_format);
+                    lexical_analyzer.analyze(*input, [&](Symbol &&symbol) {
+                        ring.push(symbol.token_name);
+                        token_writer.add(symbol);
+                    });
+                    tokens_file_path = token_writer.close();
+                } catch (...) {
+                    lexer_error = std::current_exception();
+                }
+                ring.push("$");
+                ring.close();
+            });
+            RingTokenStream tokens(ring);
+            parserGenerator.generateParser(tokens, report_path);
+            lexer_thread.join();
+            if (lexer_error) {
+                try {
+                    std::rethrow_exception(lexer_error);
+                } catch (const std::exception &e) {
+                    std::cerr << "Could not scan " << report_path << ": " << e.what() << std::endl;
+                    if (!interactive) return 1;
+                    continue;
+                }
+            }
+        } else {
+            std::vector<Symbol> symbol_table;
+            try {
+                symbol_table = lexical_analyzer.analyze(*input);
+            } catch (const std::exception &e) {
+                std::cerr << "Could not scan " << report_path << ": " << e.what() << std::endl;
+                if (!interactive) return 1;
+                continue;
+            }
+            //write the tokens to the new tokens file
+            tokens_file_path = write_tokens(report_path, symbol_table, token_format);
+            // The token names are the input for the parser
+            std::vector<std::string> parser_input;
+            for (const Symbol &symbol : symbol_table) {
+                parser_input.push_back(symbol.token_name);
+            }
+            parser_input.push_back("$");
+            parserGenerator.generateParser(parser_input, report_path);
+        }
+        std::cout << "Tokens written to " << tokens_file_path << std::endl;
+        if (!interactive) break;
     }
     return 0;
 }
@@ -1,4 +1,5 @@
 #include "DFA.h"
+#include "OutputWriter.h"
 #pragma clang diagnostic push
 #pragma clang diagnostic ignored "-Wunqualified-std-cast-call"
 using namespace std;
@@ -78,6 +79,58 @@ void DFA::make_initial(int state) {
 }
 
 
+int DFA::get_initial(int mode) const {
+  if (mode == 0 && mode_initial_states.empty()) return initial_state;
+  if (mode < 0 || mode >= get_mode_count()) throw runtime_error("Unknown start condition.");
+  return mode_initial_states[mode];
+}
+
+
+int DFA::get_mode_count() const {
+  return mode_initial_states.empty() ? 1 : static_cast<int>(mode_initial_states.size());
+}
+
+
+void DFA::make_mode_initials(vector<int> states) {
+  for (int state : states) {
+    if (!this->contains_state(state)) throw runtime_error("State to made initial does not exist in the DFA.");
+  }
+  if (states.empty()) throw runtime_error("A DFA needs at least one initial state.");
+  make_initial(states.front());
+  mode_initial_states = states.size() > 1 ? move(states) : vector<int>();
+}
+
+
+DFA DFA::combine(const vector<DFA>& modes) {
+  if (modes.size() == 1) return modes.front();
+  DFA combined(modes.front().input_domain);
+  int next_state = 0, dead_state = -1;
+  vector<int> initials;
+  for (const DFA& mode : modes) {
+    // Renumber the mode's states after the previous modes'
+    int mode_dead = mode.get_dead_state();
+    unordered_map<int, int> ids;
+    for (int state : mode.states) {
+      if (state == mode_dead) {
+        if (dead_state == -1) combined.add_state(dead_state = next_state++);
+        ids[state] = dead_state;
+      } else {
+        combined.add_state(ids[state] = next_state++);
+      }
+    }
+    for (const auto& pair : mode.transitions) {
+      unordered_map<char, int> row;
+      for (const auto& tr : pair.second) row[tr.first] = ids.at(tr.second);
+      combined.add_transitions(ids.at(pair.first), move(row));
+    }
+    for (const auto& pair : mode.accepting_states) combined.make_accepting(ids.at(pair.first), pair.second);
+    initials.push_back(ids.at(mode.initial_state));
+  }
+  combined.make_mode_initials(move(initials));
+  return combined;
+}
+
+
 void DFA::make_accepting(int state, int token_id) {
   if (!this->contains_state(state)) throw runtime_error("State to be made accepting does not exist in the DFA.");
   accepting_states[state] = token_id;
@@ -139,7 +192,27 @@ int DFA::accept(int state) const {
 }
 
 
-void DFA::print_dfa(unordered_map<char, char> tokenChars, unordered_map<int, string> tokens) const {
+void DFA::print_dfa() const {
+  cout << "DFA components:\n" << endl;
+
+  cout << "States: ";
+  for (int state : states) cout << state << " ";
+  cout << endl;
+
+  cout << "Initial state: " << initial_state << endl;
+
+  cout << "Accepting states:\n";
+  for (auto pair : accepting_states) cout << "\t" << pair.first << " with token id " << pair.second << endl;
+
+  cout << "Transitions:" << endl;
+  for (const auto& pair : transitions) {
+    cout << "\tFrom state " << pair.first << ":" << endl;
+    for (auto tr : pair.second) cout << "\t\t---- " << static_cast<int>(tr.first) << " ----> " << tr.second << endl;
+  }
+}
+
+
+void DFA::print_dfa(const unordered_map<char, char>& tokenChars, const unordered_map<int, string>& tokens) const {
   cout << "DFA components:\n" << endl;
 
   cout << "Input domain: ";
@@ -172,8 +245,9 @@ void DFA::print_dfa(unordered_map<char, char> tokenChars, unordered_map<int, str
   }
 }
 
-void DFA::print_dfa(unordered_map<char, char> tokenChars, unordered_map<int, string> tokens, const string& output_file_path) const {
-    ofstream output_file(output_file_path);
+void DFA::print_dfa(const unordered_map<char, char>& tokenChars, const unordered_map<int, string>& tokens,
+                    const string& output_file_path) const {
+    OutputWriter output_file(output_file_path);
     if (!output_file.is_open()) {
         cerr << "Error: Could not open file "
              << output_file_path
@@ -181,38 +255,43 @@ void DFA::print_dfa(unordered_map<char, char> tokenChars, unordered_map<int, str
         return;
     }
 
-    output_file << "DFA components:\n" << endl;
+    output_file << "DFA components:\n\n";
 
     output_file << "Input domain: ";
     for (char symbol: input_domain) output_file << tokenChars.at(symbol) << " ";
-    output_file << endl;
+    output_file << '\n';
 
     output_file << "States: ";
     for (int state: states) output_file << state << " ";
-    output_file << endl;
+    output_file << '\n';
 
-    output_file << "Initial state: " << initial_state << endl;
+    output_file << "Initial state: " << initial_state << '\n';
+    if (!mode_initial_states.empty()) {
+        output_file << "Mode initial states: ";
+        for (int state: mode_initial_states) output_file << state << " ";
+        output_file << '\n';
+    }
 
     output_file << "Accepting states:\n";
     for (auto pair: accepting_states)
         output_file << "\t" << pair.first << " with token id " << pair.second << " token "
-                    << tokens.at(accepting_states.at(pair.first)) << endl;
+                    << tokens.at(accepting_states.at(pair.first)) << '\n';
 
-    output_file << "Transitions:" << endl;
+    output_file << "Transitions:\n";
     for (const auto &pair: transitions) {
         if (accepting_states.find(pair.first) != accepting_states.end()) {
             output_file << "\tFrom state " << pair.first << " Accepting class with token number "
-                        << tokens.at(accepting_states.at(pair.first)) << ":" << endl;
+                        << tokens.at(accepting_states.at(pair.first)) << ":\n";
         } else
-            output_file << "\tFrom state " << pair.first << ":" << endl;
+            output_file << "\tFrom state " << pair.first << ":\n";
         for (auto tr: pair.second) {
             if (accepting_states.find(tr.second) != accepting_states.end()) {
 
                 output_file << "\t\t---- " << tokenChars.at(tr.first) << " ----> " << tr.second << " token: "
-                            << tokens.at(accepting_states.at(tr.second)) << endl;
+                            << tokens.at(accepting_states.at(tr.second)) << '\n';
                 continue;
             }
-            output_file << "\t\t---- " << tokenChars.at(tr.first) << " ----> " << tr.second << endl;
+            output_file << "\t\t---- " << tokenChars.at(tr.first) << " ----> " << tr.second << '\n';
         }
     }
     output_file.close();
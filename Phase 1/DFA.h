@@ -12,6 +12,7 @@ class DFA {
     std::unordered_set<int> states;
     std::unordered_map<int, std::unordered_map<char, int>> transitions;
     int initial_state;
+    std::vector<int> mode_initial_states; // Initial state of every start condition, empty if there is only one
     std::unordered_map<int, int> accepting_states;
     // /** Returns a map of all unique state pairs to a boolean indicating distinguishability */
     // map<pair<int, int>, bool> distinguish_states() const; 
@@ -36,6 +37,10 @@ class DFA {
     std::vector<char> get_input_domain() const;
     /** Returns the initial state */
     int get_initial() const;
+    /** Returns the initial state of a start condition (mode); mode 0 starts at get_initial() */
+    int get_initial(int mode) const;
+    /** Returns the number of start conditions, 1 unless the DFA was combined from several */
+    int get_mode_count() const;
     /** Returns the set of states of the DFA. */
     std::unordered_set<int> get_states() const;
     /** Returns a map of accepting states and their corresponding token ids. */
@@ -54,6 +59,13 @@ class DFA {
     void remove_state(int state, bool reachable);
     /** Set a state to be the initial state. */
     void make_initial(int state);
+    /** Set the initial state of every start condition, the first one becoming the initial state. */
+    void make_mode_initials(std::vector<int> states);
+    /**
+     * Returns one DFA holding the (minimized) DFAs of several start conditions side by side, mode i starting
+     * at get_initial(i). Their dead states become one state. The DFAs must share an input domain.
+     */
+    static DFA combine(const std::vector<DFA>& modes);
     /** Set a state to be an accepting state with a certain token id. */
     void make_accepting(int state, int token_id);
     /** Add a transition from src to dst on input symbol. */
@@ -73,10 +85,13 @@ class DFA {
     /** Returns the minimal equivalent DFA */
     // DFA minimize() const;
 
+    /** Function to print the DFA components for debugging, with raw character and token ids */
+    void print_dfa() const;
     /** Function to print the DFA components for debugging */
-    void print_dfa(std::unordered_map<char, char>, std::unordered_map<int, std::string>) const;
+    void print_dfa(const std::unordered_map<char, char>&, const std::unordered_map<int, std::string>&) const;
     /** Function to write the DFA components in a file */
-    void print_dfa(std::unordered_map<char, char>, std::unordered_map<int, std::string>, const std::string&) const;
+    void print_dfa(const std::unordered_map<char, char>&, const std::unordered_map<int, std::string>&,
+                   const std::string&) const;
 };
 
 #endif
\ No newline at end of file
@@ -1,7 +1,9 @@
 #include "DFAMinimizer.h"
+#include "Stats.h"
+#include "WorkStealingPool.h"
 using namespace std;
 
-DFAMinimizer::DFAMinimizer(DFA& dfa) : dfa(dfa) {
+DFAMinimizer::DFAMinimizer(DFA& dfa, unsigned threads) : dfa(dfa), threads(threads) {
   if (!dfa.validate()) throw runtime_error("Invalid or incomplete DFA passed to DFAMinimizer.");
 }
 
@@ -52,23 +54,104 @@ map<pair<int, int>, bool> DFAMinimizer::distinguish_states() const {
 }
 
 
+unordered_map<int, int> DFAMinimizer::refine_partition() const {
+  WorkStealingPool pool(this->threads);
+  vector<char> domain = this->dfa.get_input_domain();
+  unordered_set<int> state_set = this->dfa.get_states();
+  vector<int> states(state_set.begin(), state_set.end());
+  sort(states.begin(), states.end());
+  size_t n = states.size(), width = domain.size() + 1;
+  unordered_map<int, int> index;
+  for (size_t i = 0; i < n; i++) index[states[i]] = static_cast<int>(i);
+  vector<int> next(n * domain.size());
+  for (size_t i = 0; i < n; i++) {
+    for (size_t a = 0; a < domain.size(); a++) next[i * domain.size() + a] = index.at(this->dfa.transition(states[i], domain[a]));
+  }
+
+  // Round 0 splits the states by the token they accept
+  vector<int> block(n);
+  size_t blocks = 0;
+  {
+    unordered_map<int, int> token_blocks;
+    for (size_t i = 0; i < n; i++) {
+      auto found = token_blocks.emplace(this->dfa.accept(states[i]), static_cast<int>(token_blocks.size())).first;
+      block[i] = found->second;
+    }
+    blocks = token_blocks.size();
+  }
+
+  // Every round splits the blocks by signature: own block, then the block reached on each symbol
+  vector<int> signature(n * width);
+  vector<size_t> hashes(n);
+  auto hash = [&](int state) { return hashes[state]; };
+  auto same = [&](int a, int b) {
+    return equal(signature.begin() + a * width, signature.begin() + (a + 1) * width, signature.begin() + b * width);
+  };
+  const size_t CHUNK = 1024;
+  while (true) {
+    pool.for_each((n + CHUNK - 1) / CHUNK, [&](size_t chunk, unsigned) {
+      for (size_t i = chunk * CHUNK; i < min(n, (chunk + 1) * CHUNK); i++) {
+        int* row = &signature[i * width];
+        row[0] = block[i];
+        uint64_t h = 1469598103934665603ULL ^ static_cast<uint32_t>(block[i]);
+        for (size_t a = 0; a + 1 < width; a++) {
+          row[a + 1] = block[next[i * (width - 1) + a]];
+          h = (h ^ static_cast<uint32_t>(row[a + 1])) * 1099511628211ULL;
+        }
+        hashes[i] = static_cast<size_t>(h);
+      }
+    });
+    unordered_map<int, int, decltype(hash), decltype(same)> ids(n, hash, same);
+    vector<int> refined(n);
+    for (size_t i = 0; i < n; i++) {
+      refined[i] = ids.emplace(static_cast<int>(i), static_cast<int>(ids.size())).first->second;
+    }
+    block.swap(refined);
+    if (ids.size() == blocks) break;
+    blocks = ids.size();
+  }
+
+  // Number the blocks of several states by their smallest state, as minimize() numbers its classes, and leave
+  // the single states for minimize() to number
+  vector<vector<int>> members(blocks);
+  vector<int> first_blocks;
+  for (size_t i = 0; i < n; i++) {
+    if (members[block[i]].empty()) first_blocks.push_back(block[i]);
+    members[block[i]].push_back(states[i]);
+  }
+  unordered_map<int, int> partition;
+  int mapping_counter = 1;
+  for (int b : first_blocks) {
+    if (members[b].size() < 2) continue;
+    for (int state : members[b]) partition[state] = mapping_counter;
+    mapping_counter++;
+  }
+  return partition;
+}
+
+
 DFA DFAMinimizer::partition_dfa(unordered_map<int, int>& partition) const {
   // Initialize new states and transitions
   unordered_set<int> new_states;
   unordered_map<int, unordered_map<char, int>> new_transitions;
   unordered_map<int, int> new_accepting_states;
-  // Loop over each state mapping s = (S, S')
-  for (auto &s : partition) {
+  // Visit the original states in ascending order, so the new DFA does not depend on the order the map was filled in
+  vector<int> originals;
+  for (auto &s : partition) originals.push_back(s.first);
+  sort(originals.begin(), originals.end());
+  // Loop over each state mapping (S, S')
+  for (int original : originals) {
+    int mapped = partition[original];
     // Add the state mapping to new state if it wasn't added before
-    new_states.insert(s.second);
+    new_states.insert(mapped);
     // Add the mapped transitions out of the original state
-    for (auto &tr : this->dfa.get_transitions_from(s.first)){ // all transitions (a,T) from S
-      new_transitions[s.second][tr.first] = partition[tr.second]; // S' -> T' on input a
+    for (auto &tr : this->dfa.get_transitions_from(original)){ // all transitions (a,T) from S
+      new_transitions[mapped][tr.first] = partition[tr.second]; // S' -> T' on input a
     }
     // If the original state accepts some token, make the mapped state accept the same token
-    int token = this->dfa.accept(s.first);
+    int token = this->dfa.accept(original);
     if (token != -1)
-      new_accepting_states[s.second] = token;
+      new_accepting_states[mapped] = token;
   }
   // Construct and return the new DFA
   return DFA(
@@ -102,12 +185,17 @@ void DFAMinimizer::remove_unreachable() const {
 
 
 DFA DFAMinimizer::minimize() const {
+  stats::ScopedTimer timer("lexer.minimize");
   // Remove unreachable states
   this->remove_unreachable();
+  if (stats::enabled()) stats::count("lexer.reachable_dfa_states", static_cast<long long>(this->dfa.get_states().size()));
   // Construct the partition mapping (state -> partition number) based on distinguishable states
   unordered_map<int, int> partition;
   int mapping_counter = 1;
-  { // Code block to limit the scope of distinguishable
+  if (this->threads != 1) {
+    partition = this->refine_partition();
+    for (auto& mapping : partition) mapping_counter = max(mapping_counter, mapping.second + 1);
+  } else { // Code block to limit the scope of distinguishable
     map<pair<int,int>,bool> distinguishable = this->distinguish_states();
     // Collect indistinguishable pairs
     int i, j;
@@ -125,11 +213,16 @@ DFA DFAMinimizer::minimize() const {
     }
   } // End of code block
 
-  // Map the remaining unmapped states to a new value each
-  for (int s : this->dfa.get_states()) {
+  // Map the remaining unmapped states to a new value each, in ascending order
+  unordered_set<int> state_set = this->dfa.get_states();
+  vector<int> states(state_set.begin(), state_set.end());
+  sort(states.begin(), states.end());
+  for (int s : states) {
     if (partition[s] == 0) partition[s] = mapping_counter++;
   }
 
   // Construct and return the new DFA based on the partition
-  return this->partition_dfa(partition);
+  DFA minimized = this->partition_dfa(partition);
+  if (stats::enabled()) stats::count("lexer.minimized_dfa_states", static_cast<long long>(minimized.get_states().size()));
+  return minimized;
 }
\ No newline at end of file
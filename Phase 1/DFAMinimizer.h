@@ -6,15 +6,25 @@
 class DFAMinimizer {
   private:
     DFA& dfa;
+    unsigned threads;
     /** Returns a map of all unique state pairs to a boolean indicating distinguishability */
     std::map<std::pair<int, int>, bool> distinguish_states() const; 
+    /**
+     * Returns the mapping state ID -> partition number from Moore-style refinement rounds, computing the state
+     * signatures of every round in parallel. Only partitions of several states are mapped, numbered by their
+     * smallest state like the classes minimize() finds from distinguish_states().
+     */
+    std::unordered_map<int, int> refine_partition() const;
     /** Rebuilds the current DFA based on some input partition / mapping of old state ID -> new state ID */
     DFA partition_dfa(std::unordered_map<int, int>& partition) const; 
     /** Removes unreachable states from the DFA */
     void remove_unreachable() const;
   public:
-    /** Constructor that has a read-only reference to a DFA */
-    DFAMinimizer(DFA& dfa);
+    /**
+     * Constructor that has a read-only reference to a DFA. With more than one thread (0 for one per hardware
+     * thread) the partition is refined in parallel rounds; the minimal DFA is the same either way.
+     */
+    explicit DFAMinimizer(DFA& dfa, unsigned threads = 1);
     /** Minimize a DFA */
     DFA minimize() const;
 };
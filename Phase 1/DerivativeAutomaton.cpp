@@ -0,0 +1,242 @@
+#include "DerivativeAutomaton.h"
+#include "Stats.h"
+#include <algorithm>
+#include <climits>
+#include <stdexcept>
+using namespace std;
+
+const int DerivativeAutomaton::EMPTY_NODE;
+const int DerivativeAutomaton::EPSILON_NODE;
+
+namespace {
+  uint64_t node_key(int kind, char symbol, int left, int right) {
+    return (static_cast<uint64_t>(kind) << 60) ^ (static_cast<uint64_t>(static_cast<unsigned char>(symbol)) << 52) ^
+           (static_cast<uint64_t>(static_cast<uint32_t>(left) & 0x3FFFFFF) << 26) ^
+           (static_cast<uint64_t>(static_cast<uint32_t>(right) & 0x3FFFFFF));
+  }
+}
+
+
+DerivativeAutomaton::DerivativeAutomaton(const vector<pair<int, RegexAST>>& tokens, size_t max_states)
+    : max_states(max(max_states, static_cast<size_t>(4))) {
+  make(EMPTY, 0, -1, -1);
+  make(EPSILON, 0, -1, -1);
+  unordered_map<const RegexAST*, int> definitions;
+  for (const auto& token : tokens) {
+    token_ids.push_back(token.first);
+    token_roots.push_back(translate(token.second, definitions));
+  }
+  base_nodes = nodes.size();
+  // Derived expressions get several times the room of the states that reference them
+  max_nodes = base_nodes + 64 * this->max_states;
+  reset_states();
+}
+
+
+int DerivativeAutomaton::translate(const RegexAST& tree, unordered_map<const RegexAST*, int>& definitions) {
+  // Children precede parents in the tree, so one pass translates it
+  const vector<RegexNode>& tree_nodes = tree.get_nodes();
+  vector<int> translated(tree_nodes.size());
+  for (size_t i = 0; i < tree_nodes.size(); ++i) {
+    const RegexNode& node = tree_nodes[i];
+    switch (node.kind) {
+      case RegexNode::SYMBOL: translated[i] = make_symbol(node.symbol); break;
+      case RegexNode::EPSILON: translated[i] = EPSILON_NODE; break;
+      case RegexNode::CONCAT: translated[i] = make_concat(translated[node.left], translated[node.right]); break;
+      case RegexNode::UNION: translated[i] = make_union(translated[node.left], translated[node.right]); break;
+      case RegexNode::STAR: translated[i] = make_star(translated[node.left]); break;
+      case RegexNode::PLUS:
+        translated[i] = make_concat(translated[node.left], make_star(translated[node.left]));
+        break;
+      case RegexNode::OPTIONAL: translated[i] = make_union(translated[node.left], EPSILON_NODE); break;
+      case RegexNode::REFERENCE: {
+        const RegexAST* definition = tree.get_definition(node.token).get();
+        auto found = definitions.find(definition);
+        translated[i] = found != definitions.end() ? found->second : translate(*definition, definitions);
+        definitions[definition] = translated[i];
+        break;
+      }
+      case RegexNode::END: throw runtime_error("Unexpected end marker in a token expression.");
+    }
+  }
+  return translated[tree.get_root()];
+}
+
+
+int DerivativeAutomaton::make(Kind kind, char symbol, int left, int right) {
+  uint64_t key = node_key(kind, symbol, left, right);
+  auto found = node_ids.find(key);
+  if (found != node_ids.end()) {
+    const Node& node = nodes[found->second];
+    if (node.kind == kind && node.symbol == symbol && node.left == left && node.right == right) return found->second;
+  }
+  bool nullable = false;
+  switch (kind) {
+    case EMPTY: case SYMBOL: nullable = false; break;
+    case EPSILON: case STAR: nullable = true; break;
+    case CONCAT: nullable = nodes[left].nullable && nodes[right].nullable; break;
+    case UNION: nullable = nodes[left].nullable || nodes[right].nullable; break;
+  }
+  int id = static_cast<int>(nodes.size());
+  nodes.push_back({kind, symbol, left, right, nullable});
+  // On the (unlikely) key collision the newer node simply is not shared
+  if (found == node_ids.end()) node_ids.emplace(key, id);
+  return id;
+}
+
+
+int DerivativeAutomaton::make_symbol(char symbol) {
+  return make(SYMBOL, symbol, -1, -1);
+}
+
+
+int DerivativeAutomaton::make_concat(int left, int right) {
+  if (left == EMPTY_NODE || right == EMPTY_NODE) return EMPTY_NODE;
+  if (left == EPSILON_NODE) return right;
+  if (right == EPSILON_NODE) return left;
+  // Keep concatenations right nested: (a b) c -> a (b c)
+  if (nodes[left].kind == CONCAT) return make_concat(nodes[left].left, make_concat(nodes[left].right, right));
+  return make(CONCAT, 0, left, right);
+}
+
+
+int DerivativeAutomaton::make_union(int left, int right) {
+  if (left == right) return left;
+  if (left == EMPTY_NODE) return right;
+  if (right == EMPTY_NODE) return left;
+  // Unions are right nested chains with strictly increasing, non-union members
+  vector<int> members;
+  for (int side : {left, right}) {
+    int node = side;
+    while (nodes[node].kind == UNION) {
+      members.push_back(nodes[node].left);
+      node = nodes[node].right;
+    }
+    members.push_back(node);
+  }
+  sort(members.begin(), members.end());
+  members.erase(unique(members.begin(), members.end()), members.end());
+  if (members.size() == 1) return members[0];
+  int result = members.back();
+  for (size_t i = members.size() - 1; i-- > 0;) result = make(UNION, 0, members[i], result);
+  return result;
+}
+
+
+int DerivativeAutomaton::make_star(int inner) {
+  if (inner == EMPTY_NODE || inner == EPSILON_NODE) return EPSILON_NODE;
+  if (nodes[inner].kind == STAR) return inner;
+  return make(STAR, 0, inner, -1);
+}
+
+
+int DerivativeAutomaton::derivative(int node, char symbol) {
+  uint64_t key = (static_cast<uint64_t>(node) << 8) | static_cast<unsigned char>(symbol);
+  auto found = derivatives.find(key);
+  if (found != derivatives.end()) return found->second;
+  Node current = nodes[node];
+  int result = EMPTY_NODE;
+  switch (current.kind) {
+    case EMPTY:
+    case EPSILON:
+      result = EMPTY_NODE;
+      break;
+    case SYMBOL:
+      result = current.symbol == symbol ? EPSILON_NODE : EMPTY_NODE;
+      break;
+    case CONCAT: {
+      result = make_concat(derivative(current.left, symbol), current.right);
+      if (nodes[current.left].nullable) result = make_union(result, derivative(current.right, symbol));
+      break;
+    }
+    case UNION:
+      result = make_union(derivative(current.left, symbol), derivative(current.right, symbol));
+      break;
+    case STAR:
+      result = make_concat(derivative(current.left, symbol), node);
+      break;
+  }
+  derivatives.emplace(key, result);
+  return result;
+}
+
+
+int DerivativeAutomaton::intern_state(vector<int> expressions) {
+  auto found = state_ids.find(expressions);
+  if (found != state_ids.end()) return found->second;
+  int id = static_cast<int>(states.size());
+  int token = INT_MAX;
+  for (size_t i = 0; i < expressions.size(); ++i) {
+    if (nodes[expressions[i]].nullable) token = min(token, token_ids[i]);
+  }
+  state_ids.emplace(expressions, id);
+  states.push_back(move(expressions));
+  state_accept.push_back(token == INT_MAX ? -1 : token);
+  transitions.emplace_back(256, -1);
+  stats::count("lexer.lazy_states");
+  return id;
+}
+
+
+void DerivativeAutomaton::reset_states() {
+  states.clear();
+  state_ids.clear();
+  state_accept.clear();
+  transitions.clear();
+  // State 0 is the dead state: nothing is left of any token
+  intern_state(vector<int>(token_roots.size(), EMPTY_NODE));
+  initial_state = intern_state(token_roots);
+}
+
+
+int DerivativeAutomaton::reimport(int node, const vector<Node>& old_nodes, unordered_map<int, int>& memo) {
+  if (node < static_cast<int>(base_nodes)) return node;
+  auto found = memo.find(node);
+  if (found != memo.end()) return found->second;
+  const Node& old = old_nodes[node];
+  int result = EMPTY_NODE;
+  switch (old.kind) {
+    case EMPTY: result = EMPTY_NODE; break;
+    case EPSILON: result = EPSILON_NODE; break;
+    case SYMBOL: result = make_symbol(old.symbol); break;
+    case CONCAT: result = make_concat(reimport(old.left, old_nodes, memo), reimport(old.right, old_nodes, memo)); break;
+    case UNION: result = make_union(reimport(old.left, old_nodes, memo), reimport(old.right, old_nodes, memo)); break;
+    case STAR: result = make_star(reimport(old.left, old_nodes, memo)); break;
+  }
+  memo.emplace(node, result);
+  return result;
+}
+
+
+int DerivativeAutomaton::flush(int state) {
+  stats::count("lexer.lazy_flushes");
+  flush_count++;
+  vector<int> expressions = states[state];
+  vector<Node> old_nodes;
+  old_nodes.swap(nodes);
+  nodes.assign(old_nodes.begin(), old_nodes.begin() + base_nodes);
+  // Forget every derived node, keeping the consing entries of the token expressions
+  for (auto it = node_ids.begin(); it != node_ids.end();) {
+    if (it->second >= static_cast<int>(base_nodes)) it = node_ids.erase(it);
+    else ++it;
+  }
+  derivatives.clear();
+  reset_states();
+  unordered_map<int, int> memo;
+  for (int& expression : expressions) expression = reimport(expression, old_nodes, memo);
+  return intern_state(move(expressions));
+}
+
+
+int DerivativeAutomaton::step(int state, char symbol) {
+  unsigned char index = static_cast<unsigned char>(symbol);
+  int cached = transitions[state][index];
+  if (cached != -1) return cached;
+  if (states.size() >= max_states || nodes.size() >= max_nodes) state = flush(state);
+
+  vector<int> next(states[state].size());
+  for (size_t i = 0; i < next.size(); ++i) next[i] = derivative(states[state][i], symbol);
+  int id = intern_state(move(next));
+  transitions[state][index] = id;
+  return id;
+}
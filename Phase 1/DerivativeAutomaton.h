@@ -0,0 +1,79 @@
+#ifndef DERIVATIVE_AUTOMATON_H
+#define DERIVATIVE_AUTOMATON_H
+#include <cstdint>
+#include <map>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include "LexerAutomaton.h"
+#include "RegexAST.h"
+
+/**
+ * Lazy lexer automaton built from Brzozowski derivatives. A state is the tuple of every token's
+ * remaining expression; stepping on a character takes the derivative of each one, so states are only
+ * built for the inputs actually scanned and startup does no automaton construction at all.
+ *
+ * Expressions are hash-consed and kept in a normal form (unions flattened, sorted and deduplicated,
+ * empty set and epsilon simplified away) so equivalent derivatives share a state and the number of
+ * states stays finite. States and transitions live in a bounded cache; when it fills up everything
+ * except the token expressions is dropped and the current state is rebuilt in the fresh cache.
+ */
+class DerivativeAutomaton : public LexerAutomaton {
+  private:
+    enum Kind { EMPTY, EPSILON, SYMBOL, CONCAT, UNION, STAR };
+    struct Node {
+      Kind kind;
+      char symbol;
+      int left;
+      int right;
+      bool nullable;
+    };
+    // Node ids of the two constants
+    static const int EMPTY_NODE = 0, EPSILON_NODE = 1;
+
+    std::vector<Node> nodes;
+    std::unordered_map<uint64_t, int> node_ids;          // Hash-consing of (kind, symbol, left, right)
+    std::unordered_map<uint64_t, int> derivatives;       // (node, symbol) -> derivative
+    size_t base_nodes;                                   // Nodes of the token expressions, kept across flushes
+    std::vector<int> token_ids;
+    std::vector<int> token_roots;
+
+    std::vector<std::vector<int>> states;                // State -> remaining expression of every token
+    std::map<std::vector<int>, int> state_ids;
+    std::vector<int> state_accept;
+    std::vector<std::vector<int>> transitions;           // State -> next state per character (-1 if not built yet)
+    int initial_state;
+    size_t max_states;
+    size_t flush_count = 0;
+    size_t max_nodes;
+
+    /** Translates a syntax tree into hash-consed nodes, translating each shared definition only once */
+    int translate(const RegexAST& tree, std::unordered_map<const RegexAST*, int>& definitions);
+    int make(Kind kind, char symbol, int left, int right);
+    int make_symbol(char symbol);
+    int make_concat(int left, int right);
+    int make_union(int left, int right);
+    int make_star(int inner);
+    int derivative(int node, char symbol);
+    int intern_state(std::vector<int> expressions);
+    /** Drops every cached state and derived expression, returning the id of state in the new cache */
+    int flush(int state);
+    int reimport(int node, const std::vector<Node>& old_nodes, std::unordered_map<int, int>& memo);
+    void reset_states();
+
+  public:
+    /**
+     * @param tokens Token id and expression of every token.
+     * @param max_states Number of states cached before the cache is flushed (at least 4: dead, initial,
+     * current and next).
+     */
+    DerivativeAutomaton(const std::vector<std::pair<int, RegexAST>>& tokens, size_t max_states);
+    int initial() override { return initial_state; }
+    int step(int state, char symbol) override;
+    int accept(int state) override { return state_accept[state]; }
+    bool is_dead(int state) override { return state == 0; }
+    bool is_thread_safe() const override { return false; }
+    size_t flushes() const override { return flush_count; }
+};
+
+#endif
@@ -0,0 +1,227 @@
+#include "IncrementalGenerator.h"
+#include "BinaryFile.h"
+#include "DFAMinimizer.h"
+#include "Regex2DFA.h"
+#include "Stats.h"
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+using namespace std;
+
+static const char TOKEN_CACHE_MAGIC[8] = {'L', 'X', 'T', 'O', 'K', 'E', 'N', '\0'};
+static const uint32_t TOKEN_CACHE_VERSION = 1;
+
+namespace {
+  struct KeyHash {
+    size_t operator()(const vector<int>& key) const {
+      return static_cast<size_t>(hash_bytes(reinterpret_cast<const char*>(key.data()), key.size() * sizeof(int)));
+    }
+  };
+}
+
+
+IncrementalGenerator::IncrementalGenerator(const string& cache_path, unsigned jobs)
+    : cache_path(cache_path), jobs(jobs) {
+  load();
+}
+
+
+string IncrementalGenerator::path_for(const string& rules_file_path) {
+  return rules_file_path.substr(0, rules_file_path.find_last_of('.')) + "_token_cache.bin";
+}
+
+
+void IncrementalGenerator::load() {
+  try {
+    MappedFile file(cache_path);
+    BinaryReader reader(file.data(), file.size());
+    if (memcmp(reader.read_bytes(sizeof(TOKEN_CACHE_MAGIC)), TOKEN_CACHE_MAGIC, sizeof(TOKEN_CACHE_MAGIC)) != 0) return;
+    if (reader.read_u32() != TOKEN_CACHE_VERSION) return;
+    unordered_map<string, TokenDFA> loaded;
+    uint32_t count = reader.read_u32();
+    for (uint32_t i = 0; i < count; ++i) {
+      string key = reader.read_string();
+      TokenDFA token;
+      uint32_t domain_size = reader.read_u32();
+      const char* domain = reader.read_bytes(domain_size);
+      token.domain.assign(domain, domain + domain_size);
+      uint32_t state_count = reader.read_u32();
+      token.initial = reader.read_i32();
+      if (token.initial < -1 || token.initial >= static_cast<int>(state_count)) return;
+      const char* accepting = reader.read_bytes(state_count);
+      token.accepting.assign(accepting, accepting + state_count);
+      token.transitions.resize(static_cast<size_t>(state_count) * domain_size);
+      for (int& target : token.transitions) {
+        target = reader.read_i32();
+        if (target < -1 || target >= static_cast<int>(state_count)) return;
+      }
+      loaded.emplace(move(key), move(token));
+    }
+    if (reader.at_end()) entries = move(loaded);
+  } catch (const exception&) {
+    // Missing or corrupt cache, every token is compiled again
+  }
+}
+
+
+bool IncrementalGenerator::save() const {
+  BinaryWriter writer(cache_path);
+  writer.write_bytes(TOKEN_CACHE_MAGIC, sizeof(TOKEN_CACHE_MAGIC));
+  writer.write_u32(TOKEN_CACHE_VERSION);
+  writer.write_u32(static_cast<uint32_t>(built.size()));
+  for (const auto& entry : built) {
+    const TokenDFA& token = entry.second;
+    writer.write_string(entry.first);
+    writer.write_u32(static_cast<uint32_t>(token.domain.size()));
+    writer.write_bytes(token.domain.data(), token.domain.size());
+    writer.write_u32(static_cast<uint32_t>(token.accepting.size()));
+    writer.write_i32(token.initial);
+    writer.write_bytes(reinterpret_cast<const char*>(token.accepting.data()), token.accepting.size());
+    for (int target : token.transitions) writer.write_i32(target);
+  }
+  writer.close();
+  if (!writer.ok()) {
+    cerr << "Failed to write token cache: " << cache_path << endl;
+    return false;
+  }
+  return true;
+}
+
+
+IncrementalGenerator::TokenDFA IncrementalGenerator::compile(const RegexAST& ast,
+                                                             const unordered_map<char, char>& char_ids) const {
+  // The token only needs the characters it mentions, every other one leads to its dead state. An id that no
+  // character maps to any more (a character given a new id by a later rule) can never be read, so it is left out
+  unordered_map<char, char> id_chars;
+  for (const auto& pair : char_ids) id_chars[pair.second] = pair.first;
+  vector<char> domain_ids;
+  RegexAST expanded = ast.expanded();
+  for (const RegexNode& node : expanded.get_nodes()) {
+    if (node.kind == RegexNode::SYMBOL && id_chars.count(node.symbol)) domain_ids.push_back(node.symbol);
+  }
+  sort(domain_ids.begin(), domain_ids.end());
+  domain_ids.erase(unique(domain_ids.begin(), domain_ids.end()), domain_ids.end());
+
+  vector<pair<int, RegexAST>> single;
+  single.emplace_back(0, ast);
+  DFA dfa = Regex2DFA().convert(single, domain_ids);
+  // Without any readable character the token can at most match the empty string, there is nothing to minimize
+  DFA minimized = domain_ids.empty() ? dfa : DFAMinimizer(dfa, jobs).minimize();
+  int dead = minimized.get_dead_state();
+
+  // Number the live states breadth-first so equal expressions always give equal entries
+  TokenDFA token;
+  for (char id : domain_ids) token.domain.push_back(id_chars.at(id));
+  token.initial = -1;
+  if (minimized.get_initial() == dead) return token;
+  unordered_map<int, int> number = {{minimized.get_initial(), 0}};
+  vector<int> order = {minimized.get_initial()};
+  for (size_t head = 0; head < order.size(); ++head) {
+    for (char id : domain_ids) {
+      int target = minimized.transition(order[head], id);
+      if (target == dead || number.count(target)) continue;
+      number[target] = static_cast<int>(order.size());
+      order.push_back(target);
+    }
+  }
+  token.initial = 0;
+  for (int state : order) {
+    token.accepting.push_back(minimized.accept(state) != -1 ? 1 : 0);
+    for (char id : domain_ids) {
+      int target = minimized.transition(state, id);
+      token.transitions.push_back(target == dead ? -1 : number.at(target));
+    }
+  }
+  return token;
+}
+
+
+DFA IncrementalGenerator::build(const vector<pair<int, RegexAST>>& tokens, const unordered_map<char, char>& char_ids,
+                                const vector<char>& input_domain) {
+  unordered_map<char, char> id_chars;
+  for (const auto& pair : char_ids) id_chars[pair.second] = pair.first;
+
+  // Compile (or reuse) every token, keeping only the built tokens for the next run
+  vector<const TokenDFA*> components;
+  {
+    stats::ScopedTimer timer("lexer.token_dfas");
+    for (const auto& token : tokens) {
+      string key = token.second.to_string(id_chars);
+      auto found = built.find(key);
+      if (found == built.end()) {
+        auto cached = entries.find(key);
+        if (cached != entries.end()) {
+          stats::count("lexer.token_dfa_hits");
+          found = built.emplace(key, move(cached->second)).first;
+          entries.erase(cached);
+        } else {
+          stats::count("lexer.token_dfa_misses");
+          found = built.emplace(key, compile(token.second, char_ids)).first;
+        }
+      }
+      components.push_back(&found->second);
+    }
+  }
+
+  stats::ScopedTimer timer("lexer.product_construction");
+  // Column of every character id in each component's table, -1 where the component has no such character
+  vector<vector<int>> columns(components.size(), vector<int>(256, -1));
+  for (size_t c = 0; c < components.size(); ++c) {
+    const vector<char>& domain = components[c]->domain;
+    for (size_t i = 0; i < domain.size(); ++i) {
+      columns[c][static_cast<unsigned char>(char_ids.at(domain[i]))] = static_cast<int>(i);
+    }
+  }
+
+  // A product state lists the (component, state) pairs of the tokens still alive; none alive is the dead state
+  const int dead_state = 0, initial_state_id = 1;
+  unordered_map<vector<int>, int, KeyHash> ids;
+  vector<vector<int>> keys;
+  vector<int> initial;
+  for (size_t c = 0; c < components.size(); ++c) {
+    if (components[c]->initial == -1) continue;
+    initial.push_back(static_cast<int>(c));
+    initial.push_back(components[c]->initial);
+  }
+  ids[vector<int>()] = dead_state;
+  keys.emplace_back();
+  ids[initial] = initial_state_id;
+  keys.push_back(initial);
+
+  unordered_set<int> dfa_states = {dead_state};
+  unordered_map<int, unordered_map<char, int>> dfa_transitions;
+  unordered_map<int, int> dfa_accepting;
+  for (char symbol : input_domain) dfa_transitions[dead_state][symbol] = dead_state;
+  for (size_t state = initial_state_id; state < keys.size(); ++state) {
+    dfa_states.insert(static_cast<int>(state));
+    int token = -1;
+    for (size_t i = 0; i < keys[state].size(); i += 2) {
+      int c = keys[state][i], s = keys[state][i + 1];
+      if (components[c]->accepting[s] && (token == -1 || tokens[c].first < token)) token = tokens[c].first;
+    }
+    if (token != -1) dfa_accepting[static_cast<int>(state)] = token;
+
+    unordered_map<char, int>& row = dfa_transitions[static_cast<int>(state)];
+    vector<int> key = keys[state], next;  // keys grows below, so the key is copied
+    for (char symbol : input_domain) {
+      next.clear();
+      for (size_t i = 0; i < key.size(); i += 2) {
+        int c = key[i], column = columns[c][static_cast<unsigned char>(symbol)];
+        if (column == -1) continue;
+        const TokenDFA& component = *components[c];
+        int target = component.transitions[key[i + 1] * component.domain.size() + column];
+        if (target == -1) continue;
+        next.push_back(c);
+        next.push_back(target);
+      }
+      auto found = ids.find(next);
+      if (found == ids.end()) {
+        found = ids.emplace(next, static_cast<int>(keys.size())).first;
+        keys.push_back(next);
+      }
+      row[symbol] = found->second;
+    }
+  }
+  stats::count("lexer.dfa_states", static_cast<long long>(dfa_states.size()));
+  return DFA(input_domain, dfa_states, dfa_transitions, initial_state_id, dfa_accepting);
+}
@@ -0,0 +1,58 @@
+#ifndef INCREMENTAL_GENERATOR_H
+#define INCREMENTAL_GENERATOR_H
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include "DFA.h"
+#include "RegexAST.h"
+
+/**
+ * Builds the lexer DFA one token at a time. Every token is compiled into its own minimized DFA and cached
+ * on disk under the canonical text of its resolved expression; the token DFAs are then merged with a
+ * product construction. After an edit to the rules only the tokens whose expressions changed are compiled
+ * again, the rest (and the merge) start from the cache.
+ */
+class IncrementalGenerator {
+  private:
+    /** Minimized DFA of a single token over the characters it uses, without its dead state */
+    struct TokenDFA {
+      std::vector<char> domain;      // Characters rather than ids, which change when other rules change
+      int initial;                   // -1 if the token matches nothing
+      std::vector<uint8_t> accepting;
+      std::vector<int> transitions;  // state * domain size + character index -> state, -1 for the dead state
+    };
+    std::string cache_path;
+    unsigned jobs;
+    std::unordered_map<std::string, TokenDFA> entries; // Canonical expression -> compiled token, as loaded
+    std::unordered_map<std::string, TokenDFA> built;   // The tokens of the builds so far, what save() keeps
+
+    /** Compiles one token: direct construction, then minimization */
+    TokenDFA compile(const RegexAST& ast, const std::unordered_map<char, char>& char_ids) const;
+    void load();
+
+  public:
+    /**
+     * @param cache_path File the compiled tokens are kept in between runs.
+     * @param jobs Threads for minimizing each token (see DFAMinimizer).
+     */
+    explicit IncrementalGenerator(const std::string& cache_path, unsigned jobs = 1);
+    /** Returns the default token cache path for a rules file */
+    static std::string path_for(const std::string& rules_file_path);
+    /**
+     * Returns a DFA (dead state 0, initial state 1) for the union of the tokens, compiling the tokens that
+     * are not cached yet. Afterwards the cache only holds the tokens of the builds since it was loaded, so a
+     * lexer with several start conditions can build the automaton of each mode in turn.
+     *
+     * @param tokens Token id and expression of every token.
+     * @param char_ids Input character -> character id.
+     * @param input_domain The input symbols that the DFA recognizes.
+     */
+    DFA build(const std::vector<std::pair<int, RegexAST>>& tokens, const std::unordered_map<char, char>& char_ids,
+              const std::vector<char>& input_domain);
+    /** Writes the compiled tokens to the cache file. Returns false if it could not be written. */
+    bool save() const;
+};
+
+#endif
@@ -0,0 +1,169 @@
+#include "InputBuffer.h"
+#include <cerrno>
+#include <iostream>
+#include <stdexcept>
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+using namespace std;
+
+const size_t InputBuffer::DEFAULT_HALF_SIZE;
+const char InputBuffer::SENTINEL;
+
+
+InputBuffer::InputBuffer(int fd, size_t half_size)
+    : fd(fd), owns_fd(false), stream(nullptr), half_size(half_size) {
+  init();
+}
+
+
+InputBuffer::InputBuffer(const string& path, size_t half_size)
+    : fd(-1), owns_fd(false), stream(nullptr), half_size(half_size) {
+#ifndef _WIN32
+  if (path == "-") {
+    fd = STDIN_FILENO;
+  } else {
+    fd = open(path.c_str(), O_RDONLY);
+    if (fd == -1) throw runtime_error("Could not open " + path);
+    owns_fd = true;
+  }
+#else
+  if (path == "-") {
+    stream = &cin;
+  } else {
+    file.reset(new ifstream(path, ios::binary));
+    if (!file->is_open()) throw runtime_error("Could not open " + path);
+    stream = file.get();
+  }
+#endif
+  init();
+}
+
+
+InputBuffer::InputBuffer(istream& stream, size_t half_size)
+    : fd(-1), owns_fd(false), stream(&stream), half_size(half_size) {
+  init();
+}
+
+
+InputBuffer::InputBuffer(const char* data, size_t size)
+    : fd(-1), owns_fd(false), stream(nullptr), half_size(size + 1) {
+  if (data[size] != SENTINEL) throw runtime_error("In-memory input must end with a NUL.");
+  // The whole input is one half that is never full, so its end is the end of the input and nothing is read
+  halves[0] = const_cast<char*>(data);
+  halves[1] = nullptr;
+  offsets[0] = offsets[1] = lengths[1] = 0;
+  lengths[0] = size;
+  loaded[0] = true;
+  loaded[1] = false;
+  current = 0;
+  forward = halves[0];
+  keep = 0;
+  eof = true;
+}
+
+
+InputBuffer::~InputBuffer() {
+#ifndef _WIN32
+  if (owns_fd) close(fd);
+#endif
+}
+
+
+void InputBuffer::init() {
+  if (half_size == 0) throw runtime_error("The input buffer needs a positive size.");
+  storage.assign(2 * (half_size + 1), SENTINEL);
+  halves[0] = storage.data();
+  halves[1] = storage.data() + half_size + 1;
+  loaded[0] = loaded[1] = false;
+  offsets[0] = offsets[1] = lengths[0] = lengths[1] = 0;
+  keep = 0;
+  eof = false;
+  load(0, 0);
+  current = 0;
+  forward = halves[0];
+}
+
+
+size_t InputBuffer::read_into(char* target, size_t size) {
+  size_t total = 0;
+  while (total < size && !eof) {
+    long long count;
+    if (fd != -1) {
+#ifndef _WIN32
+      ssize_t result = read(fd, target + total, size - total);
+      if (result < 0 && errno == EINTR) continue;
+      if (result < 0) throw runtime_error("Failed to read the input.");
+      count = result;
+#else
+      count = 0;
+#endif
+    } else {
+      stream->read(target + total, static_cast<streamsize>(size - total));
+      count = stream->gcount();
+    }
+    if (count == 0) eof = true;
+    total += static_cast<size_t>(count);
+  }
+  return total;
+}
+
+
+void InputBuffer::load(int half, size_t offset) {
+  lengths[half] = read_into(halves[half], half_size);
+  halves[half][lengths[half]] = SENTINEL;
+  offsets[half] = offset;
+  loaded[half] = true;
+}
+
+
+bool InputBuffer::next_slow(char& c) {
+  char* end = halves[current] + lengths[current];
+  if (forward != end) {
+    // A NUL byte that is part of the input
+    ++forward;
+    return true;
+  }
+  // Halves are only short at the end of the input
+  if (lengths[current] < half_size) return false;
+  int other = 1 - current;
+  size_t next_offset = offsets[current] + half_size;
+  if (!loaded[other] || offsets[other] != next_offset) {
+    // The other half holds the input before this one, which the current lexeme may still need
+    if (keep < offsets[current]) {
+      throw runtime_error("A lexeme is longer than the input buffer (" + to_string(half_size) + " bytes).");
+    }
+    load(other, next_offset);
+  }
+  current = other;
+  forward = halves[current];
+  return next(c);
+}
+
+
+void InputBuffer::seek(size_t position) {
+  for (int half : {current, 1 - current}) {
+    if (loaded[half] && position >= offsets[half] && position <= offsets[half] + lengths[half]) {
+      current = half;
+      forward = halves[half] + (position - offsets[half]);
+      return;
+    }
+  }
+  throw runtime_error("Input position " + to_string(position) + " is no longer buffered.");
+}
+
+
+string InputBuffer::text(size_t from, size_t to) const {
+  string result;
+  result.reserve(to - from);
+  // The half holding the earlier part of the input goes first
+  int first = loaded[1] && offsets[1] < offsets[0] ? 1 : 0;
+  for (int half : {first, 1 - first}) {
+    if (!loaded[half]) continue;
+    size_t begin = max(from, offsets[half]), end = min(to, offsets[half] + lengths[half]);
+    if (begin < end) result.append(halves[half] + (begin - offsets[half]), end - begin);
+  }
+  if (result.size() != to - from) throw runtime_error("Input text is no longer buffered.");
+  return result;
+}
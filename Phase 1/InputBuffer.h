@@ -0,0 +1,82 @@
+#ifndef INPUT_BUFFER_H
+#define INPUT_BUFFER_H
+#include <cstddef>
+#include <fstream>
+#include <istream>
+#include <memory>
+#include <string>
+#include <vector>
+
+/**
+ * Double-buffered scanner input (Aho, Lam, Sethi, Ullman 3.2). Two fixed halves are refilled alternately
+ * with large reads, and each is followed by a sentinel byte, so reading a character only tests that one
+ * byte; the end of a half is only looked into when the sentinel shows up. Memory stays bounded on input of
+ * any length (stdin, pipes), as long as every lexeme, from the start of a token to the furthest character
+ * read while scanning it, fits in one half.
+ *
+ * Positions are offsets from the start of the input.
+ */
+class InputBuffer {
+  public:
+    static const size_t DEFAULT_HALF_SIZE = 1 << 16;
+    static const char SENTINEL = '\0';
+
+  private:
+    int fd;                               // Read with read(2) when not -1, from stream otherwise
+    bool owns_fd;
+    std::istream* stream;
+    std::unique_ptr<std::ifstream> file;  // Stream opened by the buffer itself
+    size_t half_size;
+    std::vector<char> storage;            // Half 0, sentinel, half 1, sentinel
+    char* halves[2];
+    size_t offsets[2];                    // Position of the first byte of each half
+    size_t lengths[2];                    // Bytes loaded into each half
+    bool loaded[2];
+    int current;                          // The half forward points into
+    char* forward;                        // Next character to read
+    size_t keep;                          // Nothing before this position is read again
+    bool eof;
+
+    void init();
+    /** Reads up to size bytes, fewer only at the end of the input */
+    size_t read_into(char* target, size_t size);
+    void load(int half, size_t offset);
+    /** next() found a sentinel: either a NUL in the input, the end of a half or the end of the input */
+    bool next_slow(char& c);
+
+  public:
+    /** Reads from an open file descriptor, which stays open */
+    explicit InputBuffer(int fd, size_t half_size = DEFAULT_HALF_SIZE);
+    /** Opens a file, or standard input for "-". Throws if it cannot be opened */
+    explicit InputBuffer(const std::string& path, size_t half_size = DEFAULT_HALF_SIZE);
+    /** Reads from a stream */
+    explicit InputBuffer(std::istream& stream, size_t half_size = DEFAULT_HALF_SIZE);
+    /** Scans size bytes already in memory without copying them. data[size] must be the sentinel, as it is
+     * in a std::string, and the bytes must outlive the buffer. */
+    InputBuffer(const char* data, size_t size);
+    InputBuffer(const InputBuffer&) = delete;
+    InputBuffer& operator=(const InputBuffer&) = delete;
+    ~InputBuffer();
+
+    /** Reads the next character into c and returns true, or returns false at the end of the input */
+    bool next(char& c) {
+      c = *forward;
+      if (c != SENTINEL) {
+        ++forward;
+        return true;
+      }
+      return next_slow(c);
+    }
+    /** Returns the position of the next character */
+    size_t position() const { return offsets[current] + static_cast<size_t>(forward - halves[current]); }
+    /** Goes back (or forward) to a position that is still buffered */
+    void seek(size_t position);
+    /** Declares that nothing before position will be read again, so the half holding it may be refilled */
+    void release(size_t position) { keep = position; }
+    /** Returns the longest stretch that is sure to stay buffered, the size of one half */
+    size_t capacity() const { return half_size; }
+    /** Returns the input between two buffered positions */
+    std::string text(size_t from, size_t to) const;
+};
+
+#endif
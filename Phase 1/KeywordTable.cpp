@@ -0,0 +1,86 @@
+#include "KeywordTable.h"
+#include "BinaryFile.h"
+#include <algorithm>
+#include <map>
+#include <stdexcept>
+using namespace std;
+
+// Keywords per bucket on average; smaller buckets make seeds quicker to find but cost more seeds
+static const size_t KEYWORDS_PER_BUCKET = 4;
+static const uint32_t MAX_SEED = 1u << 24;
+
+
+uint64_t KeywordTable::hash(const char* data, size_t size, uint64_t seed) {
+  // FNV-1a keyed by the seed, then a 64-bit finalizer so that nearby seeds give unrelated slots
+  uint64_t h = hash_bytes(data, size, 14695981039346656037ULL ^ (seed * 0x9E3779B97F4A7C15ULL));
+  h ^= h >> 33;
+  h *= 0xFF51AFD7ED558CCDULL;
+  h ^= h >> 33;
+  h *= 0xC4CEB9FE1A85EC53ULL;
+  h ^= h >> 33;
+  return h;
+}
+
+
+KeywordTable::KeywordTable() = default;
+
+
+KeywordTable::KeywordTable(const vector<pair<string, int>>& keywords) : keywords(keywords) {
+  map<string, int> unique;
+  for (const auto& keyword : keywords) {
+    auto found = unique.find(keyword.first);
+    if (found == unique.end()) unique.emplace(keyword.first, keyword.second);
+    else found->second = min(found->second, keyword.second);
+  }
+  if (unique.empty()) return;
+  size_t slots = unique.size();
+  size_t bucket_count = (slots + KEYWORDS_PER_BUCKET - 1) / KEYWORDS_PER_BUCKET;
+
+  vector<vector<const pair<const string, int>*>> buckets(bucket_count);
+  for (const auto& keyword : unique) {
+    buckets[hash(keyword.first.data(), keyword.first.size(), 0) % bucket_count].push_back(&keyword);
+  }
+  vector<size_t> order(bucket_count);
+  for (size_t i = 0; i < bucket_count; ++i) order[i] = i;
+  stable_sort(order.begin(), order.end(), [&buckets](size_t a, size_t b) { return buckets[a].size() > buckets[b].size(); });
+
+  seeds.assign(bucket_count, 0);
+  slot_keywords.assign(slots, string());
+  slot_tokens.assign(slots, -1);
+  vector<bool> taken(slots, false);
+  vector<size_t> positions;
+  for (size_t bucket : order) {
+    if (buckets[bucket].empty()) continue;
+    uint32_t seed = 1;
+    for (;; ++seed) {
+      if (seed == MAX_SEED) throw runtime_error("Could not build the keyword hash table.");
+      positions.clear();
+      bool fits = true;
+      for (const auto* keyword : buckets[bucket]) {
+        size_t slot = hash(keyword->first.data(), keyword->first.size(), seed) % slots;
+        if (taken[slot] || find(positions.begin(), positions.end(), slot) != positions.end()) {
+          fits = false;
+          break;
+        }
+        positions.push_back(slot);
+      }
+      if (fits) break;
+    }
+    seeds[bucket] = seed;
+    for (size_t i = 0; i < positions.size(); ++i) {
+      taken[positions[i]] = true;
+      slot_keywords[positions[i]] = buckets[bucket][i]->first;
+      slot_tokens[positions[i]] = buckets[bucket][i]->second;
+    }
+  }
+}
+
+
+int KeywordTable::lookup(const char* data, size_t size) const {
+  if (slot_tokens.empty()) return -1;
+  uint32_t seed = seeds[hash(data, size, 0) % seeds.size()];
+  size_t slot = hash(data, size, seed) % slot_tokens.size();
+  const string& keyword = slot_keywords[slot];
+  if (keyword.size() != size || keyword.compare(0, size, data, size) != 0) return -1;
+  return slot_tokens[slot];
+}
@@ -0,0 +1,33 @@
+#ifndef KEYWORD_TABLE_H
+#define KEYWORD_TABLE_H
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+/**
+ * Minimal perfect hash from keyword strings to token ids, built with hash-and-displace: keywords are
+ * spread over a few buckets, and each bucket (largest first) gets the first seed that sends all of its
+ * keywords to free slots. A lookup is two hashes and one string compare, whatever the number of keywords.
+ */
+class KeywordTable {
+  private:
+    std::vector<std::pair<std::string, int>> keywords;  // As given, kept so the table can be saved and rebuilt
+    std::vector<uint32_t> seeds;                        // Bucket -> seed of the slot hash
+    std::vector<std::string> slot_keywords;
+    std::vector<int> slot_tokens;
+
+    static uint64_t hash(const char* data, size_t size, uint64_t seed);
+  public:
+    /** Empty table, every lookup misses */
+    KeywordTable();
+    /** Builds the table. If a keyword is listed twice the smaller token id wins, as it would in the DFA. */
+    explicit KeywordTable(const std::vector<std::pair<std::string, int>>& keywords);
+    /** Returns the token id of a keyword, or -1 if the lexeme is not a keyword */
+    int lookup(const char* data, size_t size) const;
+    int lookup(const std::string& lexeme) const { return lookup(lexeme.data(), lexeme.size()); }
+    bool empty() const { return slot_tokens.empty(); }
+    const std::vector<std::pair<std::string, int>>& get_keywords() const { return keywords; }
+};
+
+#endif
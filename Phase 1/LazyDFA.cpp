@@ -0,0 +1,114 @@
+#include "LazyDFA.h"
+#include "Stats.h"
+#include <algorithm>
+#include <climits>
+using namespace std;
+
+
+LazyDFA::LazyDFA(const NFA& nfa, size_t max_states) : max_states(max(max_states, static_cast<size_t>(4))) {
+  unordered_set<int> nfa_states = nfa.get_states();
+  vector<int> ordered(nfa_states.begin(), nfa_states.end());
+  sort(ordered.begin(), ordered.end());
+  unordered_map<int, int> index;
+  for (size_t i = 0; i < ordered.size(); ++i) index[ordered[i]] = static_cast<int>(i);
+
+  moves.resize(ordered.size());
+  epsilon_moves.resize(ordered.size());
+  nfa_accept.resize(ordered.size());
+  visited.assign(ordered.size(), 0);
+  for (size_t i = 0; i < ordered.size(); ++i) {
+    nfa_accept[i] = nfa.accept(ordered[i]);
+    for (const auto& symbol_moves : nfa.get_transitions(ordered[i])) {
+      for (int dst : symbol_moves.second) {
+        if (symbol_moves.first == '\0') epsilon_moves[i].push_back(index.at(dst));
+        else moves[i].emplace_back(symbol_moves.first, index.at(dst));
+      }
+    }
+  }
+  vector<int> seeds;
+  for (int state : nfa.get_initial()) seeds.push_back(index.at(state));
+  start_set = closure(seeds);
+  reset_states();
+}
+
+
+vector<int> LazyDFA::closure(const vector<int>& seeds) {
+  if (++visit_mark == 0) {
+    fill(visited.begin(), visited.end(), 0);
+    visit_mark = 1;
+  }
+  vector<int> result, stack;
+  for (int state : seeds) {
+    if (visited[state] == visit_mark) continue;
+    visited[state] = visit_mark;
+    stack.push_back(state);
+  }
+  while (!stack.empty()) {
+    int state = stack.back();
+    stack.pop_back();
+    result.push_back(state);
+    for (int dst : epsilon_moves[state]) {
+      if (visited[dst] == visit_mark) continue;
+      visited[dst] = visit_mark;
+      stack.push_back(dst);
+    }
+  }
+  sort(result.begin(), result.end());
+  stats::count("lexer.closure_computations");
+  return result;
+}
+
+
+int LazyDFA::intern_state(vector<int> nfa_states) {
+  auto found = state_ids.find(nfa_states);
+  if (found != state_ids.end()) return found->second;
+  int id = static_cast<int>(states.size());
+  int token = INT_MAX;
+  for (int state : nfa_states) {
+    if (nfa_accept[state] != -1) token = min(token, nfa_accept[state]);
+  }
+  state_ids.emplace(nfa_states, id);
+  states.push_back(move(nfa_states));
+  state_accept.push_back(token == INT_MAX ? -1 : token);
+  transitions.emplace_back(256, -1);
+  stats::count("lexer.lazy_states");
+  return id;
+}
+
+
+void LazyDFA::reset_states() {
+  states.clear();
+  state_ids.clear();
+  state_accept.clear();
+  transitions.clear();
+  // State 0 is the dead state: the empty set of NFA states
+  intern_state(vector<int>());
+  initial_state = intern_state(start_set);
+}
+
+
+int LazyDFA::flush(int state) {
+  stats::count("lexer.lazy_flushes");
+  flush_count++;
+  vector<int> current = states[state];
+  reset_states();
+  return intern_state(move(current));
+}
+
+
+int LazyDFA::step(int state, char symbol) {
+  unsigned char index = static_cast<unsigned char>(symbol);
+  int cached = transitions[state][index];
+  if (cached != -1) return cached;
+  if (states.size() >= max_states) state = flush(state);
+
+  vector<int> seeds;
+  for (int nfa_state : states[state]) {
+    for (const auto& move : moves[nfa_state]) {
+      if (move.first == symbol) seeds.push_back(move.second);
+    }
+  }
+  int id = intern_state(closure(seeds));
+  transitions[state][index] = id;
+  return id;
+}
@@ -0,0 +1,55 @@
+#ifndef LAZY_DFA_H
+#define LAZY_DFA_H
+#include <map>
+#include <utility>
+#include <vector>
+#include "LexerAutomaton.h"
+#include "NFA.h"
+
+/**
+ * Lexer automaton that simulates the combined NFA and materializes a DFA state (an epsilon closed set of
+ * NFA states) only the first time the scanner reaches it. States and their transitions are kept in a
+ * table of bounded size; when it is full the table is flushed and only the current state is carried
+ * over, so memory stays predictable even when the full DFA would not fit.
+ */
+class LazyDFA : public LexerAutomaton {
+  private:
+    // The NFA renumbered to 0..n-1 so sets can be plain sorted vectors
+    std::vector<std::vector<std::pair<char, int>>> moves;  // Non epsilon transitions of every NFA state
+    std::vector<std::vector<int>> epsilon_moves;
+    std::vector<int> nfa_accept;                           // Token id of every NFA state, -1 if not accepting
+    std::vector<int> start_set;
+    std::vector<unsigned> visited;                         // Closure marks, compared against visit_mark
+    unsigned visit_mark = 0;
+
+    std::vector<std::vector<int>> states;                  // DFA state -> set of NFA states
+    std::map<std::vector<int>, int> state_ids;
+    std::vector<int> state_accept;
+    std::vector<std::vector<int>> transitions;             // DFA state -> next state per character (-1 if not built yet)
+    int initial_state;
+    size_t max_states;
+    size_t flush_count = 0;
+
+    /** Returns the sorted epsilon closure of some NFA states */
+    std::vector<int> closure(const std::vector<int>& seeds);
+    int intern_state(std::vector<int> nfa_states);
+    void reset_states();
+    /** Drops every cached state, returning the id of state in the new table */
+    int flush(int state);
+
+  public:
+    /**
+     * @param nfa The combined NFA of all tokens.
+     * @param max_states Number of states cached before the table is flushed (at least 4: dead, initial,
+     * current and next).
+     */
+    LazyDFA(const NFA& nfa, size_t max_states);
+    int initial() override { return initial_state; }
+    int step(int state, char symbol) override;
+    int accept(int state) override { return state_accept[state]; }
+    bool is_dead(int state) override { return state == 0; }
+    bool is_thread_safe() const override { return false; }
+    size_t flushes() const override { return flush_count; }
+};
+
+#endif
@@ -0,0 +1,26 @@
+#include "LexerAutomaton.h"
+using namespace std;
+
+DFAAutomaton::DFAAutomaton(DFA dfa) : dfa(move(dfa)) {
+  for (int mode = 0; mode < this->dfa.get_mode_count(); ++mode) initial_states.push_back(this->dfa.get_initial(mode));
+  dead_state = this->dfa.get_dead_state();
+}
+
+
+ModeAutomaton::ModeAutomaton(vector<shared_ptr<LexerAutomaton>> modes)
+    : modes(move(modes)), count(static_cast<int>(this->modes.size())) {}
+
+
+bool ModeAutomaton::is_thread_safe() const {
+  for (const auto& mode : modes) {
+    if (!mode->is_thread_safe()) return false;
+  }
+  return true;
+}
+
+
+size_t ModeAutomaton::flushes() const {
+  size_t total = 0;
+  for (const auto& mode : modes) total += mode->flushes();
+  return total;
+}
@@ -0,0 +1,76 @@
+#ifndef LEXER_AUTOMATON_H
+#define LEXER_AUTOMATON_H
+#include <memory>
+#include <stdexcept>
+#include <vector>
+#include "DFA.h"
+
+/**
+ * The automaton the scanner runs on. States are opaque ids; a lazy implementation may build them
+ * while scanning and renumber them when it flushes its cache, so callers should only hold on to the
+ * current state and should restart from initial() for every token.
+ */
+class LexerAutomaton {
+  public:
+    virtual ~LexerAutomaton() = default;
+    /** Returns the state every token starts from */
+    virtual int initial() = 0;
+    /** Returns the state tokens start from in a start condition (mode); mode 0 starts at initial() */
+    virtual int mode_initial(int mode) {
+      if (mode != 0) throw std::runtime_error("Unknown start condition.");
+      return initial();
+    }
+    /** Returns the state reached from state on a character id */
+    virtual int step(int state, char symbol) = 0;
+    /** Returns the token id of a state if it is an accepting state and -1 otherwise */
+    virtual int accept(int state) = 0;
+    /** Returns true if no token can be completed from state */
+    virtual bool is_dead(int state) = 0;
+    /** Returns false if the automaton changes while scanning, so concurrent scans must be serialized */
+    virtual bool is_thread_safe() const { return true; }
+    /** Returns how many times the states were renumbered; state ids obtained before a change are meaningless */
+    virtual size_t flushes() const { return 0; }
+};
+
+
+/** A fully built (minimized) DFA */
+class DFAAutomaton : public LexerAutomaton {
+  private:
+    DFA dfa;
+    std::vector<int> initial_states;  // Per start condition
+    int dead_state;
+  public:
+    explicit DFAAutomaton(DFA dfa);
+    int initial() override { return initial_states[0]; }
+    int mode_initial(int mode) override { return initial_states.at(mode); }
+    int step(int state, char symbol) override { return dfa.transition(state, symbol); }
+    int accept(int state) override { return dfa.accept(state); }
+    bool is_dead(int state) override { return state == dead_state; }
+};
+
+
+
+/**
+ * Start conditions over automata built separately for every mode, for the lazy ones that grow from a
+ * single initial state. A state packs the mode's own state with the mode, as state * modes + mode.
+ */
+class ModeAutomaton : public LexerAutomaton {
+  private:
+    std::vector<std::shared_ptr<LexerAutomaton>> modes;
+    int count;
+
+    int pack(int state, int mode) const { return state * count + mode; }
+  public:
+    explicit ModeAutomaton(std::vector<std::shared_ptr<LexerAutomaton>> modes);
+    int initial() override { return mode_initial(0); }
+    int mode_initial(int mode) override { return pack(modes.at(mode)->initial(), mode); }
+    int step(int state, char symbol) override {
+      return pack(modes[state % count]->step(state / count, symbol), state % count);
+    }
+    int accept(int state) override { return modes[state % count]->accept(state / count); }
+    bool is_dead(int state) override { return modes[state % count]->is_dead(state / count); }
+    bool is_thread_safe() const override;
+    size_t flushes() const override;
+};
+
+#endif
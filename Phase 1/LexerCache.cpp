@@ -0,0 +1,200 @@
+#include "LexerCache.h"
+#include "BinaryFile.h"
+#include <algorithm>
+#include <iostream>
+#include <cstring>
+using namespace std;
+
+static const char LEXER_CACHE_MAGIC[8] = {'L', 'X', 'C', 'A', 'C', 'H', 'E', '\0'};
+static const uint32_t LEXER_CACHE_VERSION = 5;
+
+
+uint64_t LexerCache::key_for(const string& rules_file_path, const LexerOptions& options) {
+  uint64_t key = hash_file(rules_file_path);
+  key = hash_bytes(reinterpret_cast<const char*>(&LEXER_CACHE_VERSION), sizeof(LEXER_CACHE_VERSION), key);
+  // Different constructions give equivalent DFAs, but a cached one would hide the construction being compared
+  int32_t construction = options.construction;
+  key = hash_bytes(reinterpret_cast<const char*>(&construction), sizeof(construction), key);
+  uint8_t incremental = options.incremental ? 1 : 0;
+  key = hash_bytes(reinterpret_cast<const char*>(&incremental), sizeof(incremental), key);
+  uint8_t keyword_hash = options.keyword_hash ? 1 : 0;
+  return hash_bytes(reinterpret_cast<const char*>(&keyword_hash), sizeof(keyword_hash), key);
+}
+
+
+string LexerCache::path_for(const string& rules_file_path) {
+  return rules_file_path.substr(0, rules_file_path.find_last_of('.')) + "_DFA_cache.bin";
+}
+
+
+bool LexerCache::load(const string& cache_path, uint64_t key, LexerArtifacts& artifacts) {
+  try {
+    MappedFile file(cache_path);
+    BinaryReader reader(file.data(), file.size());
+    if (memcmp(reader.read_bytes(sizeof(LEXER_CACHE_MAGIC)), LEXER_CACHE_MAGIC, sizeof(LEXER_CACHE_MAGIC)) != 0) return false;
+    if (reader.read_u32() != LEXER_CACHE_VERSION || reader.read_u64() != key) return false;
+
+    // Character mapping
+    unordered_map<char, char> mapper;
+    uint32_t mapper_size = reader.read_u32();
+    for (uint32_t i = 0; i < mapper_size; ++i) {
+      char c = static_cast<char>(reader.read_u8());
+      mapper[c] = static_cast<char>(reader.read_u8());
+    }
+    // Token names
+    unordered_map<int, string> token_names;
+    uint32_t token_count = reader.read_u32();
+    for (uint32_t i = 0; i < token_count; ++i) {
+      int id = reader.read_i32();
+      token_names[id] = reader.read_string();
+    }
+    // Hashed keywords
+    vector<pair<string, int>> keywords;
+    uint32_t keyword_count = reader.read_u32();
+    for (uint32_t i = 0; i < keyword_count; ++i) {
+      string keyword = reader.read_string();
+      keywords.emplace_back(move(keyword), reader.read_i32());
+    }
+    vector<int> ignored(reader.read_u32());
+    for (int& id : ignored) id = reader.read_i32();
+    unordered_map<int, int> mode_switches;
+    uint32_t switch_count = reader.read_u32();
+    for (uint32_t i = 0; i < switch_count; ++i) {
+      int token = reader.read_i32();
+      mode_switches[token] = reader.read_i32();
+    }
+    vector<pair<int, TaggedNFA>> tagged;
+    uint32_t tagged_count = reader.read_u32();
+    for (uint32_t i = 0; i < tagged_count; ++i) {
+      int token = reader.read_i32();
+      vector<string> tag_names(reader.read_u32());
+      for (string& name : tag_names) name = reader.read_string();
+      vector<TaggedNFA::State> nfa_states(reader.read_u32());
+      int start = reader.read_i32();
+      for (TaggedNFA::State& state : nfa_states) {
+        state.kind = static_cast<TaggedNFA::Kind>(reader.read_u8());
+        state.symbol = static_cast<char>(reader.read_u8());
+        state.tag = reader.read_i32();
+        state.out1 = reader.read_i32();
+        state.out2 = reader.read_i32();
+      }
+      tagged.emplace_back(token, TaggedNFA(move(nfa_states), start, move(tag_names)));
+    }
+    // Input domain and dense transition table (state index x symbol index -> state index)
+    uint32_t domain_size = reader.read_u32();
+    const char* domain_bytes = reader.read_bytes(domain_size);
+    vector<char> input_domain(domain_bytes, domain_bytes + domain_size);
+    uint32_t state_count = reader.read_u32();
+    vector<int> initials(reader.read_u32());
+    for (int& initial : initials) initial = reader.read_i32();
+    if (initials.empty()) return false;
+    unordered_set<int> states;
+    unordered_map<int, unordered_map<char, int>> transitions;
+    for (uint32_t s = 0; s < state_count; ++s) {
+      states.insert(static_cast<int>(s));
+      auto& row = transitions[static_cast<int>(s)];
+      for (char symbol : input_domain) {
+        int dst = reader.read_i32();
+        if (dst < 0 || static_cast<uint32_t>(dst) >= state_count) return false;
+        row[symbol] = dst;
+      }
+    }
+    unordered_map<int, int> accepting;
+    uint32_t accepting_count = reader.read_u32();
+    for (uint32_t i = 0; i < accepting_count; ++i) {
+      int state = reader.read_i32();
+      accepting[state] = reader.read_i32();
+    }
+    if (!reader.at_end()) return false;
+
+    artifacts.dfa = DFA(move(input_domain), move(states), move(transitions), initials.front(), move(accepting));
+    artifacts.dfa.make_mode_initials(move(initials));
+    artifacts.token_names = move(token_names);
+    artifacts.mapper = move(mapper);
+    artifacts.keywords = move(keywords);
+    artifacts.ignored = move(ignored);
+    artifacts.mode_switches = move(mode_switches);
+    artifacts.tagged = move(tagged);
+    return true;
+  } catch (const exception&) {
+    // Missing or corrupt cache, the caller regenerates it
+    return false;
+  }
+}
+
+
+bool LexerCache::save(const string& cache_path, uint64_t key, const LexerArtifacts& artifacts) {
+  const DFA& dfa = artifacts.dfa;
+  // Renumber the DFA states densely
+  unordered_set<int> state_set = dfa.get_states();
+  vector<int> states(state_set.begin(), state_set.end());
+  sort(states.begin(), states.end());
+  unordered_map<int, int> index;
+  for (size_t i = 0; i < states.size(); ++i) index[states[i]] = static_cast<int>(i);
+
+  BinaryWriter writer(cache_path);
+  writer.write_bytes(LEXER_CACHE_MAGIC, sizeof(LEXER_CACHE_MAGIC));
+  writer.write_u32(LEXER_CACHE_VERSION);
+  writer.write_u64(key);
+
+  writer.write_u32(static_cast<uint32_t>(artifacts.mapper.size()));
+  for (const auto& pair : artifacts.mapper) {
+    writer.write_u8(static_cast<uint8_t>(pair.first));
+    writer.write_u8(static_cast<uint8_t>(pair.second));
+  }
+  writer.write_u32(static_cast<uint32_t>(artifacts.token_names.size()));
+  for (const auto& pair : artifacts.token_names) {
+    writer.write_i32(pair.first);
+    writer.write_string(pair.second);
+  }
+  writer.write_u32(static_cast<uint32_t>(artifacts.keywords.size()));
+  for (const auto& keyword : artifacts.keywords) {
+    writer.write_string(keyword.first);
+    writer.write_i32(keyword.second);
+  }
+  writer.write_u32(static_cast<uint32_t>(artifacts.ignored.size()));
+  for (int id : artifacts.ignored) writer.write_i32(id);
+  writer.write_u32(static_cast<uint32_t>(artifacts.mode_switches.size()));
+  for (const auto& pair : artifacts.mode_switches) {
+    writer.write_i32(pair.first);
+    writer.write_i32(pair.second);
+  }
+  writer.write_u32(static_cast<uint32_t>(artifacts.tagged.size()));
+  for (const auto& token : artifacts.tagged) {
+    const TaggedNFA& nfa = token.second;
+    writer.write_i32(token.first);
+    writer.write_u32(static_cast<uint32_t>(nfa.get_tag_names().size()));
+    for (const string& name : nfa.get_tag_names()) writer.write_string(name);
+    writer.write_u32(static_cast<uint32_t>(nfa.get_states().size()));
+    writer.write_i32(nfa.get_start());
+    for (const TaggedNFA::State& state : nfa.get_states()) {
+      writer.write_u8(state.kind);
+      writer.write_u8(static_cast<uint8_t>(state.symbol));
+      writer.write_i32(state.tag);
+      writer.write_i32(state.out1);
+      writer.write_i32(state.out2);
+    }
+  }
+
+  vector<char> input_domain = dfa.get_input_domain();
+  writer.write_u32(static_cast<uint32_t>(input_domain.size()));
+  writer.write_bytes(input_domain.data(), input_domain.size());
+  writer.write_u32(static_cast<uint32_t>(states.size()));
+  writer.write_u32(static_cast<uint32_t>(dfa.get_mode_count()));
+  for (int mode = 0; mode < dfa.get_mode_count(); ++mode) writer.write_i32(index.at(dfa.get_initial(mode)));
+  for (int state : states) {
+    for (char symbol : input_domain) writer.write_i32(index.at(dfa.transition(state, symbol)));
+  }
+  unordered_map<int, int> accepting = dfa.get_accepting();
+  writer.write_u32(static_cast<uint32_t>(accepting.size()));
+  for (const auto& pair : accepting) {
+    writer.write_i32(index.at(pair.first));
+    writer.write_i32(pair.second);
+  }
+  writer.close();
+  if (!writer.ok()) {
+    cerr << "Failed to write lexer cache: " << cache_path << endl;
+    return false;
+  }
+  return true;
+}
@@ -0,0 +1,39 @@
+#ifndef LEXER_CACHE_H
+#define LEXER_CACHE_H
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include "DFA.h"
+#include "TaggedNFA.h"
+#include "LexerOptions.h"
+
+/** Everything the lexical analyzer needs at scan time, as produced by the generator. */
+struct LexerArtifacts {
+  DFA dfa;                                          // The minimized DFA, one initial state per start condition
+  std::unordered_map<int, std::string> token_names; // Token id -> token name (including -1 -> ERROR)
+  std::unordered_map<char, char> mapper;            // Input character -> character id
+  std::vector<std::pair<std::string, int>> keywords; // Keywords left out of the DFA and their token ids
+  std::vector<int> ignored;                         // Tokens the scanner drops (%ignore)
+  std::unordered_map<int, int> mode_switches;       // Token id -> start condition scanned after it (%begin)
+  std::vector<std::pair<int, TaggedNFA>> tagged;    // Tokens with @tags and the NFAs that capture them
+};
+
+/**
+ * Binary compile cache for the lexer. An artifact stores the minimized DFA as a dense table along with
+ * the token names, character mapping and hashed keywords, and is only valid for the key (content hash) it was written with.
+ */
+class LexerCache {
+  public:
+    /** Returns the key for a rules file: a hash of its contents, the generator options and the format version. */
+    static uint64_t key_for(const std::string& rules_file_path, const LexerOptions& options = LexerOptions());
+    /** Returns the default cache path for a rules file. */
+    static std::string path_for(const std::string& rules_file_path);
+    /** Loads the artifact at cache_path into artifacts. Returns false if it is missing, stale or corrupt. */
+    static bool load(const std::string& cache_path, uint64_t key, LexerArtifacts& artifacts);
+    /** Writes the artifacts to cache_path under key. Returns false if the file could not be written. */
+    static bool save(const std::string& cache_path, uint64_t key, const LexerArtifacts& artifacts);
+};
+
+#endif
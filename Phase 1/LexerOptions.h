@@ -0,0 +1,23 @@
+#ifndef LEXER_OPTIONS_H
+#define LEXER_OPTIONS_H
+#include <cstddef>
+
+/** Choices for how the lexer generator builds its automaton. Every choice accepts the same tokens. */
+struct LexerOptions {
+  enum Construction {
+    SUBSET,    // Thompson NFA, then subset construction
+    DIRECT,    // followpos construction straight from the syntax trees (Regex2DFA)
+    DERIVATIVE,// no DFA up front, states are built from regex derivatives while scanning
+    LAZY       // no DFA up front, states are subsets of the NFA built while scanning (LazyDFA)
+  };
+  Construction construction = SUBSET;
+  size_t lazy_cache_states = 10000;  // States a lazy automaton caches before flushing
+  unsigned jobs = 1;                 // Threads for subset construction and minimization, 0 for one per hardware thread
+  bool incremental = false;          // Compile every token on its own, reusing the ones compiled by earlier runs
+  bool keyword_hash = false;         // Leave keywords out of the automaton and look them up after the scan
+
+  /** Returns true if the automaton is built while scanning instead of up front */
+  bool lazy() const { return construction == DERIVATIVE || construction == LAZY; }
+};
+
+#endif
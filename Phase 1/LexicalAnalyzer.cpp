@@ -1,25 +1,162 @@
 #include "LexicalAnalyzer.h"
+#include "Stats.h"
+#include "OutputWriter.h"
+#include "Regex2DFA.h"
+#include "DerivativeAutomaton.h"
+#include "LazyDFA.h"
+#include "IncrementalGenerator.h"
 using namespace std;
 
 
 
 
 /** Constructor */
-LexicalAnalyzer::LexicalAnalyzer(const string &rules_file_path, const std::string& output_file_path)
+LexicalAnalyzer::LexicalAnalyzer(const string &rules_file_path, const std::string& output_file_path,
+                                 const LexerOptions& options)
 {
   // Initialize the DFA, mapper, and token names
   ifstream rules_file(rules_file_path);
   if (!rules_file.is_open()) {
     throw runtime_error("Could not open the rules file.");
   }
+  rules_file.close();
+  scan_lock = std::make_shared<std::mutex>();
+  if (options.lazy()) {
+    build_lazy(rules_file_path, options);
+    return;
+  }
+
+  // Reuse the compiled lexer if the rules file hasn't changed since it was cached
+  uint64_t cache_key = LexerCache::key_for(rules_file_path, options);
+  std::string cache_path = LexerCache::path_for(rules_file_path);
+  LexerArtifacts artifacts;
+  stats::ScopedTimer timer("lexer.build");
+  if (LexerCache::load(cache_path, cache_key, artifacts)) {
+    stats::count("lexer.cache_hits");
+    std::cout << "Lexer loaded from cache " << cache_path << std::endl;
+  } else {
+    artifacts = generate(rules_file_path, output_file_path, options);
+    if (LexerCache::save(cache_path, cache_key, artifacts))
+      std::cout << "Lexer cache written to " << cache_path << std::endl;
+  }
+
+  // Assign fields
+  int modes = artifacts.dfa.get_mode_count();
+  this->automaton = std::make_shared<DFAAutomaton>(std::move(artifacts.dfa));
+  this->token_names = std::move(artifacts.token_names);
+  this->mapper = std::move(artifacts.mapper);
+  this->keywords = KeywordTable(artifacts.keywords);
+  this->ignored_tokens = std::unordered_set<int>(artifacts.ignored.begin(), artifacts.ignored.end());
+  this->mode_switches = std::move(artifacts.mode_switches);
+  this->tagged_tokens = std::move(artifacts.tagged);
+  find_token_starts(modes);
+}
+
+/** Builds the minimized DFA, token names and character mapping from the rules file */
+LexerArtifacts LexicalAnalyzer::generate(const string &rules_file_path, const std::string& output_file_path,
+                                         const LexerOptions& options)
+{
   // use absolute path for Test Illustrations\lexical_rules_test1.txt
   RegexAnalyzer regex_analyzer(rules_file_path);
-  NFA nfa = regex_analyzer.RegexToNFA();
+  regex_analyzer.resolve();
 
   // Use std::unordered_map and std::vector explicitly
   std::unordered_map<int, std::string> tokens = regex_analyzer.getTokensIdNameMap();
   std::unordered_map<char, char> charTokens = regex_analyzer.getCharTokensMap();
 
+  write_token_ids(rules_file_path, tokens);
+  std::vector<int> ignored = regex_analyzer.getIgnoredTokenIds();
+  std::unordered_map<int, int> mode_switches = regex_analyzer.getModeSwitches();
+
+  std::vector<std::pair<std::string, int>> keywords;
+  if (options.keyword_hash) keywords = regex_analyzer.excludeKeywords();
+
+  std::vector<char> input_domain;
+  for (auto const &pair: charTokens) {
+    input_domain.push_back(pair.second);
+  }
+  // Every start condition gets its own minimized DFA, combined into one with an initial state per mode
+  std::unique_ptr<IncrementalGenerator> generator;
+  if (options.incremental)
+    generator.reset(new IncrementalGenerator(IncrementalGenerator::path_for(rules_file_path), options.jobs));
+  std::vector<DFA> mode_dfas;
+  for (int mode = 0; mode < regex_analyzer.getModeCount(); ++mode) {
+    DFA dfa;
+    if (generator) {
+      dfa = generator->build(regex_analyzer.generateASTs(mode), charTokens, input_domain);
+    } else if (options.construction == LexerOptions::DIRECT) {
+      dfa = Regex2DFA().convert(regex_analyzer.generateASTs(mode), input_domain);
+    } else {
+      NFA nfa = regex_analyzer.generateNFA(mode);
+      dfa = NFA2DFA(options.jobs).convert(nfa, input_domain);
+    }
+    DFAMinimizer minimizer(dfa, options.jobs);
+    mode_dfas.push_back(minimizer.minimize());
+  }
+  if (generator) generator->save();
+  DFA minimized_dfa = DFA::combine(mode_dfas);
+  tokens[-1] = "ERROR";
+  unordered_map<char, char> tokenChars;
+    for (auto i: charTokens) {
+        tokenChars[i.second] = i.first;
+    }
+  minimized_dfa.print_dfa(tokenChars, tokens, output_file_path);
+
+  LexerArtifacts artifacts;
+  artifacts.dfa = std::move(minimized_dfa);
+  artifacts.token_names = std::move(tokens);
+  artifacts.mapper = std::move(charTokens);
+  artifacts.keywords = std::move(keywords);
+  artifacts.ignored = std::move(ignored);
+  artifacts.mode_switches = std::move(mode_switches);
+  artifacts.tagged = regex_analyzer.getTaggedTokens();
+  return artifacts;
+}
+
+/** Resolves the rules and leaves the automaton to be built while scanning */
+void LexicalAnalyzer::build_lazy(const string &rules_file_path, const LexerOptions& options)
+{
+  stats::ScopedTimer timer("lexer.build");
+  RegexAnalyzer regex_analyzer(rules_file_path);
+  regex_analyzer.resolve();
+  this->token_names = regex_analyzer.getTokensIdNameMap();
+  write_token_ids(rules_file_path, this->token_names);
+  this->token_names[-1] = "ERROR";
+  this->mapper = regex_analyzer.getCharTokensMap();
+  std::vector<int> ignored = regex_analyzer.getIgnoredTokenIds();
+  this->ignored_tokens = std::unordered_set<int>(ignored.begin(), ignored.end());
+  this->mode_switches = regex_analyzer.getModeSwitches();
+  this->tagged_tokens = regex_analyzer.getTaggedTokens();
+  if (options.keyword_hash) this->keywords = KeywordTable(regex_analyzer.excludeKeywords());
+  std::vector<std::shared_ptr<LexerAutomaton>> modes;
+  for (int mode = 0; mode < regex_analyzer.getModeCount(); ++mode) {
+    if (options.construction == LexerOptions::DERIVATIVE)
+      modes.push_back(std::make_shared<DerivativeAutomaton>(regex_analyzer.generateASTs(mode), options.lazy_cache_states));
+    else
+      modes.push_back(std::make_shared<LazyDFA>(regex_analyzer.generateNFA(mode), options.lazy_cache_states));
+  }
+  // Each mode grows its own automaton; a single one is used as is
+  if (modes.size() == 1) this->automaton = modes.front();
+  else this->automaton = std::make_shared<ModeAutomaton>(std::move(modes));
+  find_token_starts(regex_analyzer.getModeCount());
+}
+
+void LexicalAnalyzer::find_token_starts(int modes)
+{
+  token_starts.assign(modes, std::array<bool, 256>());
+  for (int mode = 0; mode < modes; ++mode)
+  {
+    int initial = automaton->mode_initial(mode);
+    for (const auto &pair : this->mapper)
+    {
+      token_starts[mode][static_cast<unsigned char>(pair.first)] = !automaton->is_dead(automaton->step(initial, pair.second));
+    }
+  }
+}
+
+/** Writes the id of every token next to the rules file */
+void LexicalAnalyzer::write_token_ids(const string &rules_file_path, const unordered_map<int, string> &tokens)
+{
   //order the tokens by id
   std::vector<std::pair<int, std::string>> orderedTokens(tokens.begin(), tokens.end());
   std::sort(orderedTokens.begin(), orderedTokens.end(), [](const std::pair<int, std::string> &a, const std::pair<int, std::string> &b) {
@@ -29,16 +166,16 @@ LexicalAnalyzer::LexicalAnalyzer(const string &rules_file_path, const std::strin
 
   // Take the rules file path and add _symbol_table before the file extension
   std::string symbol_table_file_path = rules_file_path.substr(0, rules_file_path.find_last_of('.')) + "_Token_IDs.txt";
-  std::ofstream symbol_table_file(symbol_table_file_path);
+  OutputWriter symbol_table_file(symbol_table_file_path);
 
   if (symbol_table_file.is_open()) {
     // Write the header
-    symbol_table_file << std::left << std::setw(10) << "ID" << "Token" << std::endl;
-    symbol_table_file << std::string(30, '-') << std::endl; // Separator line
+    symbol_table_file.padded("ID", 10) << "Token\n";
+    symbol_table_file << std::string(30, '-') << '\n'; // Separator line
 
     // Write the table rows
     for (auto const &pair: orderedTokens) {
-      symbol_table_file << std::left << std::setw(10) << pair.first << pair.second << std::endl;
+      symbol_table_file.padded(std::to_string(pair.first), 10) << pair.second << '\n';
     }
     // Close the symbol table file
     symbol_table_file.close();
@@ -46,118 +183,188 @@ LexicalAnalyzer::LexicalAnalyzer(const string &rules_file_path, const std::strin
   } else {
     std::cerr << "Failed to open file: " << symbol_table_file_path << std::endl;
   }
+}
 
-  NFA2DFA converter;
-  std::vector<char> input_domain;
-  for (auto const &pair: charTokens) {
-    input_domain.push_back(pair.second);
-  }
-  DFA dfa = converter.convert(nfa, input_domain);
-
-  DFAMinimizer minimizer(dfa);
-  DFA minimized_dfa = minimizer.minimize();
-  tokens[-1] = "ERROR";
-  unordered_map<char, char> tokenChars;
-    for (auto i: charTokens) {
-        tokenChars[i.second] = i.first;
+namespace {
+  /** A (input position, state) pair from which no token can be completed */
+  struct FailedPair {
+    size_t position;
+    int state;
+    bool operator==(const FailedPair& other) const { return position == other.position && state == other.state; }
+  };
+  struct FailedPairHash {
+    size_t operator()(const FailedPair& pair) const {
+      return hash<size_t>()(pair.position * 0x9E3779B97F4A7C15ULL ^ static_cast<uint32_t>(pair.state));
     }
-  minimized_dfa.print_dfa(tokenChars, tokens, output_file_path);
+  };
 
-  // Assign fields
-  this->dfa = std::move(minimized_dfa);
-  this->token_names = std::move(tokens);
-  this->mapper = std::move(charTokens);
+  // Longest error token; longer runs of unmatched bytes are split
+  const size_t MAX_ERROR_RUN = 4096;
 
+  bool is_whitespace(char c) {
+    return c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == '\v' || c == '\f';
+  }
 }
 
-/** Method to fill the buffer. Returns true if there are no more characters in the input stream. */
-bool LexicalAnalyzer::fill_buffer(vector<char> &buffer, ifstream &ip)
+
+/** Method to analyze input and build the symbol table */
+vector<Symbol> LexicalAnalyzer::analyze(ifstream &input_file) const
 {
-  char c;
-  int counter = 0;
-  while (counter < BUFFER_SIZE && ip.get(c))
-  {
-    // Only add one whitespace character to the buffer
-    if (c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == '\v' || c == '\f') {
-        if (!buffer.empty() && buffer.back() == ' ') continue;
-        c = ' ';
-    }
-    buffer.push_back(c);
-    ++counter;
-  }
-  return counter == 0;
+  InputBuffer input(input_file);
+  return analyze(input);
 }
 
 
-/** Method to analyze input and build the symbol table */
-vector<Symbol> LexicalAnalyzer::analyze(ifstream &input_file)
+/** Method to analyze input, emitting each symbol as it is recognized */
+void LexicalAnalyzer::analyze(ifstream &input_file, const function<void(Symbol &&)> &emit) const
+{
+  InputBuffer input(input_file);
+  analyze(input, emit);
+}
+
+
+vector<Symbol> LexicalAnalyzer::analyze(InputBuffer &input) const
 {
   vector<Symbol> symbol_table;            // The symbol table to return
-  vector<char> buffer;                    // Buffer to store the current lexeme
-  int current_state = dfa.get_initial();  // Start with the initial state.
-  int last_token = -1;                    // Track the last accepting state
-  int dead_state = this->dfa.get_dead_state();
-  int next_state = 0;
-  size_t i = 0, end_i = 1;                // Position of current element in the buffer and the last accepting element
-  bool eof_flag = false;                  // Flag to indicate end of file (fill_buffer returns false)
+  analyze(input, [&symbol_table](Symbol &&symbol) { symbol_table.push_back(std::move(symbol)); });
+  return symbol_table;
+}
+
+
+void LexicalAnalyzer::analyze(InputBuffer &input, const function<void(Symbol &&)> &emit) const
+{
+  stats::ScopedTimer timer("lexer.analyze");
+  // Lazy automata grow while scanning, so only one scan may run on them at a time
+  std::unique_lock<std::mutex> lock(*scan_lock, std::defer_lock);
+  if (!automaton->is_thread_safe()) lock.lock();
+  long long tokens = 0, errors = 0, ignored = 0;
+  int mode = 0;                           // Start condition the next token is scanned in
+  // Maximal munch with Reps' memo: a (input position, state) pair from which no token could be completed is
+  // remembered, so no later token scans past it again and the whole input is scanned in linear time
+  unordered_set<FailedPair, FailedPairHash> failed;
+  size_t prune_at = 4096;                 // Memo size at which the pairs behind the current token are dropped
+  size_t failed_flushes = automaton->flushes();
+  vector<int> trail;                      // State after every character read for the current token
+  // The NFA of every tagged token follows the same characters, keeping its tags at the last length it matched
+  vector<TaggedNFA::Run> runs(tagged_tokens.size());
+  vector<vector<size_t>> run_tags(tagged_tokens.size());
+  vector<size_t> run_ends(tagged_tokens.size());
   char c;
 
-  do 
+  while (true)
   {
-    // Reset EOF flag
-    eof_flag = false;
-    // Check if the buffer is empty
-    if (i == buffer.size())
+    // Whitespace separates tokens, unless a rule such as a comment or an ignored whitespace token matches it
+    size_t start = input.position();
+    input.release(start);
+    if (!input.next(c)) break;
+    if (is_whitespace(c) && !token_starts[mode][static_cast<unsigned char>(c)]) continue;
+    input.seek(start);
+    if (failed.size() >= prune_at)
     {
-      // Try to fill the buffer and if there is no more input, set the EOF flag
-      // which will be equivalent to reaching a dead state.
-      eof_flag = fill_buffer(buffer, input_file);
+      for (auto it = failed.begin(); it != failed.end();)
+      {
+        if (it->position < start) it = failed.erase(it);
+        else ++it;
+      }
+      prune_at = max<size_t>(4096, failed.size() * 2);
     }
 
-    // Get next state on inputting the current character. 
-    // If we reach EOF or a whitespace character, the next state will be the dead state.
-    c = (i < buffer.size())? buffer.at(i) : '\0';
-    if (eof_flag || c == ' ')
-        next_state = dead_state;
-    else {
-        if (this->mapper.find(c) == this->mapper.end()) {
-            next_state = dead_state;
-        }else
-            next_state = dfa.transition(current_state, this->mapper.at(c));
+    int current_state = automaton->mode_initial(mode);
+    int last_token = -1;                  // Token of the longest accepted prefix
+    size_t end = start + 1;               // End of the longest accepted prefix, one character if there is none
+    size_t i = start;
+    // The lexeme has to stay buffered, so a token is at most one buffer half long. Reaching that limit ends
+    // the munch like a dead state (the pairs on the way are remembered as failed like any others)
+    size_t munch_limit = start + input.capacity();
+    trail.clear();
+    for (size_t k = 0; k < runs.size(); ++k)
+    {
+      tagged_tokens[k].second.start(runs[k]);
+      run_ends[k] = start;
+    }
+    while (i < munch_limit && input.next(c))
+    {
+      // A character outside the rules ends the token
+      auto id = this->mapper.find(c);
+      if (id == this->mapper.end()) break;
+      int next_state = automaton->step(current_state, id->second);
+      if (automaton->is_dead(next_state)) break;
+      if (automaton->flushes() != failed_flushes)
+      {
+        // The automaton renumbered its states, the remembered pairs no longer mean anything
+        failed.clear();
+        failed_flushes = automaton->flushes();
+        trail.clear();
+      }
+      if (failed.count({i + 1, next_state})) break;
+      ++i;
+      current_state = next_state;
+      trail.push_back(current_state);
+      for (size_t k = 0; k < runs.size(); ++k)
+      {
+        const TaggedNFA &nfa = tagged_tokens[k].second;
+        if (runs[k].threads.empty() || !nfa.step(runs[k], id->second) || !nfa.matched(runs[k])) continue;
+        nfa.submatches(runs[k], run_tags[k]);
+        run_ends[k] = i;
+      }
+      // If the state is accepting, update the last token and end position
+      if (automaton->accept(current_state) != -1)
+      {
+        last_token = automaton->accept(current_state);
+        end = i;
+        trail.clear();
+      }
+    }
+    // Nothing after the accepted prefix led to a token
+    for (size_t k = 0; k < trail.size(); ++k) failed.insert({i - trail.size() + k + 1, trail[k]});
+    // The bytes after an error that cannot start a token either (binary junk, characters outside the rules)
+    // join it in one error token, up to the next byte that can or whitespace
+    if (last_token == -1)
+    {
+      const std::array<bool, 256> &starts = token_starts[mode];
+      size_t limit = start + min(MAX_ERROR_RUN, input.capacity());
+      input.seek(end);
+      while (end < limit && input.next(c) && !starts[static_cast<unsigned char>(c)] && !is_whitespace(c)) ++end;
     }
 
-    // If this inputs leads to a dead state, this means that there is no further tokens to be found
-    // on starting from the current start character. We either accept some token or mark an error.
-    if (next_state == dead_state)
+    // Ignored tokens are consumed without building their lexeme, unless it may still turn out to be a keyword
+    // (keywords are only looked up in INITIAL)
+    bool keyword_lookup = last_token != -1 && mode == 0 && !keywords.empty();
+    string lexeme;
+    if (keyword_lookup || !ignored_tokens.count(last_token))
+      lexeme = input.text(start, end);    // The whole error run if no token was found
+    // A keyword left out of the automaton was accepted as the token that also matches it
+    if (keyword_lookup) {
+      int keyword = keywords.lookup(lexeme);
+      if (keyword != -1) last_token = keyword;
+    }
+    input.seek(end);
+    // The token may switch the start condition the next one is scanned in
+    if (!mode_switches.empty())
+    {
+      auto next_mode = mode_switches.find(last_token);
+      if (next_mode != mode_switches.end()) mode = next_mode->second;
+    }
+    if (ignored_tokens.count(last_token))
     {
-      symbol_table.push_back({
-        string(buffer.begin(), buffer.begin() + end_i), // Lexeme, will be one character only if no token was found (end_i = 1)
-        this->token_names.at(last_token) // Token name, will be ERROR if no token was found (last token = -1)
-      });
-      // Delete the lexeme from the buffer
-      buffer.erase(buffer.begin(), buffer.begin() + end_i); // Will only erase one character if no token was found
-      // Reset last token, end position, current state, and pointer
-      last_token = -1;
-      end_i = 1;
-      current_state = dfa.get_initial();
-      i = 0;
-      // If there is a whitespace at the beginning of the buffer, remove it
-      if (!buffer.empty() && buffer.front() == ' ') buffer.erase(buffer.begin());
+      ignored++;
       continue;
     }
-
-    // If the next state is accepting, update the last token and end position
-    if (dfa.accept(next_state) != -1)
+    tokens++;
+    if (last_token == -1) errors++;
+    vector<size_t> submatches;
+    for (size_t k = 0; k < runs.size(); ++k)
     {
-      last_token = dfa.accept(next_state);
-      end_i = i+1;
+      if (tagged_tokens[k].first == last_token && run_ends[k] == end) submatches = run_tags[k];
     }
-
-    // increment i and update current state
-    ++i;
-    current_state = next_state;
-
-  } while (!(buffer.empty() && eof_flag)); // Continue until the buffer is empty and the EOF flag is set
-
-  return symbol_table;
-}
\ No newline at end of file
+    emit({
+      std::move(lexeme),
+      this->token_names.at(last_token), // Token name, will be ERROR if no token was found (last token = -1)
+      start,
+      std::move(submatches)
+    });
+  }
+  stats::count("lexer.tokens", tokens);
+  stats::count("lexer.error_tokens", errors);
+  stats::count("lexer.ignored_tokens", ignored);
+}
@@ -1,31 +1,66 @@
+#ifndef LEXICAL_ANALYZER_H
+#define LEXICAL_ANALYZER_H
+#include <array>
 #include <vector>
 #include <unordered_map>
+#include <unordered_set>
 #include <string>
+#include <functional>
+#include <memory>
+#include <mutex>
 #include "RegexAnalyzer.h"
 #include "NFA.h"
 #include "NFA2DFA.h"
 #include "DFA.h"
 #include "DFAMinimizer.h"
-
-const int BUFFER_SIZE = 256;
+#include "LexerCache.h"
+#include "LexerOptions.h"
+#include "LexerAutomaton.h"
+#include "KeywordTable.h"
+#include "InputBuffer.h"
+#include "TaggedNFA.h"
 
 struct Symbol
 {
     std::string lexeme; // The lexeme (token)
     std::string token_name;       // Token ID associated with the accepting state
+    size_t offset = 0;            // Position of the lexeme in the input
+    std::vector<size_t> submatches; // Offsets in the lexeme of the rule's @tags, TaggedNFA::UNSET if not crossed
 };
 
 class LexicalAnalyzer
 {
   private:
-    DFA dfa; // The minimized DFA
+    std::shared_ptr<LexerAutomaton> automaton; // The minimized DFA, or a lazy automaton built while scanning
+    std::shared_ptr<std::mutex> scan_lock; // Serializes scans on automata that are not thread safe
     std::unordered_map<int, std::string> token_names; // Map from accepting state to token name
     std::unordered_map<char, char> mapper; // Map from character to character ID
-    /** Method to fill the buffer. Returns true if there are no more characters in the input stream. */
-    static bool fill_buffer(std::vector<char> &buffer, std::ifstream &ip);
+    KeywordTable keywords; // Keywords left out of the automaton, looked up in every accepted lexeme
+    std::unordered_set<int> ignored_tokens; // Tokens consumed without being emitted, such as comments
+    std::unordered_map<int, int> mode_switches; // Token id -> start condition (mode) the scan continues in
+    std::vector<std::pair<int, TaggedNFA>> tagged_tokens; // Tokens with @tags, matched alongside the automaton
+    std::vector<std::array<bool, 256>> token_starts; // Per mode, the bytes a token can start with
+    /** Runs the full generator pipeline (regex -> NFA -> DFA -> minimized DFA) on a rules file. */
+    static LexerArtifacts generate(const std::string& rules_file_path, const std::string& output_file_path,
+                                   const LexerOptions& options);
+    /** Resolves the rules and sets up a lazy automaton instead of building the DFA up front. */
+    void build_lazy(const std::string& rules_file_path, const LexerOptions& options);
+    /** Finds the bytes every mode's initial state has a live move on */
+    void find_token_starts(int modes);
+    static void write_token_ids(const std::string& rules_file_path, const std::unordered_map<int, std::string>& tokens);
   public:
-    /** default constructor */
+    /** default constructor. analyze keeps no state between calls, so one analyzer can scan on several threads
+     * (scans on a lazy automaton take turns) */
     LexicalAnalyzer();
-    LexicalAnalyzer(const std::string& rules_file_path, const std::string& output_file_path);
-    std::vector<Symbol> analyze(std::ifstream &input_file);
-};
\ No newline at end of file
+    LexicalAnalyzer(const std::string& rules_file_path, const std::string& output_file_path,
+                    const LexerOptions& options = LexerOptions());
+    std::vector<Symbol> analyze(std::ifstream &input_file) const;
+    /** Scans the input and hands every symbol to emit as soon as it is recognized */
+    void analyze(std::ifstream &input_file, const std::function<void(Symbol &&)> &emit) const;
+    /** Scans buffered input, such as standard input or a pipe, in bounded memory. The search for a longer lexeme
+     * stops one half of the buffer past the token start, so a longer token is cut into several. */
+    std::vector<Symbol> analyze(InputBuffer &input) const;
+    void analyze(InputBuffer &input, const std::function<void(Symbol &&)> &emit) const;
+};
+
+#endif
@@ -128,6 +128,18 @@ void NFA::add_transition(int src, char symbol, int dst) {
 }
 
 
+void NFA::merge(const NFA& other) {
+  states.insert(other.states.begin(), other.states.end());
+  for (const auto& state_trns : other.transitions) {
+    unordered_map<char, vector<int>>& own = transitions[state_trns.first];
+    for (const auto& trns : state_trns.second) {
+      vector<int>& dsts = own[trns.first];
+      dsts.insert(dsts.end(), trns.second.begin(), trns.second.end());
+    }
+  }
+}
+
+
 bool NFA::contains_state(int state) const {
   return states.find(state) != states.end();
 }
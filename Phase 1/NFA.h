@@ -46,6 +46,8 @@ class NFA {
     void make_accepting(int state, int token_id);
     /** Add a transition from src to dst on input symbol. */
     void add_transition(int src, char symbol, int dst);
+    /** Add every state and transition of another NFA (with distinct state IDs), but not its initial or accepting states. */
+    void merge(const NFA& other);
 
     /** Check if the NFA has a certain state ID */
     bool contains_state(int state) const;
@@ -1,20 +1,121 @@
 #include "NFA2DFA.h"
+#include "Stats.h"
+#include "WorkStealingPool.h"
+#include <atomic>
+#include <mutex>
 
 
 using namespace std;
 
-NFA2DFA::NFA2DFA() = default;
-
+namespace {
+    /** The NFA with states renumbered 0..n-1 and its moves in flat lists, read concurrently by the workers */
+    struct DenseNFA {
+        vector<vector<int>> epsilon;
+        vector<vector<pair<char, int>>> moves;
+        vector<int> accept;
+        vector<int> initial;       // Epsilon closure of the initial state
+
+        explicit DenseNFA(const NFA& nfa) {
+            unordered_set<int> states = nfa.get_states();
+            vector<int> ids(states.begin(), states.end());
+            sort(ids.begin(), ids.end());
+            unordered_map<int, int> index;
+            for (size_t i = 0; i < ids.size(); i++) index[ids[i]] = static_cast<int>(i);
+            epsilon.resize(ids.size());
+            moves.resize(ids.size());
+            accept.resize(ids.size());
+            for (size_t i = 0; i < ids.size(); i++) {
+                accept[i] = nfa.accept(ids[i]);
+                for (const auto& symbol : nfa.get_transitions(ids[i])) {
+                    for (int target : symbol.second) {
+                        if (symbol.first == '\0') epsilon[i].push_back(index.at(target));
+                        else moves[i].emplace_back(symbol.first, index.at(target));
+                    }
+                }
+            }
+            for (int state : nfa.get_initial()) initial.push_back(index.at(state));
+        }
+    };
+
+    /** Per-worker scratch space for closures */
+    struct Closure {
+        vector<unsigned> seen;
+        unsigned stamp = 0;
+        vector<int> stack;
+
+        /** Replaces states (a set of NFA states) by its sorted epsilon closure */
+        void close(const DenseNFA& nfa, vector<int>& states) {
+            if (seen.size() != nfa.epsilon.size()) seen.assign(nfa.epsilon.size(), 0);
+            if (++stamp == 0) {
+                fill(seen.begin(), seen.end(), 0);
+                stamp = 1;
+            }
+            stack.clear();
+            for (int state : states) {
+                if (seen[state] != stamp) {
+                    seen[state] = stamp;
+                    stack.push_back(state);
+                }
+            }
+            states.clear();
+            while (!stack.empty()) {
+                int state = stack.back();
+                stack.pop_back();
+                states.push_back(state);
+                for (int next : nfa.epsilon[state]) {
+                    if (seen[next] != stamp) {
+                        seen[next] = stamp;
+                        stack.push_back(next);
+                    }
+                }
+            }
+            sort(states.begin(), states.end());
+        }
+    };
 
-int NFA2DFA::NFA2DFA_map_state (const unordered_set<int>& target, const unordered_map<int, unordered_set<int>>& source){
-    for (const auto& element : source) {
-        if (element.second == target) {
-            return element.first;
+    struct SetHash {
+        size_t operator()(const vector<int>& states) const {
+            uint64_t hash = 1469598103934665603ULL;
+            for (int state : states) hash = (hash ^ static_cast<uint32_t>(state)) * 1099511628211ULL;
+            return static_cast<size_t>(hash ^ (hash >> 29));
         }
-    }
-    return -1;
+    };
+
+    /** NFA-state set -> DFA state id, split into independently locked stripes; ids are handed out atomically */
+    class StateTable {
+        private:
+            static const size_t STRIPES = 64;
+            struct Stripe {
+                mutex lock;
+                unordered_map<vector<int>, int, SetHash> ids;
+            };
+            Stripe stripes[STRIPES];
+            atomic<int> next_id;
+        public:
+            explicit StateTable(int first_id) : next_id(first_id) {}
+            int size() const { return next_id.load(); }
+            /** Returns the id of a set, assigning a new one (and setting created) if the set is new */
+            int intern(const vector<int>& states, bool& created) {
+                Stripe& stripe = stripes[SetHash()(states) % STRIPES];
+                lock_guard<mutex> guard(stripe.lock);
+                auto found = stripe.ids.find(states);
+                created = found == stripe.ids.end();
+                if (!created) return found->second;
+                int id = next_id++;
+                stripe.ids.emplace(states, id);
+                return id;
+            }
+    };
+
+    struct Discovered {
+        int id;
+        vector<int> states;
+    };
 }
 
+NFA2DFA::NFA2DFA(unsigned threads) : threads(threads) {}
+
+
 vector<char> NFA2DFA::NFA_get_input_domain(const NFA& nfa) {
     unordered_set<char> input_domain;
 
@@ -34,76 +135,103 @@ DFA NFA2DFA::convert(const NFA &nfa) {
 }
 
 DFA NFA2DFA::convert(const NFA &nfa, vector<char> input_domain) {
-    // Initialize the set of states and transitions of the new DFA
-    unordered_map<int, unordered_set<int>> state_map;
+    stats::ScopedTimer timer("lexer.subset_construction");
+    DenseNFA dense(nfa);
+    WorkStealingPool pool(threads);
+    const int dead_state = 0, initial_state_id = 1;
+    size_t symbols = input_domain.size();
+
+    // The dead state stands for the empty set and is never interned
+    StateTable table(initial_state_id);
+    vector<vector<int>> rows(2);           // Provisional DFA state -> target per input symbol
+    vector<int> accepting(2, -1);
+
+    Closure initial_closure;
+    vector<int> initial = dense.initial;
+    initial_closure.close(dense, initial);
+    bool created;
+    table.intern(initial, created);
+    vector<Discovered> frontier;
+    frontier.push_back({initial_state_id, initial});
+
+    // Breadth-first, one level at a time: the workers expand the frontier and intern the sets they reach
+    vector<Closure> closures(pool.size());
+    vector<vector<Discovered>> discovered(pool.size());
+    while (!frontier.empty()) {
+        for (const Discovered& state : frontier) {
+            int token = -1;
+            for (int nfa_state : state.states) {
+                int accept = dense.accept[nfa_state];
+                if (accept != -1 && (token == -1 || accept < token)) token = accept;
+            }
+            accepting[state.id] = token;
+        }
+        vector<vector<int>> level_rows(frontier.size());
+        pool.for_each(frontier.size(), [&](size_t index, unsigned worker) {
+            const vector<int>& current = frontier[index].states;
+            vector<int>& row = level_rows[index];
+            row.resize(symbols);
+            vector<int> next;
+            for (size_t s = 0; s < symbols; s++) {
+                next.clear();
+                for (int state : current) {
+                    for (const auto& move : dense.moves[state]) {
+                        if (move.first == input_domain[s]) next.push_back(move.second);
+                    }
+                }
+                closures[worker].close(dense, next);
+                if (next.empty()) {
+                    row[s] = dead_state;
+                    continue;
+                }
+                bool created;
+                row[s] = table.intern(next, created);
+                if (created) discovered[worker].push_back({row[s], next});
+            }
+        });
+        rows.resize(table.size());
+        accepting.resize(table.size(), -1);
+        for (size_t i = 0; i < frontier.size(); i++) rows[frontier[i].id] = move(level_rows[i]);
+        frontier.clear();
+        for (auto& found : discovered) {
+            for (Discovered& state : found) frontier.push_back(move(state));
+            found.clear();
+        }
+    }
+
+    // Number the states the way a sequential breadth-first search over the input domain finds them, so the
+    // DFA (and every report written from it) is the same for any number of threads
+    vector<int> order(rows.size(), -1);
+    vector<int> queue = {initial_state_id};
+    order[dead_state] = dead_state;
+    order[initial_state_id] = initial_state_id;
+    int dfa_state_counter = initial_state_id + 1;
+    for (size_t head = 0; head < queue.size(); head++) {
+        for (int target : rows[queue[head]]) {
+            if (order[target] != -1) continue;
+            order[target] = dfa_state_counter++;
+            queue.push_back(target);
+        }
+    }
+
     unordered_set<int> dfa_states;
     unordered_map<int, unordered_map<char, int>> dfa_transitions;
     unordered_map<int, int> dfa_accepting;
-    queue<unordered_set<int>> state_queue;
-
-    int dead_state = 0;
-    int initial_state_id = 1;
-    int dfa_state_counter = 1;
-
-    // Initialize the dead state
-    for(auto symbol : input_domain) {
+    for (auto symbol : input_domain) {
         dfa_transitions[dead_state][symbol] = dead_state;
     }
     dfa_states.insert(dead_state);
-
-    // Compute epsilon closure of the initial NFA state.
-    unordered_set<int> nfa_initial_closure = nfa.eps_closure({nfa.get_initial()});
-
-    // Add the initial state to the DFA
-    state_map[initial_state_id] = nfa_initial_closure;
-    dfa_states.insert(initial_state_id);
-    state_queue.push(nfa_initial_closure);
-
-    if (nfa.accept(nfa_initial_closure) != -1) {
-        dfa_accepting[initial_state_id] = nfa.accept(nfa_initial_closure);
+    for (int state : queue) {
+        int id = order[state];
+        dfa_states.insert(id);
+        if (accepting[state] != -1) dfa_accepting[id] = accepting[state];
+        unordered_map<char, int>& transitions = dfa_transitions[id];
+        for (size_t s = 0; s < symbols; s++) transitions[input_domain[s]] = order[rows[state][s]];
     }
 
-    dfa_state_counter++;
-
-    // BFS to explore all DFA states derived from NFA.
-    while (!state_queue.empty()) {
-        auto current_set = state_queue.front();
-        state_queue.pop();
-
-        int current_dfa_state = NFA2DFA_map_state(current_set, state_map);
-
-        // Process each symbol in the input domain.
-        for (char symbol : input_domain) {
-            // Get next states for the given symbol.
-            unordered_set<int> next_states = nfa.transition(current_set, symbol);
-
-            // Compute epsilon closure of the next states.
-            unordered_set<int> closure = nfa.eps_closure(next_states);
-
-            // Skip dead state if the closure is empty.
-            if (closure.empty()) {
-                dfa_transitions[current_dfa_state][symbol] = dead_state;
-                continue;
-            }
-
-            // Map the closure to a DFA state if not already mapped.
-            if (NFA2DFA_map_state(closure, state_map) == -1) {
-                state_map[dfa_state_counter] = closure;
-                dfa_states.insert(dfa_state_counter);
-                if (nfa.accept(closure) != -1) {
-                    dfa_accepting[dfa_state_counter] = nfa.accept(closure);
-                }
-
-                state_queue.push(closure);
-                dfa_state_counter++;
-            }
-
-            // Add the transition to the DFA.
-            dfa_transitions[current_dfa_state][symbol] = NFA2DFA_map_state(closure, state_map);
-        }
-    }
+    stats::count("lexer.closure_computations", static_cast<long long>(queue.size() * symbols + 1));
+    stats::count("lexer.dfa_states", static_cast<long long>(dfa_states.size()));
 
     // Create and return the resulting DFA.
     return DFA(input_domain, dfa_states, dfa_transitions, initial_state_id, dfa_accepting);
 }
-
@@ -11,12 +11,16 @@
 
 class NFA2DFA {
     private:
+        unsigned threads;
         // Helper functions
-        int NFA2DFA_map_state(const std::unordered_set<int>& target, const std::unordered_map<int, std::unordered_set<int>>& source);
         std::vector<char> NFA_get_input_domain(const NFA& nfa);
 
     public:
-        NFA2DFA();
+        /**
+         * @param threads Threads exploring the DFA states, 0 for one per hardware thread. The result does not
+         * depend on it: states are numbered in the order a single-threaded breadth-first search finds them.
+         */
+        explicit NFA2DFA(unsigned threads = 1);
         /**
          * Converts an NFA into a DFA.
          *
@@ -0,0 +1,162 @@
+#include "Regex2DFA.h"
+#include "Stats.h"
+#include <algorithm>
+#include <climits>
+#include <map>
+#include <queue>
+using namespace std;
+
+Regex2DFA::Regex2DFA() = default;
+
+namespace {
+  /** Sorted union of two sorted position lists */
+  vector<int> merge_positions(const vector<int>& a, const vector<int>& b) {
+    vector<int> result;
+    result.reserve(a.size() + b.size());
+    set_union(a.begin(), a.end(), b.begin(), b.end(), back_inserter(result));
+    return result;
+  }
+
+  /** Joins the trees pairwise so the union of many tokens stays shallow */
+  int balanced_union(RegexAST& ast, vector<int> roots) {
+    while (roots.size() > 1) {
+      vector<int> next;
+      for (size_t i = 0; i + 1 < roots.size(); i += 2) next.push_back(ast.add_node(RegexNode::UNION, roots[i], roots[i + 1]));
+      if (roots.size() % 2 == 1) next.push_back(roots.back());
+      roots.swap(next);
+    }
+    return roots[0];
+  }
+}
+
+
+DFA Regex2DFA::convert(const vector<pair<int, RegexAST>>& tokens, vector<char> input_domain) {
+  stats::ScopedTimer timer("lexer.direct_dfa");
+
+  // Augment every token with its end marker and join them into one tree. Every occurrence of a
+  // definition needs its own positions, so references are expanded here
+  RegexAST ast;
+  vector<int> roots;
+  for (const auto& token : tokens) {
+    int root = ast.graft(token.second.expanded());
+    roots.push_back(ast.add_node(RegexNode::CONCAT, root, ast.add_end(token.first)));
+  }
+  if (roots.empty()) throw runtime_error("No token expressions to build a DFA from.");
+  ast.set_root(balanced_union(ast, roots));
+  const vector<RegexNode>& nodes = ast.get_nodes();
+
+  // Number the positions (SYMBOL and END leaves)
+  vector<int> position_node;
+  vector<int> node_position(nodes.size(), -1);
+  for (size_t i = 0; i < nodes.size(); ++i) {
+    if (nodes[i].kind == RegexNode::SYMBOL || nodes[i].kind == RegexNode::END) {
+      node_position[i] = static_cast<int>(position_node.size());
+      position_node.push_back(static_cast<int>(i));
+    }
+  }
+
+  // nullable, firstpos and lastpos bottom-up (children always precede their parents)
+  vector<bool> nullable(nodes.size());
+  vector<vector<int>> firstpos(nodes.size()), lastpos(nodes.size());
+  vector<vector<int>> followpos(position_node.size());
+  for (size_t i = 0; i < nodes.size(); ++i) {
+    const RegexNode& node = nodes[i];
+    switch (node.kind) {
+      case RegexNode::SYMBOL:
+      case RegexNode::END:
+        nullable[i] = false;
+        firstpos[i] = lastpos[i] = {node_position[i]};
+        break;
+      case RegexNode::EPSILON:
+        nullable[i] = true;
+        break;
+      case RegexNode::UNION:
+        nullable[i] = nullable[node.left] || nullable[node.right];
+        firstpos[i] = merge_positions(firstpos[node.left], firstpos[node.right]);
+        lastpos[i] = merge_positions(lastpos[node.left], lastpos[node.right]);
+        break;
+      case RegexNode::CONCAT:
+        nullable[i] = nullable[node.left] && nullable[node.right];
+        firstpos[i] = nullable[node.left] ? merge_positions(firstpos[node.left], firstpos[node.right]) : firstpos[node.left];
+        lastpos[i] = nullable[node.right] ? merge_positions(lastpos[node.left], lastpos[node.right]) : lastpos[node.right];
+        for (int p : lastpos[node.left])
+          followpos[p].insert(followpos[p].end(), firstpos[node.right].begin(), firstpos[node.right].end());
+        break;
+      case RegexNode::STAR:
+      case RegexNode::PLUS:
+      case RegexNode::OPTIONAL:
+        nullable[i] = node.kind != RegexNode::PLUS || nullable[node.left];
+        firstpos[i] = firstpos[node.left];
+        lastpos[i] = lastpos[node.left];
+        if (node.kind != RegexNode::OPTIONAL) {
+          for (int p : lastpos[node.left])
+            followpos[p].insert(followpos[p].end(), firstpos[node.left].begin(), firstpos[node.left].end());
+        }
+        break;
+      case RegexNode::REFERENCE:
+        // Every token tree was expanded above
+        throw logic_error("Unexpected reference in an expanded tree.");
+    }
+  }
+  for (auto& follow : followpos) {
+    sort(follow.begin(), follow.end());
+    follow.erase(unique(follow.begin(), follow.end()), follow.end());
+  }
+
+  // Subset construction over positions
+  unordered_set<int> dfa_states;
+  unordered_map<int, unordered_map<char, int>> dfa_transitions;
+  unordered_map<int, int> dfa_accepting;
+  map<vector<int>, int> state_ids;
+  queue<pair<vector<int>, int>> state_queue;
+  int dead_state = 0;
+  int initial_state = 1;
+  for (char symbol : input_domain) dfa_transitions[dead_state][symbol] = dead_state;
+  dfa_states.insert(dead_state);
+
+  auto add_state = [&](const vector<int>& positions) {
+    int id = static_cast<int>(state_ids.size()) + 1;
+    state_ids.emplace(positions, id);
+    dfa_states.insert(id);
+    int token = INT_MAX;
+    for (int p : positions) {
+      const RegexNode& leaf = nodes[position_node[p]];
+      if (leaf.kind == RegexNode::END) token = min(token, leaf.token);
+    }
+    if (token != INT_MAX) dfa_accepting[id] = token;
+    state_queue.emplace(positions, id);
+    return id;
+  };
+  add_state(firstpos[ast.get_root()]);
+
+  while (!state_queue.empty()) {
+    vector<int> positions = move(state_queue.front().first);
+    int state = state_queue.front().second;
+    state_queue.pop();
+
+    // Group the follow sets by the symbol at each position
+    unordered_map<char, vector<int>> moves;
+    for (int p : positions) {
+      const RegexNode& leaf = nodes[position_node[p]];
+      if (leaf.kind != RegexNode::SYMBOL) continue;
+      vector<int>& next = moves[leaf.symbol];
+      next.insert(next.end(), followpos[p].begin(), followpos[p].end());
+    }
+    for (char symbol : input_domain) {
+      auto found = moves.find(symbol);
+      if (found == moves.end()) {
+        dfa_transitions[state][symbol] = dead_state;
+        continue;
+      }
+      vector<int>& next = found->second;
+      sort(next.begin(), next.end());
+      next.erase(unique(next.begin(), next.end()), next.end());
+      auto existing = state_ids.find(next);
+      dfa_transitions[state][symbol] = existing != state_ids.end() ? existing->second : add_state(next);
+    }
+  }
+
+  stats::count("lexer.direct_positions", static_cast<long long>(position_node.size()));
+  stats::count("lexer.dfa_states", static_cast<long long>(dfa_states.size()));
+  return DFA(input_domain, dfa_states, dfa_transitions, initial_state, dfa_accepting);
+}
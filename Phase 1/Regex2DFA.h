@@ -0,0 +1,27 @@
+#ifndef REGEX2DFA_H
+#define REGEX2DFA_H
+#include <utility>
+#include <vector>
+#include "RegexAST.h"
+#include "DFA.h"
+
+/**
+ * Builds a DFA straight from regular expression syntax trees using followpos (Aho, Sethi, Ullman),
+ * skipping the Thompson NFA and its epsilon closures.
+ * Every token's tree is augmented with an end marker carrying its id; a DFA state accepts the smallest
+ * token id among its end markers, the same priority rule as NFA::accept.
+ */
+class Regex2DFA {
+  public:
+    Regex2DFA();
+    /**
+     * Converts the union of the token expressions into a DFA with dead state 0 and initial state 1.
+     *
+     * @param tokens Token id and expression of every token.
+     * @param input_domain The input symbols that the DFA recognizes.
+     * @return A complete DFA over input_domain.
+     */
+    DFA convert(const std::vector<std::pair<int, RegexAST>>& tokens, std::vector<char> input_domain);
+};
+
+#endif
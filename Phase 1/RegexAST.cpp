@@ -0,0 +1,267 @@
+#include "RegexAST.h"
+#include <algorithm>
+#include <stdexcept>
+using namespace std;
+
+namespace {
+  /** Recursive descent over the keyword encoding. Precedence: postfix operators, then concatenation, then union. */
+  class KeywordParser {
+    private:
+      const vector<char>& keywords;
+      size_t pos;
+      RegexAST& ast;
+
+      bool at(char c) const { return pos < keywords.size() && keywords[pos] == c; }
+
+      bool starts_atom() const {
+        return pos < keywords.size() && (keywords[pos] < 0 || keywords[pos] == 'L' || keywords[pos] == '(');
+      }
+
+      int parse_atom() {
+        if (pos >= keywords.size()) throw runtime_error("Invalid regular expression: unexpected end.");
+        char c = keywords[pos++];
+        if (c < 0) return ast.add_symbol(c);
+        if (c == 'L') return ast.add_epsilon();
+        if (c == '(') {
+          int inner = parse_union();
+          if (!at(')')) throw runtime_error("Invalid regular expression: missing ')'.");
+          ++pos;
+          return inner;
+        }
+        throw runtime_error(string("Invalid regular expression: unexpected '") + c + "'.");
+      }
+
+      int parse_postfix() {
+        int node = parse_atom();
+        while (true) {
+          if (at('*')) node = ast.add_node(RegexNode::STAR, node);
+          else if (at('+')) node = ast.add_node(RegexNode::PLUS, node);
+          else if (at('?')) node = ast.add_node(RegexNode::OPTIONAL, node);
+          else return node;
+          ++pos;
+        }
+      }
+
+      int parse_concat() {
+        int node = parse_postfix();
+        while (starts_atom()) node = ast.add_node(RegexNode::CONCAT, node, parse_postfix());
+        return node;
+      }
+
+    public:
+      KeywordParser(const vector<char>& keywords, RegexAST& ast) : keywords(keywords), pos(0), ast(ast) {}
+
+      int parse_union() {
+        int node = parse_concat();
+        while (at('|')) {
+          ++pos;
+          node = ast.add_node(RegexNode::UNION, node, parse_concat());
+        }
+        return node;
+      }
+
+      bool done() const { return pos == keywords.size(); }
+  };
+}
+
+
+RegexAST::RegexAST() : root(-1) {}
+
+
+RegexAST RegexAST::from_keywords(const vector<char>& keywords) {
+  RegexAST ast;
+  KeywordParser parser(keywords, ast);
+  ast.root = parser.parse_union();
+  if (!parser.done()) throw runtime_error("Invalid regular expression: unbalanced ')'.");
+  return ast;
+}
+
+
+int RegexAST::add_symbol(char symbol) {
+  nodes.push_back({RegexNode::SYMBOL, symbol, 0, -1, -1});
+  return static_cast<int>(nodes.size()) - 1;
+}
+
+
+int RegexAST::add_epsilon() {
+  nodes.push_back({RegexNode::EPSILON, 0, -1, -1, -1});
+  return static_cast<int>(nodes.size()) - 1;
+}
+
+
+int RegexAST::add_tag(int tag) {
+  nodes.push_back({RegexNode::EPSILON, 0, tag, -1, -1});
+  return static_cast<int>(nodes.size()) - 1;
+}
+
+
+int RegexAST::add_end(int token) {
+  nodes.push_back({RegexNode::END, 0, token, -1, -1});
+  return static_cast<int>(nodes.size()) - 1;
+}
+
+
+int RegexAST::add_node(RegexNode::Kind kind, int left, int right) {
+  nodes.push_back({kind, 0, 0, left, right});
+  return static_cast<int>(nodes.size()) - 1;
+}
+
+
+int RegexAST::add_reference(const shared_ptr<const RegexAST>& definition) {
+  int index = 0;
+  while (index < static_cast<int>(definitions.size()) && definitions[index] != definition) ++index;
+  if (index == static_cast<int>(definitions.size())) definitions.push_back(definition);
+  nodes.push_back({RegexNode::REFERENCE, 0, index, -1, -1});
+  return static_cast<int>(nodes.size()) - 1;
+}
+
+
+int RegexAST::graft(const RegexAST& other) {
+  int offset = static_cast<int>(nodes.size());
+  for (RegexNode node : other.nodes) {
+    if (node.left != -1) node.left += offset;
+    if (node.right != -1) node.right += offset;
+    if (node.kind == RegexNode::REFERENCE) add_reference(other.definitions[node.token]);
+    else nodes.push_back(node);
+  }
+  return other.root + offset;
+}
+
+
+RegexAST RegexAST::expanded() const {
+  RegexAST result;
+  if (root != -1) result.root = expand_into(result);
+  return result;
+}
+
+
+int RegexAST::expand_into(RegexAST& target) const {
+  vector<int> new_index(nodes.size(), -1);
+  for (size_t i = 0; i < nodes.size(); ++i) {
+    RegexNode node = nodes[i];
+    if (node.kind == RegexNode::REFERENCE) {
+      new_index[i] = definitions[node.token]->expand_into(target);
+      continue;
+    }
+    if (node.left != -1) node.left = new_index[node.left];
+    if (node.right != -1) node.right = new_index[node.right];
+    target.nodes.push_back(node);
+    new_index[i] = static_cast<int>(target.nodes.size()) - 1;
+  }
+  return new_index[root];
+}
+
+
+int RegexAST::copy(int node) {
+  // Every node has a single parent, so a walk visits each node of the subtree once
+  vector<int> subtree, stack = {node};
+  while (!stack.empty()) {
+    int current = stack.back();
+    stack.pop_back();
+    subtree.push_back(current);
+    if (nodes[current].left != -1) stack.push_back(nodes[current].left);
+    if (nodes[current].right != -1) stack.push_back(nodes[current].right);
+  }
+  // Copying in index order keeps children before their parents
+  sort(subtree.begin(), subtree.end());
+  int lowest = subtree.front();
+  vector<int> new_index(node - lowest + 1, -1);
+  for (int i : subtree) {
+    RegexNode copied = nodes[i];
+    if (copied.left != -1) copied.left = new_index[copied.left - lowest];
+    if (copied.right != -1) copied.right = new_index[copied.right - lowest];
+    new_index[i - lowest] = static_cast<int>(nodes.size());
+    nodes.push_back(copied);
+  }
+  return new_index[node - lowest];
+}
+
+
+string RegexAST::to_string(const unordered_map<char, char>& characters) const {
+  if (root == -1) return "";
+  vector<string> rendered(nodes.size());
+  for (size_t i = 0; i < nodes.size(); ++i) {
+    const RegexNode& node = nodes[i];
+    // Operands that are not single atoms are parenthesized
+    auto operand = [&](int child) {
+      const RegexAST* tree = this;
+      const RegexNode* operand_node = &nodes[child];
+      while (operand_node->kind == RegexNode::REFERENCE) {
+        tree = tree->definitions[operand_node->token].get();
+        operand_node = &tree->nodes[tree->root];
+      }
+      RegexNode::Kind kind = operand_node->kind;
+      if (kind == RegexNode::CONCAT) return "(" + rendered[child] + ")";
+      return rendered[child];
+    };
+    switch (node.kind) {
+      case RegexNode::SYMBOL: {
+        auto found = characters.find(node.symbol);
+        if (found == characters.end()) rendered[i] = "<" + std::to_string(static_cast<int>(node.symbol)) + ">";
+        else if (found->second == '\n') rendered[i] = "\\n";
+        else if (found->second == '\t') rendered[i] = "\\t";
+        else if (string("|()*+?[]{}\\-<>#").find(found->second) != string::npos) rendered[i] = string("\\") + found->second;
+        else rendered[i] = string(1, found->second);
+        break;
+      }
+      case RegexNode::EPSILON: rendered[i] = "\\L"; break;
+      case RegexNode::CONCAT: rendered[i] = operand(node.left) + " " + operand(node.right); break;
+      case RegexNode::UNION: rendered[i] = "(" + rendered[node.left] + "|" + rendered[node.right] + ")"; break;
+      case RegexNode::STAR: rendered[i] = operand(node.left) + "*"; break;
+      case RegexNode::PLUS: rendered[i] = operand(node.left) + "+"; break;
+      case RegexNode::OPTIONAL: rendered[i] = operand(node.left) + "?"; break;
+      case RegexNode::END: rendered[i] = "#" + std::to_string(node.token); break;
+      case RegexNode::REFERENCE: rendered[i] = definitions[node.token]->to_string(characters); break;
+    }
+  }
+  return rendered[root];
+}
+
+
+bool RegexAST::fixed_string(vector<char>& symbols) const {
+  symbols.clear();
+  if (root == -1) return false;
+  // Walk the concatenations left to right, following references into their definitions
+  vector<pair<const RegexAST*, int>> stack = {{this, root}};
+  while (!stack.empty()) {
+    const RegexAST* tree = stack.back().first;
+    const RegexNode& node = tree->nodes[stack.back().second];
+    stack.pop_back();
+    switch (node.kind) {
+      case RegexNode::SYMBOL: symbols.push_back(node.symbol); break;
+      case RegexNode::EPSILON: break;
+      case RegexNode::CONCAT:
+        stack.emplace_back(tree, node.right);
+        stack.emplace_back(tree, node.left);
+        break;
+      case RegexNode::REFERENCE: {
+        const RegexAST* definition = tree->definitions[node.token].get();
+        if (definition->root == -1) return false;
+        stack.emplace_back(definition, definition->root);
+        break;
+      }
+      default: return false;
+    }
+  }
+  return !symbols.empty();
+}
+
+
+const vector<RegexNode>& RegexAST::get_nodes() const {
+  return nodes;
+}
+
+
+const shared_ptr<const RegexAST>& RegexAST::get_definition(int index) const {
+  return definitions[index];
+}
+
+
+int RegexAST::get_root() const {
+  return root;
+}
+
+
+void RegexAST::set_root(int root) {
+  this->root = root;
+}
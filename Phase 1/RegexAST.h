@@ -0,0 +1,81 @@
+#ifndef REGEX_AST_H
+#define REGEX_AST_H
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+class RegexAST;
+
+/** Node of a regular expression syntax tree. Children are indices into the owning RegexAST's node list. */
+struct RegexNode {
+  enum Kind { SYMBOL, EPSILON, CONCAT, UNION, STAR, PLUS, OPTIONAL, END, REFERENCE };
+  Kind kind;
+  char symbol;  // Character id of a SYMBOL leaf
+  int token;    // Token id of an END marker, the definition index of a REFERENCE leaf, or the tag of an
+                // EPSILON leaf marking a capture position (-1 for a plain epsilon)
+  int left;     // First (or only) child, -1 for leaves
+  int right;    // Second child of CONCAT and UNION, -1 otherwise
+};
+
+/**
+ * Syntax tree of a regular expression over character ids.
+ * Nodes are stored so that children always come before their parents, which lets every bottom-up
+ * pass (nullable, firstpos, ...) run as a single loop over the node list.
+ *
+ * A REFERENCE leaf stands for a whole regular definition. Definitions are separate trees shared by
+ * every tree that refers to them, so a definition used many times is stored (and can be compiled) once;
+ * expanded() inlines them for consumers that need one node per occurrence.
+ */
+class RegexAST {
+  private:
+    std::vector<RegexNode> nodes;
+    int root;
+    std::vector<std::shared_ptr<const RegexAST>> definitions;
+    int expand_into(RegexAST& target) const;
+  public:
+    /** Empty tree (no root) */
+    RegexAST();
+    /**
+     * Parses a resolved keyword encoding as produced by RegexAnalyzer: negative character ids,
+     * 'L' for epsilon and the operators ( ) | * + ?. Throws on a malformed expression.
+     */
+    static RegexAST from_keywords(const std::vector<char>& keywords);
+
+    /** Adds a leaf and returns its index */
+    int add_symbol(char symbol);
+    int add_epsilon();
+    /** Adds an epsilon leaf that marks where tag is captured; automata without tags treat it as epsilon */
+    int add_tag(int tag);
+    int add_end(int token);
+    /** Adds an operator node over existing nodes and returns its index */
+    int add_node(RegexNode::Kind kind, int left, int right = -1);
+    /** Adds a leaf standing for a shared definition and returns its index */
+    int add_reference(const std::shared_ptr<const RegexAST>& definition);
+    /** Copies every node of other into this tree (sharing its definitions) and returns the new index of its root */
+    int graft(const RegexAST& other);
+    /** Appends a copy of the subtree under node and returns the index of the copy */
+    int copy(int node);
+    /**
+     * Renders the tree as a fully determined expression, using characters for the character ids found in
+     * characters (id -> character) and <id> for the others. Equal trees give equal strings.
+     */
+    std::string to_string(const std::unordered_map<char, char>& characters) const;
+
+    /**
+     * Returns true if the tree matches exactly one non-empty string (symbols joined by concatenations,
+     * references included) and stores its character ids in symbols.
+     */
+    bool fixed_string(std::vector<char>& symbols) const;
+
+    /** Returns a copy of the tree with every reference replaced by a copy of its definition */
+    RegexAST expanded() const;
+
+    const std::vector<RegexNode>& get_nodes() const;
+    /** Returns the definition a REFERENCE leaf's token indexes */
+    const std::shared_ptr<const RegexAST>& get_definition(int index) const;
+    int get_root() const;
+    void set_root(int root);
+};
+
+#endif
@@ -1,4 +1,6 @@
 #include "RegexAnalyzer.h"
+#include "Stats.h"
+#include "DerivativeAutomaton.h"
 using namespace std;
 
 RegexAnalyzer::RegexAnalyzer() {}
@@ -87,427 +89,67 @@ RegularDefToken &RegexAnalyzer::get_defTokenRef_by_name(const string &name)
   return emptyToken;
 }
 
-void RegexAnalyzer::resolveRegularDefToken()
+char RegexAnalyzer::charId(char c, bool escaped)
 {
-  // Queue of raw pointers to RegularDefToken
-  queue<RegularDefToken *> regularDefTokenQueue;
+  if (escaped) reservedSymbols.push_back(string(1, c));
+  auto found = charTokens.find(c);
+  if (found != charTokens.end()) return found->second;
+  // Ids are negative so they never clash with the operators or the '\0' epsilon of the NFA
+  if (currentCharId == 0) throw runtime_error("Too many distinct characters in the lexical rules.");
+  return charTokens[c] = currentCharId++;
+}
 
-  // Push all RegularDefTokens into the queue
+void RegexAnalyzer::resolveRegularDefToken()
+{
+  // Definitions are parsed depth first: a reference to a definition that is not parsed yet parses it on the
+  // spot, so they resolve in topological order whatever order the file lists them in
+  unordered_map<string, RegularDefToken *> byName;
+  for (RegularDefToken &token : regularDefTokens) byName[token.get_name()] = &token;
+  unordered_set<string> inProgress;
+  function<shared_ptr<const RegexAST>(const string &)> resolve = [&](const string &name) -> shared_ptr<const RegexAST> {
+    auto found = byName.find(name);
+    if (found == byName.end()) return nullptr;
+    RegularDefToken *token = found->second;
+    if (token->get_resolved()) return token->get_ast();
+    if (!inProgress.insert(name).second)
+      throw runtime_error("Regular definition " + name + " refers to itself.");
+    RegexParser parser([this](char c, bool escaped) { return charId(c, escaped); }, resolve);
+    token->set_ast(make_shared<const RegexAST>(parser.parse(token->get_regex())));
+    token->set_resolved(true);
+    inProgress.erase(name);
+    return token->get_ast();
+  };
   for (RegularDefToken &token : regularDefTokens)
   {
-    regularDefTokenQueue.push(&token); // Store the address of each token
-  }
-
-  // Process the queue
-  while (!regularDefTokenQueue.empty())
-  {
-    // Get the front token as a raw pointer
-    RegularDefToken *token = regularDefTokenQueue.front();
-    // Remove the processed token from the queue
-    regularDefTokenQueue.pop();
-    // Initialize token's keywords and supporting variables
-    vector<char> tokenKeywords = token->get_keywords();
-    vector<string> inTokenKeywords;
-    string regex = token->get_regex();
-    bool isTokenResolved = true;
-
-    // Process each character in the regex string
-    for (int i = 0; i < regex.size(); i++)
-    {
-      if (!isEnglishChar(regex[i]))
-      {
-        // Handle special regex characters and escape sequences
-        if (regex[i] == '\\')
-        {
-          if (regex[i + 1] == 'L')
-          {
-            tokenKeywords.push_back('L');
-          }
-          else
-          {
-            char charToken = regex[i + 1];
-            if (charTokens.find(charToken) != charTokens.end())
-            {
-              token->add_usedCharsID(charTokens[charToken]);
-              tokenKeywords.push_back(charTokens[charToken]);
-              reservedSymbols.push_back(string(1, charToken));
-            }
-            else
-            {
-              charTokens[charToken] = currentCharId++;
-              token->add_usedCharsID(charTokens[charToken]);
-              tokenKeywords.push_back(charTokens[charToken]);
-              reservedSymbols.push_back(string(1, charToken));
-            }
-          }
-          i++; // Skip the next character since it's part of an escape sequence
-        }
-        else if (regex[i] == '*' || regex[i] == '+' || regex[i] == '?' || regex[i] == '|' ||
-                 regex[i] == '(' || regex[i] == ')' || regex[i] == '$')
-        {
-          // Add operators and special regex characters directly
-          tokenKeywords.push_back(regex[i]);
-        }
-        else if (regex[i] != ' ')
-        {
-          // Handle character ranges (e.g., a-z)
-          if (i + 1 < regex.size() && regex[i + 1] == '-')
-          {
-            for (char c = regex[i]; c <= regex[i + 2]; c++)
-            {
-              char charToken = c;
-              if (charTokens.find(charToken) != charTokens.end())
-              {
-                token->add_usedCharsID(charTokens[charToken]);
-                tokenKeywords.push_back(charTokens[charToken]);
-              }
-              else
-              {
-                charTokens[charToken] = currentCharId++;
-                token->add_usedCharsID(charTokens[charToken]);
-                tokenKeywords.push_back(charTokens[charToken]);
-              }
-              if (c != regex[i + 2])
-              {
-                tokenKeywords.push_back('|');
-              }
-            }
-            i += 2; // Skip the range
-          }
-          else
-          {
-            char charToken = regex[i];
-            if (charTokens.find(charToken) != charTokens.end())
-            {
-              token->add_usedCharsID(charTokens[charToken]);
-              tokenKeywords.push_back(charTokens[charToken]);
-            }
-            else
-            {
-              charTokens[charToken] = currentCharId++;
-              token->add_usedCharsID(charTokens[charToken]);
-              tokenKeywords.push_back(charTokens[charToken]);
-            }
-          }
-        }
-      }
-      else if (i + 1 < regex.size() && isEnglishChar(regex[i + 1]))
-      {
-        // Handle multi-character tokens
-        inTokenKeywords.push_back(string(1, regex[i]));
-      }
-      else if (!inTokenKeywords.empty())
-      {
-        // Resolve multi-character tokens
-        string charToken = string(1, regex[i]);
-        inTokenKeywords.push_back(charToken);
-        string inTokenName = accumulate(inTokenKeywords.begin(), inTokenKeywords.end(), string(""));
-        inTokenKeywords.clear();
-        RegularDefToken *inToken = &get_defTokenRef_by_name(inTokenName);
-        if (inToken == nullptr) {
-          throw std::runtime_error("inToken is nullptr.");
-        }
-        if (!inToken || inToken->get_id() == -1)
-        {
-          assert(("Regular Definition Token not found", false));
-        }
-
-        if (!inToken->get_resolved())
-        {
-          // Push back unresolved tokens for reprocessing
-          regularDefTokenQueue.push(token);
-          isTokenResolved = false;
-          token->set_keywords(tokenKeywords);
-          break;
-        }
-        // Add resolved token's keywords
-        const auto& inTokenKeywords = inToken->get_keywords();
-        tokenKeywords.push_back('(');
-        tokenKeywords.insert(tokenKeywords.end(), inTokenKeywords.begin(), inTokenKeywords.end());
-        tokenKeywords.push_back(')');
-      }
-      else if (i + 1 < regex.size() && regex[i + 1] != '-')
-      {
-        // Add single characters
-        char charToken = regex[i];
-        if (charTokens.find(charToken) != charTokens.end())
-        {
-          token->add_usedCharsID(charTokens[charToken]);
-          tokenKeywords.push_back(charTokens[charToken]);
-        }
-        else
-        {
-          charTokens[charToken] = currentCharId++;
-          token->add_usedCharsID(charTokens[charToken]);
-          tokenKeywords.push_back(charTokens[charToken]);
-        }
-      }
-      else if (i + 1 < regex.size() && regex[i + 1] == '-')
-      {
-        // Handle character ranges (e.g., a-z)
-        for (char c = regex[i]; c <= regex[i + 2]; c++)
-        {
-          char charToken = c;
-          if (charTokens.find(charToken) != charTokens.end())
-          {
-            token->add_usedCharsID(charTokens[charToken]);
-            tokenKeywords.push_back(charTokens[charToken]);
-          }
-          else
-          {
-            charTokens[charToken] = currentCharId++;
-            token->add_usedCharsID(charTokens[charToken]);
-            tokenKeywords.push_back(charTokens[charToken]);
-          }
-          if (c != regex[i + 2])
-          {
-            tokenKeywords.push_back('|');
-          }
-        }
-        i += 2; // Skip the range
-      }
-      else
-      {
-        // add single characters
-        char charToken = regex[i];
-        if (charTokens.find(charToken) != charTokens.end())
-        {
-          token->add_usedCharsID(charTokens[charToken]);
-          tokenKeywords.push_back(charTokens[charToken]);
-        }
-        else
-        {
-          charTokens[charToken] = currentCharId++;
-          token->add_usedCharsID(charTokens[charToken]);
-          tokenKeywords.push_back(charTokens[charToken]);
-        }
-      }
-    }
-    if (!isTokenResolved)
-    {
-      continue; // Skip unresolved tokens for now
-    }
-
-    // Mark the token as resolved and update its keywords
-    token->set_resolved(true);
-    token->set_keywords(tokenKeywords);
+    resolve(token.get_name());
   }
 }
 
-// implement resolveRegularExpToken with the same logic as resolveRegularDefToken
 void RegexAnalyzer::resolveRegularExpToken()
 {
-  // Queue of raw pointers to RegularExpToken
-  queue<RegularExpToken *> regularExpTokenQueue;
-  // Push all RegularExpTokens into the queue
+  unordered_map<string, shared_ptr<const RegexAST>> definitions;
+  for (const RegularDefToken &token : regularDefTokens) definitions[token.get_name()] = token.get_ast();
+  vector<string> tags; // The @tags of the rule being parsed
+  RegexParser parser(
+      [this](char c, bool escaped) { return charId(c, escaped); },
+      [&definitions](const string &name) -> shared_ptr<const RegexAST> {
+        auto found = definitions.find(name);
+        return found == definitions.end() ? nullptr : found->second;
+      },
+      [&tags](const string &name) {
+        auto found = find(tags.begin(), tags.end(), name);
+        if (found != tags.end()) return static_cast<int>(found - tags.begin());
+        tags.push_back(name);
+        return static_cast<int>(tags.size()) - 1;
+      });
   for (RegularExpToken &token : regularExpTokens)
   {
-    regularExpTokenQueue.push(&token); // Store the address of each token
-  }
-
-  // Process the queue
-  while (!regularExpTokenQueue.empty())
-  {
-    // Get the front token as a raw pointer
-    RegularExpToken *token = regularExpTokenQueue.front();
-    // Remove the processed token from the queue
-    regularExpTokenQueue.pop();
-    // Initialize token's keywords and supporting variables
-    vector<char> tokenKeywords = token->get_keywords();
-    vector<string> inTokenKeywords;
-    string regex = token->get_regex();
-    bool isTokenResolved = true;
-    //if the name of the token is a keyword or a punctuation, add ignore it
-    unordered_set<string> keywordsSet(keywords.begin(), keywords.end());
-    unordered_set<string> punctuationsSet(punctuations.begin(), punctuations.end());
-    if (keywordsSet.find(token->get_name()) != keywordsSet.end() ||
-        punctuationsSet.find(token->get_name()) != punctuationsSet.end()) {
-        continue;
-    }
-    // Process each character in the regex string
-    for (int i = 0; i < regex.size(); i++)
-    {
-      if (!isEnglishChar(regex[i]))
-      {
-        // Handle special regex characters and escape sequences
-        if (regex[i] == '\\')
-        {
-          if (regex[i + 1] == 'L')
-          {
-            tokenKeywords.push_back('L');
-          }
-          else
-          {
-            char charToken = regex[i + 1];
-            if (charTokens.find(charToken) != charTokens.end())
-            {
-              token->add_usedCharsID(charTokens[charToken]);
-              tokenKeywords.push_back(charTokens[charToken]);
-              reservedSymbols.push_back(string(1, charToken));
-            }
-            else
-            {
-              charTokens[charToken] = currentCharId++;
-              token->add_usedCharsID(charTokens[charToken]);
-              tokenKeywords.push_back(charTokens[charToken]);
-              reservedSymbols.push_back(string(1, charToken));
-            }
-          }
-          i++; // Skip the next character since it's part of an escape sequence
-        }
-        else if (regex[i] == '*' || regex[i] == '+' || regex[i] == '?' || regex[i] == '|' ||
-                 regex[i] == '(' || regex[i] == ')' || regex[i] == '$')
-        {
-          // Add operators and special regex characters directly
-          tokenKeywords.push_back(regex[i]);
-        }
-        else if (regex[i] != ' ')
-        {
-          // Handle character ranges (e.g., a-z)
-          if (i + 1 < regex.size() && regex[i + 1] == '-')
-          {
-            for (char c = regex[i]; c <= regex[i + 2]; c++)
-            {
-              char charToken = c;
-              tokenKeywords.push_back('(');
-              if (charTokens.find(charToken) != charTokens.end())
-              {
-                token->add_usedCharsID(charTokens[charToken]);
-                tokenKeywords.push_back(charTokens[charToken]);
-              }
-              else
-              {
-                charTokens[charToken] = currentCharId++;
-                token->add_usedCharsID(charTokens[charToken]);
-                tokenKeywords.push_back(charTokens[charToken]);
-              }
-              if (c != regex[i + 2])
-              {
-                tokenKeywords.push_back('|');
-              }
-            }
-            tokenKeywords.push_back(')');
-            i += 2; // Skip the range
-          }
-          else
-          {
-            char charToken = regex[i];
-            if (charTokens.find(charToken) != charTokens.end())
-            {
-              token->add_usedCharsID(charTokens[charToken]);
-              tokenKeywords.push_back(charTokens[charToken]);
-            }
-            else
-            {
-              charTokens[charToken] = currentCharId++;
-              token->add_usedCharsID(charTokens[charToken]);
-              tokenKeywords.push_back(charTokens[charToken]);
-            }
-          }
-        }
-      }
-      else if (i + 1 < regex.size() && isEnglishChar(regex[i + 1]))
-      {
-        // Handle multi-character tokens
-        inTokenKeywords.push_back(string(1, regex[i]));
-      }
-      else if (!inTokenKeywords.empty())
-      {
-        // Resolve multi-character tokens
-        string charToken = string(1, regex[i]);
-        inTokenKeywords.push_back(charToken);
-        string inTokenName = accumulate(inTokenKeywords.begin(), inTokenKeywords.end(), string(""));
-        inTokenKeywords.clear();
-        RegularDefToken *inToken = &get_defTokenRef_by_name(inTokenName);
-        if (inToken == nullptr) {
-          throw std::runtime_error("inToken is nullptr.");
-        }
-        if (!inToken || inToken->get_id() == -1)
-        {
-          assert(("Regular Definition Token not found", false));
-        }
-
-        if (!inToken->get_resolved())
-        {
-          // Push back unresolved tokens for reprocessing
-          regularExpTokenQueue.push(token);
-          isTokenResolved = false;
-          token->set_keywords(tokenKeywords);
-          break;
-        }
-        // Add resolved token's keywords
-        const auto& inTokenKeywords = inToken->get_keywords();
-        tokenKeywords.push_back('(');
-        tokenKeywords.insert(tokenKeywords.end(), inTokenKeywords.begin(), inTokenKeywords.end());
-        tokenKeywords.push_back(')');
-      }
-      else if (i + 1 < regex.size() && regex[i + 1] != '-')
-      {
-        // Add single characters
-        char charToken = regex[i];
-        if (charTokens.find(charToken) != charTokens.end())
-        {
-          token->add_usedCharsID(charTokens[charToken]);
-          tokenKeywords.push_back(charTokens[charToken]);
-        }
-        else
-        {
-          charTokens[charToken] = currentCharId++;
-          token->add_usedCharsID(charTokens[charToken]);
-          tokenKeywords.push_back(charTokens[charToken]);
-        }
-      }
-      else if (i + 1 < regex.size() && regex[i + 1] == '-')
-      {
-        // Handle character ranges (e.g., a-z)
-        tokenKeywords.push_back('(');
-        for (char c = regex[i]; c <= regex[i + 2]; c++)
-        {
-          char charToken = c;
-          if (charTokens.find(charToken) != charTokens.end())
-          {
-            token->add_usedCharsID(charTokens[charToken]);
-            tokenKeywords.push_back(charTokens[charToken]);
-          }
-          else
-          {
-            charTokens[charToken] = currentCharId++;
-            token->add_usedCharsID(charTokens[charToken]);
-            tokenKeywords.push_back(charTokens[charToken]);
-          }
-          if (c != regex[i + 2])
-          {
-            tokenKeywords.push_back('|');
-          }
-        }
-        tokenKeywords.push_back(')');
-        i += 2; // Skip the range
-      }
-      else
-      {
-        // add single characters
-        char charToken = regex[i];
-        if (charTokens.find(charToken) != charTokens.end())
-        {
-          token->add_usedCharsID(charTokens[charToken]);
-          tokenKeywords.push_back(charTokens[charToken]);
-        }
-        else
-        {
-          charTokens[charToken] = currentCharId++;
-          token->add_usedCharsID(charTokens[charToken]);
-          tokenKeywords.push_back(charTokens[charToken]);
-        }
-      }
-    }
-    if (!isTokenResolved)
-    {
-      continue; // Skip unresolved tokens for now
-    }
-
-    // Mark the token as resolved and update its keywords
-    token->set_resolved(true);
-    token->set_keywords(tokenKeywords);
+    // Keywords and punctuations are built while reading the rules
+    if (token.get_resolved()) continue;
+    tags.clear();
+    token.set_ast(parser.parse(token.get_regex()));
+    token.set_resolved(true);
+    if (!tags.empty()) tokenTags[token.get_id()] = tags;
   }
 }
 
@@ -552,6 +194,23 @@ void RegexAnalyzer::parseLexicalRules()
   string line;
   while (getline(file, line))
   {
+    // <MODE,...> in front of a rule puts its tokens in those start conditions instead of INITIAL
+    vector<int> lineModes;
+    if (!line.empty() && line[0] == '<')
+    {
+      size_t close = line.find('>');
+      if (close == string::npos) throw runtime_error("Unclosed start condition in rule: " + line);
+      istringstream names(line.substr(1, close - 1));
+      string name;
+      while (getline(names, name, ','))
+      {
+        name.erase(remove(name.begin(), name.end(), ' '), name.end());
+        if (!name.empty()) lineModes.push_back(modeId(name));
+      }
+      size_t rule = line.find_first_not_of(' ', close + 1);
+      line = rule == string::npos ? "" : line.substr(rule);
+    }
+    size_t firstToken = regularExpTokens.size();
     if (line[0] == '{')
     {
       string originalKeywords = line.substr(1, line.size() - 2); // Extract and preserve the original string
@@ -568,6 +227,9 @@ void RegexAnalyzer::parseLexicalRules()
             keywordChar = charTokens[keywordChar];
           }
           RegularExpToken regToken = RegularExpToken(currentkeyWordId--, keywordstring, keywordstring, keywordChars);
+          regToken.set_ast(RegexAST::from_keywords(keywordChars));
+          regToken.set_resolved(true);
+          keywordIds.insert(regToken.get_id());
           keywords.push_back(keywordstring);
           regularExpTokens.push_back(regToken);
           keywordChars.clear();
@@ -594,12 +256,30 @@ void RegexAnalyzer::parseLexicalRules()
             keywordChar = charTokens[keywordChar];
           }
           RegularExpToken regToken = RegularExpToken(currentkeyWordId--, keywordstring, keywordstring, keywordChars);
+          regToken.set_ast(RegexAST::from_keywords(keywordChars));
+          regToken.set_resolved(true);
+          keywordIds.insert(regToken.get_id());
           keywords.push_back(keywordstring);
           regularExpTokens.push_back(regToken);
           keywordChars.clear();
         }
       }
     }
+    else if (line.compare(0, 7, "%ignore") == 0)
+    {
+      // %ignore name... : tokens that only separate others, such as comments, dropped by the scanner
+      istringstream names(line.substr(7));
+      string name;
+      while (names >> name) ignoredNames.push_back(name);
+    }
+    else if (line.compare(0, 6, "%begin") == 0)
+    {
+      // %begin name MODE : scanning continues in MODE after the token name
+      istringstream names(line.substr(6));
+      string token, mode;
+      if (!(names >> token >> mode)) throw runtime_error("Expected %begin token MODE: " + line);
+      modeSwitchNames.emplace_back(token, mode);
+    }
     else if (line[0] == '[')
     {
       for (int i = 1; i < line.size() - 1; i++)
@@ -613,6 +293,8 @@ void RegexAnalyzer::parseLexicalRules()
         punctuations.push_back(charToken);
         // add to regula expression
         RegularExpToken regToken = RegularExpToken(currentkeyWordId--, charToken, charToken, vector<char>({charTokens[charToken[0]]}));
+        regToken.set_ast(RegexAST::from_keywords(regToken.get_keywords()));
+        regToken.set_resolved(true);
         regularExpTokens.push_back(regToken);
         if (i > 1 && line[i - 1] == '\\')
         {
@@ -674,6 +356,10 @@ void RegexAnalyzer::parseLexicalRules()
     {
       assert(("Invalid line format detected", false));
     }
+    if (!lineModes.empty() && lineModes != vector<int>{0})
+    {
+      for (size_t i = firstToken; i < regularExpTokens.size(); i++) tokenModes[regularExpTokens[i].get_id()] = lineModes;
+    }
   }
   file.close();
 }
@@ -681,34 +367,26 @@ void RegexAnalyzer::parseLexicalRules()
 void RegexAnalyzer::printRegularExpTokens()
 {
   cout << "\nRegular Expression Tokens:" << endl;
+  unordered_map<char, char> idChars;
+  for (auto const &pair : charTokens) idChars[pair.second] = pair.first;
   // print the regular expression tokens in the form of id, name, regex and keywords
   for (RegularExpToken token : regularExpTokens)
   {
     cout << token.get_id() << " " << token.get_name() << " " << token.get_regex() << endl;
-    vector<char> keywords = token.get_keywords();
-    cout << "Keywords for " << token.get_name() << ": ";
-    for (char keyword : keywords)
-    {
-      cout << keyword << " ";
-    }
-    cout << endl;
+    cout << "Syntax tree for " << token.get_name() << ": " << token.get_ast().to_string(idChars) << endl;
   }
 }
 
 void RegexAnalyzer::printRegularDefTokens()
 {
   cout << "Regular Definition Tokens:" << endl;
+  unordered_map<char, char> idChars;
+  for (auto const &pair : charTokens) idChars[pair.second] = pair.first;
   // print the regular expression tokens in the form of id, name, regex and keywords
   for (RegularDefToken token : regularDefTokens)
   {
     cout << token.get_id() << " " << token.get_name() << " " << token.get_regex() << endl;
-    vector<char> keywords = token.get_keywords();
-    cout << "Keywords for " << token.get_name() << ": ";
-    for (char keyword : keywords)
-    {
-      cout << keyword << " ";
-    }
-    cout << endl;
+    cout << "Syntax tree for " << token.get_name() << ": " << token.get_ast()->to_string(idChars) << endl;
   }
 }
 
@@ -748,177 +426,252 @@ void RegexAnalyzer::printReservedSymbols()
   }
 }
 
+int RegexAnalyzer::modeId(const string &name)
+{
+  auto found = find(modes.begin(), modes.end(), name);
+  if (found != modes.end()) return static_cast<int>(found - modes.begin());
+  modes.push_back(name);
+  return static_cast<int>(modes.size()) - 1;
+}
+
+bool RegexAnalyzer::inMode(int tokenId, int mode) const
+{
+  auto found = tokenModes.find(tokenId);
+  if (found == tokenModes.end()) return mode == 0;
+  return find(found->second.begin(), found->second.end(), mode) != found->second.end();
+}
+
+int RegexAnalyzer::getModeCount() const
+{
+  return static_cast<int>(modes.size());
+}
+
+unordered_map<int, int> RegexAnalyzer::getModeSwitches() const
+{
+  unordered_map<int, int> switches;
+  for (const auto &modeSwitch : modeSwitchNames)
+  {
+    auto token = find_if(regularExpTokens.begin(), regularExpTokens.end(),
+                         [&modeSwitch](const RegularExpToken &candidate) { return candidate.get_name() == modeSwitch.first; });
+    if (token == regularExpTokens.end()) throw runtime_error("%begin names no token: " + modeSwitch.first);
+    auto mode = find(modes.begin(), modes.end(), modeSwitch.second);
+    if (mode == modes.end()) throw runtime_error("%begin names a mode without rules: " + modeSwitch.second);
+    switches[token->get_id()] = static_cast<int>(mode - modes.begin());
+  }
+  return switches;
+}
+
+vector<pair<int, TaggedNFA>> RegexAnalyzer::getTaggedTokens() const
+{
+  vector<pair<int, TaggedNFA>> tagged;
+  for (const RegularExpToken &token : regularExpTokens)
+  {
+    auto tags = tokenTags.find(token.get_id());
+    if (tags != tokenTags.end()) tagged.emplace_back(token.get_id(), TaggedNFA(token.get_ast(), tags->second));
+  }
+  return tagged;
+}
+
+vector<int> RegexAnalyzer::getIgnoredTokenIds() const
+{
+  vector<int> ids;
+  for (const string &name : ignoredNames)
+  {
+    auto token = find_if(regularExpTokens.begin(), regularExpTokens.end(),
+                         [&name](const RegularExpToken &candidate) { return candidate.get_name() == name; });
+    if (token == regularExpTokens.end()) throw runtime_error("%ignore names no token: " + name);
+    ids.push_back(token->get_id());
+  }
+  return ids;
+}
+
 NFA RegexAnalyzer::RegexToNFA()
 {
+  resolve();
+  NFA nfa = generateNFA();
+  //nfa.print_nfa();
+  return nfa;
+}
+
+void RegexAnalyzer::resolve()
+{
+  stats::ScopedTimer timer("lexer.resolve_rules");
   parseLexicalRules();
   resolveRegularDefToken();
   resolveRegularExpToken();
   printAll();
-  NFA nfa = generateNFA();
-  //nfa.print_nfa();
-  return nfa;
 }
 
-NFA RegexAnalyzer::generateNFA()
+vector<pair<string, int>> RegexAnalyzer::excludeKeywords()
 {
-  vector<NFA> nfas;
+  // Run every keyword through an automaton of the other tokens to find the token that would match it
+  // Only INITIAL is looked up after the scan, so keywords in other modes stay in their automata
+  vector<pair<int, RegexAST>> others;
+  for (const RegularExpToken &token : regularExpTokens)
+  {
+    if (keywordIds.find(token.get_id()) == keywordIds.end() && inMode(token.get_id(), 0))
+      others.emplace_back(token.get_id(), token.get_ast());
+  }
+  vector<pair<string, int>> excluded;
+  if (others.empty()) return excluded;
+  DerivativeAutomaton automaton(others, 1000);
+  for (const RegularExpToken &token : regularExpTokens)
+  {
+    if (keywordIds.find(token.get_id()) == keywordIds.end() || tokenModes.count(token.get_id())) continue;
+    int state = automaton.initial();
+    for (char c : token.get_keywords()) state = automaton.step(state, c);
+    int host = automaton.accept(state);
+    // The keyword can only be recovered from the lexeme if the DFA would have preferred it
+    if (host == -1 || host < token.get_id()) continue;
+    excludedTokens.insert(token.get_id());
+    excluded.emplace_back(token.get_name(), token.get_id());
+  }
+  stats::count("lexer.hashed_keywords", static_cast<long long>(excluded.size()));
+  return excluded;
+}
+
+vector<pair<int, RegexAST>> RegexAnalyzer::generateASTs(int mode) const
+{
+  vector<pair<int, RegexAST>> asts;
+  for (const RegularExpToken &token : regularExpTokens)
+  {
+    if (excludedTokens.find(token.get_id()) != excludedTokens.end() || !inMode(token.get_id(), mode)) continue;
+    asts.emplace_back(token.get_id(), token.get_ast());
+  }
+  return asts;
+}
+
+NFA RegexAnalyzer::generateNFA(int mode)
+{
+  stats::ScopedTimer timer("lexer.regex_to_nfa");
+  // State 0 starts every token, each token's fragment hangs off it by an epsilon move
+  NFA nfa;
+  nfa.add_state(0);
+  nfa.make_initial(0);
   stateCounter = 1;
-  for (RegularExpToken token : regularExpTokens)
+  definitionNFAs.clear();
+  // Fixed-string tokens (keywords, punctuation, literal rules) share one trie rooted at state 0 itself
+  map<pair<int, char>, int> trie;
+  vector<char> symbols;
+  for (const RegularExpToken &token : regularExpTokens)
   {
-    nfas.push_back(RegularExpTokenToNFA(token));
+    if (excludedTokens.find(token.get_id()) != excludedTokens.end() || !inMode(token.get_id(), mode)) continue;
+    if (token.get_ast().fixed_string(symbols)) FixedStringToNFA(token, symbols, nfa, trie);
+    else RegularExpTokenToNFA(token, nfa);
   }
-  NFA nfa = NFA::union_nfa(nfas, 0);
-  
+  stats::count("lexer.trie_states", static_cast<long long>(trie.size()));
+  if (stats::enabled()) stats::count("lexer.nfa_states", static_cast<long long>(nfa.get_states().size()));
   return nfa;
 }
 
-NFA RegexAnalyzer::RegularExpTokenToNFA(RegularExpToken token)
+void RegexAnalyzer::RegularExpTokenToNFA(const RegularExpToken &token, NFA &nfa)
+{
+  pair<int, int> fragment = ASTToNFA(token.get_ast(), nfa, stateCounter);
+  nfa.add_transition(0, '\0', fragment.first);
+  nfa.make_accepting(fragment.second, token.get_id());
+}
+
+void RegexAnalyzer::FixedStringToNFA(const RegularExpToken &token, const vector<char> &symbols, NFA &nfa, map<pair<int, char>, int> &trie)
 {
-  vector<char> keywords = token.get_keywords();
-  vector<NFA> baseNFAs;
-  for (size_t i = 0; i < keywords.size(); i++)
+  int state = 0;
+  for (char symbol : symbols)
   {
-    if (keywords[i] < 0)
+    auto edge = trie.find({state, symbol});
+    if (edge == trie.end())
     {
-      int intialState = stateCounter++;
-      int acceptingState = stateCounter++;
-      NFA defNFA = NFA();
-      defNFA.add_state(intialState);
-      defNFA.add_state(acceptingState);
-      defNFA.make_initial(intialState);
-      defNFA.make_accepting(acceptingState, 0);
-      defNFA.add_transition(intialState, keywords[i], acceptingState);
-      baseNFAs.push_back(defNFA);
-      keywords[i] = 'n';
-    }
-    else if (keywords[i] == 'L')
-    {
-      int intialState = stateCounter++;
-      int acceptingState = stateCounter++;
-      NFA defNFA = NFA();
-      defNFA.add_state(intialState);
-      defNFA.add_state(acceptingState);
-      defNFA.make_initial(intialState);
-      defNFA.make_accepting(acceptingState, 0);
-      defNFA.add_transition(intialState, '\0', acceptingState);
-      baseNFAs.push_back(defNFA);
-      keywords[i] = 'n';
+      int next = stateCounter++;
+      nfa.add_state(next);
+      nfa.add_transition(state, symbol, next);
+      edge = trie.emplace(make_pair(state, symbol), next).first;
     }
+    state = edge->second;
+  }
+  // The same string given twice keeps the token the automaton prefers, the one with the smaller id
+  int accepted = nfa.accept(state);
+  if (accepted == -1 || token.get_id() < accepted) nfa.make_accepting(state, token.get_id());
+}
+
+pair<int, int> RegexAnalyzer::ASTToNFA(const RegexAST &ast, NFA &nfa, int &counter)
+{
+  // Thompson's construction, one pass over the tree since children come before their parents
+  const vector<RegexNode> &nodes = ast.get_nodes();
+  vector<bool> reachable(nodes.size(), false);
+  vector<int> stack = {ast.get_root()};
+  while (!stack.empty())
+  {
+    int node = stack.back();
+    stack.pop_back();
+    reachable[node] = true;
+    if (nodes[node].left != -1) stack.push_back(nodes[node].left);
+    if (nodes[node].right != -1) stack.push_back(nodes[node].right);
   }
-  // add a '(' at the start of the keywords and a ')' at the end of the keywords
-  keywords.insert(keywords.begin(), '(');
-  keywords.push_back(')');
-  int baseNFAIndex = 0, bracketStart = 0, bracketEnd = 0;
-  while (keywords.size() > 1) // O(number of keywords * number of brackets)
+
+  vector<pair<int, int>> fragments(nodes.size()); // Start and accepting state of every node's fragment
+  for (size_t i = 0; i < nodes.size(); i++)
   {
-    baseNFAIndex = 0;
-    bracketStart = 0;
-    bracketEnd = 0;
-    for (size_t i = 0; i < keywords.size(); i++)
+    if (!reachable[i]) continue;
+    const RegexNode &node = nodes[i];
+    if (node.kind == RegexNode::CONCAT)
     {
-      if (keywords[i] == '(')
-      {
-        bracketStart = i;
-      }
-      else if (keywords[i] == ')')
-      {
-        bracketEnd = i;
-        for (size_t j = 0; j < bracketStart; j++)
-        {
-          if (keywords[j] == 'n')
-          {
-            baseNFAIndex++;
-          }
-        }
-        // 1. handle the case of a character followed by one of the operators *, +, ?
-        //print the size of the keywords between the brackets
-        int nfaIter = baseNFAIndex;
-        for (size_t j = bracketStart+1; j < bracketEnd; j++)
-        {
-          if (keywords[j] == 'n' && j+1<bracketEnd && (keywords[j+1] == '*' | keywords[j+1] == '+'))
-          {
-            if (keywords[j+1] == '*')
-              {
-                baseNFAs[nfaIter] = baseNFAs[nfaIter].simple_repeat(true, stateCounter++, 0);
-                //remove element with index j+1 from keywords
-                keywords.erase(keywords.begin() + j+1);
-                --j;
-                bracketEnd--;
-              }
-              else if (keywords[j+1] == '+')
-              {
-                baseNFAs[nfaIter] = baseNFAs[nfaIter].simple_repeat(false, stateCounter++, 0);
-                //remove element with index j+1 from keywords
-                keywords.erase(keywords.begin() + j+1);
-                --j;
-                bracketEnd--;
-              }
-          }
-          else if(keywords[j]=='n'){
-            nfaIter++;
-          }
-        }
-        // 2. handle the case of a character followed by a character (concatenation)
-        nfaIter = baseNFAIndex;
-        for(size_t j = bracketStart+1; j < bracketEnd; j++)
-        {
-          if (keywords[j] == 'n' && j+1<bracketEnd && keywords[j+1] == 'n')
-          {
-            baseNFAs[nfaIter] = baseNFAs[nfaIter].simple_concat(baseNFAs[nfaIter+1], 0);
-            //remove element with index j+1 from keywords
-            keywords.erase(keywords.begin() + j+1);
-            //remove the baseNFA with index nfaIter+1
-            baseNFAs.erase(baseNFAs.begin() + nfaIter+1);
-            --j;
-            bracketEnd--;
-          }
-          else if(keywords[j]=='n'){
-            nfaIter++;
-          }
-        }
-        // 3. handle the case of a character followed by '|' and then a character (union)
-        vector <NFA> tempNFAs;
-        for(size_t j = bracketStart+1; j < bracketEnd; j++)
-        {
-          if (keywords[j] == 'n' && j+1<bracketEnd && keywords[j+1] == '|')
-          {
-            tempNFAs.push_back(baseNFAs[baseNFAIndex+1]);
-            //remove elements with index j+1 and j+2 from keywords
-            keywords.erase(keywords.begin() + j+1);
-            keywords.erase(keywords.begin() + j+1);
-            //remove the baseNFA with index baseNFAIndex+1
-            baseNFAs.erase(baseNFAs.begin() + baseNFAIndex+1);
-            --j;
-            bracketEnd -= 2;
-          }
-        }
-        //push baseNFAIndex to the beggining of the vector
-        tempNFAs.insert(tempNFAs.begin(), baseNFAs[baseNFAIndex]);
-        baseNFAs[baseNFAIndex] = NFA::union_nfa(tempNFAs, stateCounter++, true, stateCounter++, 0);
-        if (bracketEnd - bracketStart == 2)
-        {
-          keywords.erase(keywords.begin() + bracketStart);
-          keywords.erase(keywords.begin() + bracketEnd-1);
-        }
-        else
-        {
-          cout << "bracketStart: " << bracketStart << " bracketEnd: " << bracketEnd << endl;
-          cout << "keywords in the bracket: ";
-          for (size_t j = bracketStart; j <= bracketEnd; j++)
-          {
-            cout << keywords[j] << " ";
-          }
-          cout << endl;
-          //invalid regular expression
-          assert(("Invalid regular expression", false));
-        }
+      // Join the two fragments instead of adding states
+      nfa.add_transition(fragments[node.left].second, '\0', fragments[node.right].first);
+      fragments[i] = {fragments[node.left].first, fragments[node.right].second};
+      continue;
+    }
+    if (node.kind == RegexNode::REFERENCE)
+    {
+      // Stamp a renumbered copy of the definition's NFA, which is only built the first time
+      const NFATemplate &definition = definitionNFA(*ast.get_definition(node.token));
+      nfa.merge(definition.nfa.copy_with_new_ids(counter));
+      fragments[i] = {definition.start + counter, definition.accept + counter};
+      counter += definition.size;
+      continue;
+    }
+    int start = counter++, accept = counter++;
+    nfa.add_state(start);
+    nfa.add_state(accept);
+    switch (node.kind)
+    {
+      case RegexNode::SYMBOL:
+        nfa.add_transition(start, node.symbol, accept);
         break;
-      }
+      case RegexNode::EPSILON:
+        nfa.add_transition(start, '\0', accept);
+        break;
+      case RegexNode::UNION:
+        nfa.add_transition(start, '\0', fragments[node.left].first);
+        nfa.add_transition(start, '\0', fragments[node.right].first);
+        nfa.add_transition(fragments[node.left].second, '\0', accept);
+        nfa.add_transition(fragments[node.right].second, '\0', accept);
+        break;
+      case RegexNode::STAR:
+      case RegexNode::PLUS:
+      case RegexNode::OPTIONAL:
+        nfa.add_transition(start, '\0', fragments[node.left].first);
+        nfa.add_transition(fragments[node.left].second, '\0', accept);
+        if (node.kind != RegexNode::PLUS) nfa.add_transition(start, '\0', accept);
+        if (node.kind != RegexNode::OPTIONAL) nfa.add_transition(fragments[node.left].second, '\0', fragments[node.left].first);
+        break;
+      default:
+        throw runtime_error("Unexpected node in a syntax tree.");
     }
+    fragments[i] = {start, accept};
   }
-  NFA FinalNFA = baseNFAs[0];
-  FinalNFA.make_accepting(FinalNFA.get_single_accepting(), token.get_id());
-  return FinalNFA;
+  return fragments[ast.get_root()];
+}
+
+const RegexAnalyzer::NFATemplate &RegexAnalyzer::definitionNFA(const RegexAST &definition)
+{
+  auto found = definitionNFAs.find(&definition);
+  if (found != definitionNFAs.end()) return found->second;
+  NFATemplate compiled;
+  compiled.size = 0;
+  pair<int, int> fragment = ASTToNFA(definition, compiled.nfa, compiled.size);
+  compiled.nfa.make_initial(fragment.first);
+  compiled.start = fragment.first;
+  compiled.accept = fragment.second;
+  stats::count("lexer.definition_nfas");
+  return definitionNFAs.emplace(&definition, move(compiled)).first->second;
 }
 
 unordered_map<int, std::string> RegexAnalyzer::getTokensIdNameMap()
@@ -3,10 +3,15 @@
 #include <string>
 #include <vector>
 #include <fstream>
+#include <map>
 #include <unordered_map>
+#include <unordered_set>
 #include "RegularExpToken.h"
 #include "RegularDefToken.h"
 #include "NFA.h"
+#include "RegexAST.h"
+#include "RegexParser.h"
+#include "TaggedNFA.h"
 
 class RegexAnalyzer {
   private:
@@ -30,6 +35,29 @@ class RegexAnalyzer {
     std::unordered_map<char, char> charTokens;
     /** The Keywords of the regex. */
     std::vector<std::string> keywords;
+    /** The NFA fragment of a regular definition, with states numbered from 0 */
+    struct NFATemplate {
+      NFA nfa;
+      int start;
+      int accept;
+      int size;
+    };
+    /** The compiled fragment of every definition referenced so far, copied into each token that uses it */
+    std::unordered_map<const RegexAST*, NFATemplate> definitionNFAs;
+    /** The ids of the keyword tokens */
+    std::unordered_set<int> keywordIds;
+    /** Tokens left out of the generated automata, see excludeKeywords */
+    std::unordered_set<int> excludedTokens;
+    /** Names of the tokens listed by %ignore lines */
+    std::vector<std::string> ignoredNames;
+    /** Names of the start conditions (modes), INITIAL first */
+    std::vector<std::string> modes{"INITIAL"};
+    /** The modes of every token tagged with <MODE,...>; untagged tokens are only in INITIAL */
+    std::unordered_map<int, std::vector<int>> tokenModes;
+    /** Token and mode names of the %begin lines */
+    std::vector<std::pair<std::string, std::string>> modeSwitchNames;
+    /** The @tags of every token whose rule captures positions, in order of first use */
+    std::unordered_map<int, std::vector<std::string>> tokenTags;
     /** The Punctuations of the regex. */
     std::vector<std::string> punctuations;
     /** The Reserved Symbols of the regex. */
@@ -38,20 +66,24 @@ class RegexAnalyzer {
     static bool isEnglishChar(char c);
     /** Parses the lexical rules from a file. */
     void parseLexicalRules();
-    /** resolve the regular definition token 
-     * by replacing tokens and expressions from the regex
-     * with their corresponding char id
-     */
+    /** Returns the index of a mode, adding it if it is new */
+    int modeId(const std::string& name);
+    /** Returns true if a token is scanned in a mode */
+    bool inMode(int tokenId, int mode) const;
+    /** Returns the id of a char, assigning the next free id to a new char */
+    char charId(char c, bool escaped);
+    /** parse the regex of every regular definition token into its syntax tree */
     void resolveRegularDefToken();
-    /** resolve the regular expression token 
-     * by replacing tokens and expressions from the regex
-     * with their corresponding char id
-     */
+    /** parse the regex of every regular expression token into its syntax tree */
     void resolveRegularExpToken();
-    /** generate the NFA from the nfas representing the regular expressions tokens */
-    NFA generateNFA();
-    /** convert a single regular expression token to NFA */
-    NFA RegularExpTokenToNFA(RegularExpToken token);
+    /** add the NFA of a single regular expression token to nfa, reachable from its initial state */
+    void RegularExpTokenToNFA(const RegularExpToken& token, NFA& nfa);
+    /** add a fixed-string token to the trie of fixed strings, whose edges (state, char) -> state are kept in trie */
+    void FixedStringToNFA(const RegularExpToken& token, const std::vector<char>& symbols, NFA& nfa, std::map<std::pair<int, char>, int>& trie);
+    /** add the Thompson NFA of a syntax tree to nfa, numbering new states from counter. Returns its start and accepting states */
+    std::pair<int, int> ASTToNFA(const RegexAST& ast, NFA& nfa, int& counter);
+    /** returns the compiled fragment of a definition, compiling it on first use */
+    const NFATemplate& definitionNFA(const RegexAST& definition);
     /** get the regular definition token by its name */
     RegularDefToken get_defToken_by_name(std::string name);
     /**get the regular definition ref name */
@@ -78,6 +110,26 @@ class RegexAnalyzer {
     RegularExpToken get_token(int id) const;
     /** Converts the regular expressions to NFA. */
     NFA RegexToNFA();
+    /** Parses the rules file and resolves every token to its keyword encoding. Must run before the generators below */
+    void resolve();
+    /** generate the NFA from the nfas representing the regular expressions tokens of a mode */
+    NFA generateNFA(int mode = 0);
+    /**
+     * Leaves out of generateNFA and generateASTs every keyword that some other token matches too (and that
+     * would win over it), so the automaton only finds the other token. Returns those keywords with their
+     * token ids, to be told apart by looking the lexeme up after the scan.
+     */
+    std::vector<std::pair<std::string, int>> excludeKeywords();
+    /** Returns the syntax tree of every resolved token of a mode, paired with its token id */
+    std::vector<std::pair<int, RegexAST>> generateASTs(int mode = 0) const;
+    /** Returns the number of start conditions (modes); mode 0 is INITIAL, the one every scan starts in */
+    int getModeCount() const;
+    /** Returns token id -> mode for the tokens that switch the mode (%begin lines). Throws on unknown names */
+    std::unordered_map<int, int> getModeSwitches() const;
+    /** Returns a tagged NFA for every token whose rule marks capture positions, paired with its token id */
+    std::vector<std::pair<int, TaggedNFA>> getTaggedTokens() const;
+    /** Returns the ids of the tokens listed by %ignore lines. Throws if one names no token */
+    std::vector<int> getIgnoredTokenIds() const;
     /** Returns the tokens map id -> name */
     std::unordered_map<int, std::string> getTokensIdNameMap();
     /** Returns the char tokens map char -> id */
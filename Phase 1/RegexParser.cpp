@@ -0,0 +1,271 @@
+#include "RegexParser.h"
+#include <stdexcept>
+using namespace std;
+
+namespace {
+  bool is_letter(char c) {
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z');
+  }
+
+  bool is_digit(char c) {
+    return c >= '0' && c <= '9';
+  }
+
+  bool is_operator(char c) {
+    return c == '|' || c == '(' || c == ')' || c == '*' || c == '+' || c == '?';
+  }
+
+  // Characters a negated class can match: the visible ASCII characters, whitespace only separates lexemes
+  const int FIRST_VISIBLE = 33, LAST_VISIBLE = 126;
+}
+
+
+RegexParser::RegexParser(CharacterIds character_ids, Definitions definitions, Tags tags)
+    : character_ids(move(character_ids)), definitions(move(definitions)), tags(move(tags)), text(nullptr), pos(0) {}
+
+
+RegexAST RegexParser::parse(const string& regex) {
+  text = &regex;
+  pos = 0;
+  ast = RegexAST();
+  skip_spaces();
+  if (pos == regex.size()) fail("empty expression");
+  ast.set_root(parse_union());
+  if (pos != regex.size()) fail(at(')') ? "unbalanced ')'" : "unexpected character");
+  RegexAST result = move(ast);
+  ast = RegexAST();
+  return result;
+}
+
+
+void RegexParser::fail(const string& message) const {
+  throw runtime_error("Invalid regular expression \"" + *text + "\" at " + to_string(pos) + ": " + message + ".");
+}
+
+
+void RegexParser::skip_spaces() {
+  while (pos < text->size() && (*text)[pos] == ' ') ++pos;
+}
+
+
+bool RegexParser::at(char c) {
+  skip_spaces();
+  return pos < text->size() && (*text)[pos] == c;
+}
+
+
+bool RegexParser::starts_atom() {
+  skip_spaces();
+  return pos < text->size() && (*text)[pos] != '|' && (*text)[pos] != ')';
+}
+
+
+int RegexParser::parse_union() {
+  int node = parse_concat();
+  while (at('|')) {
+    ++pos;
+    node = ast.add_node(RegexNode::UNION, node, parse_concat());
+  }
+  return node;
+}
+
+
+int RegexParser::parse_concat() {
+  if (!starts_atom()) fail("missing operand");
+  int node = parse_postfix();
+  while (starts_atom()) node = ast.add_node(RegexNode::CONCAT, node, parse_postfix());
+  return node;
+}
+
+
+int RegexParser::parse_postfix() {
+  int node = parse_atom();
+  int min, max;
+  while (true) {
+    if (at('*')) node = ast.add_node(RegexNode::STAR, node);
+    else if (at('+')) node = ast.add_node(RegexNode::PLUS, node);
+    else if (at('?')) node = ast.add_node(RegexNode::OPTIONAL, node);
+    else if (at('{') && parse_count(min, max)) {
+      node = repeat(node, min, max);
+      continue;
+    }
+    else return node;
+    ++pos;
+  }
+}
+
+
+int RegexParser::parse_atom() {
+  skip_spaces();
+  const string& regex = *text;
+  char c = regex[pos];
+  if (c == '(') {
+    ++pos;
+    int inner = parse_union();
+    if (!at(')')) fail("missing ')'");
+    ++pos;
+    return inner;
+  }
+  if (c == '[') {
+    ++pos;
+    return parse_class();
+  }
+  if (is_operator(c)) fail(string("unexpected '") + c + "'");
+  if (c == '\\') {
+    if (pos + 1 >= regex.size()) fail("dangling '\\'");
+    char next = regex[pos + 1];
+    pos += 2;
+    if (next == 'L') return ast.add_epsilon();
+    return ast.add_symbol(character_ids(escaped(next), true));
+  }
+  if (c == '@' && tags && pos + 1 < regex.size() && is_letter(regex[pos + 1])) {
+    size_t end = pos + 1;
+    while (end < regex.size() && is_letter(regex[end])) ++end;
+    int tag = tags(regex.substr(pos + 1, end - pos - 1));
+    pos = end;
+    return ast.add_tag(tag);
+  }
+  if (is_letter(c) && pos + 1 < regex.size() && is_letter(regex[pos + 1])) {
+    size_t end = pos;
+    while (end < regex.size() && is_letter(regex[end])) ++end;
+    string name = regex.substr(pos, end - pos);
+    shared_ptr<const RegexAST> definition = definitions(name);
+    if (!definition) fail("undefined regular definition '" + name + "'");
+    pos = end;
+    return ast.add_reference(definition);
+  }
+  // A single character, or a range such as a-z or 0-9
+  ++pos;
+  if (pos + 1 < regex.size() && regex[pos] == '-') {
+    char last = regex[pos + 1];
+    if (last < c) fail("empty range");
+    pos += 2;
+    vector<bool> members(256, false);
+    for (int member = c; member <= last; ++member) members[static_cast<unsigned char>(member)] = true;
+    return symbols(members);
+  }
+  return ast.add_symbol(character_ids(c, false));
+}
+
+
+int RegexParser::parse_class() {
+  const string& regex = *text;
+  vector<bool> members(256, false);
+  bool negated = pos < regex.size() && regex[pos] == '^';
+  if (negated) ++pos;
+  while (true) {
+    if (pos >= regex.size()) fail("missing ']'");
+    char c = regex[pos];
+    if (c == ']') break;
+    if (c == ' ') {
+      ++pos;
+      continue;
+    }
+    if (c == '\\') {
+      if (pos + 1 >= regex.size()) fail("dangling '\\'");
+      c = escaped(regex[pos + 1]);
+      ++pos;
+    }
+    ++pos;
+    char last = c;
+    if (pos + 1 < regex.size() && regex[pos] == '-' && regex[pos + 1] != ']') {
+      last = regex[pos + 1];
+      if (last == '\\') {
+        if (pos + 2 >= regex.size()) fail("dangling '\\'");
+        last = escaped(regex[pos + 2]);
+        ++pos;
+      }
+      if (last < c) fail("empty range");
+      pos += 2;
+    }
+    for (int member = c; member <= last; ++member) members[static_cast<unsigned char>(member)] = true;
+  }
+  ++pos;
+  if (negated) {
+    vector<bool> complement(256, false);
+    for (int member = FIRST_VISIBLE; member <= LAST_VISIBLE; ++member) complement[member] = !members[member];
+    members = move(complement);
+  }
+  for (bool member : members) {
+    if (member) return symbols(members);
+  }
+  fail("empty character class");
+}
+
+
+bool RegexParser::parse_count(int& min, int& max) {
+  const string& regex = *text;
+  size_t start = pos, cursor = pos + 1;
+  auto number = [&](int& value) {
+    if (cursor >= regex.size() || !is_digit(regex[cursor])) return false;
+    value = 0;
+    while (cursor < regex.size() && is_digit(regex[cursor])) {
+      value = value * 10 + (regex[cursor++] - '0');
+      if (value > 100000) fail("repetition count too large");
+    }
+    return true;
+  };
+  // Anything that is not a well formed count leaves the '{' to be read as a character
+  if (!number(min)) return false;
+  max = min;
+  if (cursor < regex.size() && regex[cursor] == ',') {
+    ++cursor;
+    if (!number(max)) max = -1;
+  }
+  if (cursor >= regex.size() || regex[cursor] != '}') return false;
+  pos = cursor + 1;
+  if (max != -1 && max < min) {
+    pos = start;
+    fail("repetition maximum below its minimum");
+  }
+  return true;
+}
+
+
+int RegexParser::repeat(int node, int min, int max) {
+  if (max == 0) return ast.add_epsilon();
+  // The first use takes the parsed operand itself, every further use is a copy of it
+  bool used = false;
+  auto take = [&]() {
+    if (used) return ast.copy(node);
+    used = true;
+    return node;
+  };
+  int result = -1;
+  for (int i = 0; i < min; ++i) {
+    int item = take();
+    result = result == -1 ? item : ast.add_node(RegexNode::CONCAT, result, item);
+  }
+  // r{m,n} = r...r (r (r ...)?)?, the optional tail is nested so the automaton stays linear in n
+  int tail = -1;
+  if (max == -1) {
+    tail = ast.add_node(RegexNode::STAR, take());
+  } else {
+    vector<int> items;
+    for (int i = min; i < max; ++i) items.push_back(take());
+    for (size_t i = items.size(); i-- > 0;) {
+      tail = ast.add_node(RegexNode::OPTIONAL, tail == -1 ? items[i] : ast.add_node(RegexNode::CONCAT, items[i], tail));
+    }
+  }
+  if (result == -1) return tail;
+  return tail == -1 ? result : ast.add_node(RegexNode::CONCAT, result, tail);
+}
+
+
+int RegexParser::symbols(const vector<bool>& members) {
+  int node = -1;
+  for (int c = 0; c < 256; ++c) {
+    if (!members[c]) continue;
+    int symbol = ast.add_symbol(character_ids(static_cast<char>(c), false));
+    node = node == -1 ? symbol : ast.add_node(RegexNode::UNION, node, symbol);
+  }
+  return node;
+}
+
+
+char RegexParser::escaped(char c) const {
+  if (c == 'n') return '\n';
+  if (c == 't') return '\t';
+  if (c == 's') return ' ';
+  return c;
+}
@@ -0,0 +1,56 @@
+#ifndef REGEX_PARSER_H
+#define REGEX_PARSER_H
+#include <functional>
+#include <memory>
+#include <string>
+#include "RegexAST.h"
+
+/**
+ * Recursive descent parser from the right hand side of a lexical rule to its syntax tree, in one pass.
+ *
+ * Precedence from loosest to tightest: '|', concatenation, the postfix operators * + ? {m,n}.
+ * Atoms are parenthesized expressions, character classes [a-z] / [^...], ranges a-z, escapes (\L is
+ * epsilon, \n, \t and \s (space) are whitespace, anything else is taken literally), names of regular definitions
+ * (runs of two or more letters, kept as references to the shared definition tree) and single characters.
+ * Spaces only separate atoms. If the parser is given tags, @name (a letter after the @) marks a capture
+ * position that the scanner reports with the token; otherwise @ is an ordinary character.
+ */
+class RegexParser {
+  public:
+    /** Returns the id of a character, assigning a new one if needed. escaped is true for \c escapes */
+    using CharacterIds = std::function<char(char c, bool escaped)>;
+    /** Returns the syntax tree of a regular definition, or nullptr if there is no definition by that name */
+    using Definitions = std::function<std::shared_ptr<const RegexAST>(const std::string& name)>;
+    /** Returns the index of a tag, assigning a new one if needed */
+    using Tags = std::function<int(const std::string& name)>;
+
+    RegexParser(CharacterIds character_ids, Definitions definitions, Tags tags = nullptr);
+    /** Parses a rule. Throws runtime_error with the position of the problem on a malformed rule */
+    RegexAST parse(const std::string& regex);
+
+  private:
+    CharacterIds character_ids;
+    Definitions definitions;
+    Tags tags;
+    const std::string* text;
+    size_t pos;
+    RegexAST ast;
+
+    void skip_spaces();
+    bool at(char c);
+    bool starts_atom();
+    int parse_union();
+    int parse_concat();
+    int parse_postfix();
+    int parse_atom();
+    int parse_class();
+    /** Parses the {m}, {m,} or {m,n} after an atom, returning false (and consuming nothing) if there is none */
+    bool parse_count(int& min, int& max);
+    int repeat(int node, int min, int max);
+    /** Returns the union of the given characters, in ascending order */
+    int symbols(const std::vector<bool>& members);
+    char escaped(char c) const;
+    [[noreturn]] void fail(const std::string& message) const;
+};
+
+#endif
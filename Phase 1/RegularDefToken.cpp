@@ -54,3 +54,11 @@ void RegularDefToken :: set_resolved(bool resolved) {
 void RegularDefToken :: set_keywords(vector<char> keywords) {
   this->keywords = keywords;
 }
+
+const shared_ptr<const RegexAST>& RegularDefToken :: get_ast() const {
+  return ast;
+}
+
+void RegularDefToken :: set_ast(shared_ptr<const RegexAST> ast) {
+  this->ast = std::move(ast);
+}
@@ -1,7 +1,9 @@
 #ifndef RegularDefToken_H
 #define RegularDefToken_H
 #include <string>
+#include <memory>
 #include <vector>
+#include "RegexAST.h"
 
 
 class RegularDefToken {
@@ -12,6 +14,7 @@ class RegularDefToken {
     std::string regex;
     std::vector<char> keywords;
     std::vector<int> usedCharsIDs;
+    std::shared_ptr<const RegexAST> ast;
 
   public:
     /** Default constructor */
@@ -36,6 +39,10 @@ class RegularDefToken {
     void set_resolved(bool resolved);
     /** Set the keywords of the token. */
     void set_keywords(std::vector<char> keywords);
+    /** Returns the syntax tree of the token's regex, shared by every tree that refers to the definition. */
+    const std::shared_ptr<const RegexAST>& get_ast() const;
+    /** Set the syntax tree of the token's regex. */
+    void set_ast(std::shared_ptr<const RegexAST> ast);
 };
 
 #endif
\ No newline at end of file
@@ -55,4 +55,10 @@ void RegularExpToken :: set_keywords(vector<char> keywords) {
   this->keywords = keywords;
 }
 
+const RegexAST& RegularExpToken :: get_ast() const {
+  return ast;
+}
 
+void RegularExpToken :: set_ast(RegexAST ast) {
+  this->ast = std::move(ast);
+}
@@ -2,6 +2,7 @@
 #define RegularExpToken_H
 #include <string>
 #include <vector>
+#include "RegexAST.h"
 
 class RegularExpToken {
   private:
@@ -11,6 +12,7 @@ class RegularExpToken {
     std::string regex;
     std::vector<char> keywords;
     std::vector<int> usedCharsIDs;
+    RegexAST ast;
 
   public:
     /** Default constructor */
@@ -35,6 +37,10 @@ class RegularExpToken {
     void set_resolved(bool resolved);
     /** Set the keywords of the token. */
     void set_keywords(std::vector<char> keywords);
+    /** Returns the syntax tree of the token's regex. */
+    const RegexAST& get_ast() const;
+    /** Set the syntax tree of the token's regex. */
+    void set_ast(RegexAST ast);
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,135 @@
+#include "TaggedNFA.h"
+#include <algorithm>
+#include <stdexcept>
+using namespace std;
+
+const size_t TaggedNFA::UNSET;
+
+
+TaggedNFA::TaggedNFA(const RegexAST& ast, vector<string> tag_names) : tag_names(move(tag_names)) {
+  RegexAST expanded = ast.expanded();
+  int match = add_state({MATCH, 0, -1, -1, -1});
+  start_state = build(expanded, expanded.get_root(), match);
+}
+
+
+TaggedNFA::TaggedNFA(vector<State> states, int start_state, vector<string> tag_names)
+    : states(move(states)), start_state(start_state), tag_names(move(tag_names)) {
+  auto valid = [this](int state) { return state >= -1 && state < static_cast<int>(this->states.size()); };
+  if (start_state < 0 || start_state >= static_cast<int>(this->states.size())) throw runtime_error("Corrupt tagged NFA.");
+  for (const State& state : this->states) {
+    if (!valid(state.out1) || !valid(state.out2) || state.kind > MATCH ||
+        (state.kind == TAG && (state.tag < 0 || state.tag >= static_cast<int>(this->tag_names.size()))) ||
+        (state.kind != MATCH && state.out1 == -1)) {
+      throw runtime_error("Corrupt tagged NFA.");
+    }
+  }
+}
+
+
+int TaggedNFA::add_state(State state) {
+  states.push_back(state);
+  return static_cast<int>(states.size()) - 1;
+}
+
+
+int TaggedNFA::build(const RegexAST& ast, int node, int next) {
+  const RegexNode& current = ast.get_nodes()[node];
+  switch (current.kind) {
+    case RegexNode::SYMBOL:
+      return add_state({SYMBOL, current.symbol, -1, next, -1});
+    case RegexNode::EPSILON:
+      return current.token < 0 ? next : add_state({TAG, 0, current.token, next, -1});
+    case RegexNode::CONCAT:
+      return build(ast, current.left, build(ast, current.right, next));
+    case RegexNode::UNION: {
+      int left = build(ast, current.left, next);
+      int right = build(ast, current.right, next);
+      return add_state({SPLIT, 0, -1, left, right});
+    }
+    case RegexNode::OPTIONAL: {
+      int body = build(ast, current.left, next);
+      return add_state({SPLIT, 0, -1, body, next});
+    }
+    case RegexNode::STAR:
+    case RegexNode::PLUS: {
+      // Another round of the body comes before leaving the loop
+      int loop = add_state({SPLIT, 0, -1, -1, next});
+      int body = build(ast, current.left, loop);
+      states[loop].out1 = body;
+      return current.kind == RegexNode::STAR ? loop : body;
+    }
+    default:
+      // END markers are never part of a token's tree and references were expanded
+      throw runtime_error("Unexpected node in a tagged expression.");
+  }
+}
+
+
+void TaggedNFA::next_mark(Run& run) const {
+  if (run.marks.size() != states.size()) run.marks.assign(states.size(), 0);
+  if (++run.mark == 0) {
+    fill(run.marks.begin(), run.marks.end(), 0);
+    run.mark = 1;
+  }
+  run.match = -1;
+  run.next_threads.clear();
+  run.next_tags.clear();
+}
+
+
+void TaggedNFA::add_thread(Run& run, int state, vector<size_t>& tags) const {
+  if (run.marks[state] == run.mark) return;
+  run.marks[state] = run.mark;
+  const State& current = states[state];
+  switch (current.kind) {
+    case SPLIT:
+      add_thread(run, current.out1, tags);
+      if (current.out2 != -1) add_thread(run, current.out2, tags);
+      break;
+    case TAG: {
+      size_t saved = tags[current.tag];
+      tags[current.tag] = run.length;
+      add_thread(run, current.out1, tags);
+      tags[current.tag] = saved;
+      break;
+    }
+    default:
+      if (current.kind == MATCH && run.match == -1) run.match = static_cast<int>(run.next_threads.size());
+      run.next_threads.push_back(state);
+      run.next_tags.insert(run.next_tags.end(), tags.begin(), tags.end());
+  }
+}
+
+
+void TaggedNFA::start(Run& run) const {
+  run.length = 0;
+  next_mark(run);
+  run.current.assign(tag_names.size(), UNSET);
+  add_thread(run, start_state, run.current);
+  swap(run.threads, run.next_threads);
+  swap(run.tags, run.next_tags);
+}
+
+
+bool TaggedNFA::step(Run& run, char symbol) const {
+  ++run.length;
+  next_mark(run);
+  size_t tag_count = tag_names.size();
+  for (size_t i = 0; i < run.threads.size(); ++i) {
+    const State& current = states[run.threads[i]];
+    if (current.kind != SYMBOL || current.symbol != symbol) continue;
+    run.current.assign(run.tags.begin() + i * tag_count, run.tags.begin() + (i + 1) * tag_count);
+    add_thread(run, current.out1, run.current);
+  }
+  swap(run.threads, run.next_threads);
+  swap(run.tags, run.next_tags);
+  return !run.threads.empty();
+}
+
+
+void TaggedNFA::submatches(const Run& run, vector<size_t>& submatches) const {
+  if (run.match == -1) throw logic_error("The run is not at a match.");
+  size_t tag_count = tag_names.size();
+  submatches.assign(run.tags.begin() + run.match * tag_count, run.tags.begin() + (run.match + 1) * tag_count);
+}
@@ -0,0 +1,80 @@
+#ifndef TAGGED_NFA_H
+#define TAGGED_NFA_H
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "RegexAST.h"
+
+/**
+ * Tagged NFA (Laurikari) of a single token whose rule marks capture positions with @name. The scanner runs
+ * it alongside the lexer automaton, one character at a time, so the tags of the accepted lexeme are known
+ * when the token is emitted and the lexeme never has to be scanned again.
+ *
+ * The threads of a run are kept in priority order (left alternatives and repetitions first, as a
+ * backtracking matcher would try them), so among the paths matching a lexeme the tags come from the first.
+ */
+class TaggedNFA {
+  public:
+    /** Offset of a tag that the matching path did not cross */
+    static const size_t UNSET = SIZE_MAX;
+
+    enum Kind : uint8_t { SYMBOL, SPLIT, TAG, MATCH };
+    /**
+     * A SYMBOL state consumes its character id and moves to out1; a SPLIT moves to out1 and, with lower
+     * priority, to out2 (if not -1); a TAG records the current offset in its tag and moves to out1.
+     */
+    struct State {
+      Kind kind;
+      char symbol;
+      int tag;
+      int out1;
+      int out2;
+    };
+
+    /** A match in progress over one lexeme */
+    struct Run {
+      std::vector<int> threads;       // States waiting on a character (or at MATCH), in priority order
+      std::vector<size_t> tags;       // The tags of every thread, tag_count each
+      size_t length = 0;              // Characters consumed
+      int match = -1;                 // First thread at MATCH, -1 if the characters so far do not match
+      // Scratch space reused by every step
+      std::vector<int> next_threads;
+      std::vector<size_t> next_tags;
+      std::vector<size_t> current;
+      std::vector<unsigned> marks;
+      unsigned mark = 0;
+    };
+
+  private:
+    std::vector<State> states;
+    int start_state;
+    std::vector<std::string> tag_names;
+
+    int add_state(State state);
+    /** Adds the states of a subtree ahead of next and returns its start */
+    int build(const RegexAST& ast, int node, int next);
+    /** Follows the moves without input from state, queueing a thread wherever a character is awaited */
+    void add_thread(Run& run, int state, std::vector<size_t>& tags) const;
+    void next_mark(Run& run) const;
+
+  public:
+    /** Builds the NFA of a token's tree, whose tag leaves index tag_names */
+    TaggedNFA(const RegexAST& ast, std::vector<std::string> tag_names);
+    /** Restores an NFA from its states, as saved with the lexer cache */
+    TaggedNFA(std::vector<State> states, int start_state, std::vector<std::string> tag_names);
+
+    /** Starts a run at the beginning of a lexeme */
+    void start(Run& run) const;
+    /** Consumes one character id. Returns false once no path is left */
+    bool step(Run& run, char symbol) const;
+    bool matched(const Run& run) const { return run.match != -1; }
+    /** Copies the tag offsets (from the lexeme start) of the match the run is at into submatches */
+    void submatches(const Run& run, std::vector<size_t>& submatches) const;
+
+    const std::vector<State>& get_states() const { return states; }
+    int get_start() const { return start_state; }
+    const std::vector<std::string>& get_tag_names() const { return tag_names; }
+};
+
+#endif
@@ -0,0 +1,179 @@
+#include "TokenFile.h"
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+#include <unordered_map>
+using namespace std;
+
+static const char TOKEN_FILE_MAGIC[8] = {'T', 'O', 'K', 'S', 'T', 'R', 'M', '\0'};
+static const uint32_t TOKEN_FILE_VERSION = 1;
+static const size_t RECORD_SIZE = 16;
+static const size_t SECTION_ALIGNMENT = 8;
+
+const uint32_t TokenFile::VARINT;
+
+namespace {
+  uint32_t load_u32(const char* bytes) {
+    uint32_t value = 0;
+    for (int i = 0; i < 4; ++i) value |= static_cast<uint32_t>(static_cast<unsigned char>(bytes[i])) << (8 * i);
+    return value;
+  }
+
+  uint64_t load_u64(const char* bytes) {
+    return load_u32(bytes) | static_cast<uint64_t>(load_u32(bytes + 4)) << 32;
+  }
+}
+
+
+bool TokenFile::write(const string& path, const vector<Symbol>& symbols, bool varint) {
+  Writer writer(path, varint);
+  for (const Symbol& symbol : symbols) writer.add(symbol);
+  return writer.close();
+}
+
+
+TokenFile::Writer::Writer(const string& path, bool varint)
+    : path(path), spool_path(path + ".records"), varint(varint), records(spool_path) {}
+
+
+TokenFile::Writer::~Writer() {
+  if (!closed) {
+    records.close();
+    remove(spool_path.c_str());
+  }
+}
+
+
+void TokenFile::Writer::add(const Symbol& symbol) {
+  // Names and lexemes are numbered in order of first appearance
+  auto name = name_ids.emplace(symbol.token_name, static_cast<uint32_t>(names.size()));
+  if (name.second) names.push_back(&name.first->first);
+  auto lexeme = lexeme_ids.emplace(symbol.lexeme, static_cast<uint32_t>(lexemes.size()));
+  if (lexeme.second) lexemes.push_back(&lexeme.first->first);
+  if (varint) {
+    records.write_varint(name.first->second);
+    records.write_varint(lexeme.first->second);
+    records.write_varint(symbol.offset - previous);
+    previous = symbol.offset;
+  } else {
+    records.write_u32(name.first->second);
+    records.write_u32(lexeme.first->second);
+    records.write_u64(symbol.offset);
+  }
+  count++;
+}
+
+
+bool TokenFile::Writer::close() {
+  closed = true;
+  // The records are complete, their size goes in the header
+  bool spooled = records.ok();
+  uint64_t records_size = spooled ? records.tell() : 0;
+  records.close();
+  spooled = spooled && records.ok();
+  uint64_t strings_size = 0;
+  for (const string* lexeme : lexemes) strings_size += lexeme->size();
+  // Lexemes are located by u32 starts
+  if (strings_size > UINT32_MAX) {
+    remove(spool_path.c_str());
+    cerr << "Failed to write token file: " << path << " (its distinct lexemes pass 4 GiB)" << endl;
+    return false;
+  }
+
+  BinaryWriter writer(path);
+  writer.write_bytes(TOKEN_FILE_MAGIC, sizeof(TOKEN_FILE_MAGIC));
+  writer.write_u32(TOKEN_FILE_VERSION);
+  writer.write_u32(varint ? VARINT : 0);
+  writer.write_u64(count);
+  writer.write_u32(static_cast<uint32_t>(names.size()));
+  writer.write_u32(static_cast<uint32_t>(lexemes.size()));
+  writer.write_u64(records_size);
+  writer.write_u64(strings_size);
+  for (const string* name : names) writer.write_string(*name);
+  writer.align(SECTION_ALIGNMENT);
+  uint32_t start = 0;
+  for (const string* lexeme : lexemes) {
+    writer.write_u32(start);
+    writer.write_u32(static_cast<uint32_t>(lexeme->size()));
+    start += static_cast<uint32_t>(lexeme->size());
+  }
+  writer.align(SECTION_ALIGNMENT);
+  if (spooled) {
+    MappedFile spool(spool_path);
+    writer.write_bytes(spool.data(), spool.size());
+  }
+  remove(spool_path.c_str());
+  writer.align(SECTION_ALIGNMENT);
+  for (const string* lexeme : lexemes) writer.write_bytes(lexeme->data(), lexeme->size());
+  writer.close();
+  if (!spooled || !writer.ok()) {
+    cerr << "Failed to write token file: " << path << endl;
+    return false;
+  }
+  return true;
+}
+
+
+TokenFile::TokenFile(const string& path) : file(path) {
+  BinaryReader reader(file.data(), file.size());
+  if (memcmp(reader.read_bytes(sizeof(TOKEN_FILE_MAGIC)), TOKEN_FILE_MAGIC, sizeof(TOKEN_FILE_MAGIC)) != 0 ||
+      reader.read_u32() != TOKEN_FILE_VERSION) {
+    throw runtime_error("Not a token file: " + path);
+  }
+  flags = reader.read_u32();
+  count = reader.read_u64();
+  uint32_t name_count = reader.read_u32();
+  lexeme_count = reader.read_u32();
+  records_size = reader.read_u64();
+  strings_size = reader.read_u64();
+  for (uint32_t i = 0; i < name_count; ++i) token_names.push_back(reader.read_string());
+  reader.align(SECTION_ALIGNMENT);
+  lexemes = reader.read_bytes(static_cast<size_t>(lexeme_count) * 8);
+  reader.align(SECTION_ALIGNMENT);
+  records = reader.read_bytes(records_size);
+  reader.align(SECTION_ALIGNMENT);
+  strings = reader.read_bytes(strings_size);
+  // Compared by division, a crafted count could overflow the product
+  if (random_access() && (count != records_size / RECORD_SIZE || records_size % RECORD_SIZE != 0))
+    throw runtime_error("Corrupt token file: " + path);
+}
+
+
+TokenFile::Token TokenFile::make_token(uint32_t name, uint32_t lexeme, uint64_t offset) const {
+  if (name >= token_names.size() || lexeme >= lexeme_count) throw runtime_error("Corrupt token file.");
+  const char* entry = lexemes + static_cast<size_t>(lexeme) * 8;
+  uint32_t start = load_u32(entry), length = load_u32(entry + 4);
+  if (static_cast<uint64_t>(start) + length > strings_size) throw runtime_error("Corrupt token file.");
+  return Token{name, offset, strings + start, length};
+}
+
+
+TokenFile::Token TokenFile::at(size_t index) const {
+  if (!random_access()) throw runtime_error("Varint token files can only be read in order.");
+  if (index >= count) throw out_of_range("Token index out of range.");
+  const char* record = records + index * RECORD_SIZE;
+  return make_token(load_u32(record), load_u32(record + 4), load_u64(record + 8));
+}
+
+
+void TokenFile::for_each(const function<void(const Token&)>& visit) const {
+  Cursor cursor(*this);
+  Token token;
+  while (cursor.next(token)) visit(token);
+}
+
+
+bool TokenFile::Cursor::next(Token& token) {
+  if (index == file.count) return false;
+  if (file.random_access()) {
+    token = file.at(static_cast<size_t>(index++));
+    return true;
+  }
+  uint64_t name = reader.read_varint(), lexeme = reader.read_varint();
+  offset += reader.read_varint();
+  if (name > UINT32_MAX || lexeme > UINT32_MAX) throw runtime_error("Corrupt token file.");
+  token = file.make_token(static_cast<uint32_t>(name), static_cast<uint32_t>(lexeme), offset);
+  ++index;
+  return true;
+}
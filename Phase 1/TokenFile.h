@@ -0,0 +1,114 @@
+#ifndef TOKEN_FILE_H
+#define TOKEN_FILE_H
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "BinaryFile.h"
+#include "LexicalAnalyzer.h"
+
+/**
+ * Binary token stream, read in place from a memory map. Layout (little-endian, sections 8-byte aligned):
+ *
+ *   header     magic "TOKSTRM\0", u32 version, u32 flags, u64 token count, u32 name count, u32 lexeme count,
+ *              u64 record section size, u64 string section size
+ *   names      token names, each a u32 length and the bytes
+ *   lexemes    u32 start, u32 length in the string section for every distinct lexeme
+ *   records    per token: u32 name index, u32 lexeme index, u64 input offset (16 bytes); or, with the VARINT
+ *              flag, the name index, the lexeme index and the offset's distance from the previous token's
+ *              offset as LEB128 varints
+ *   strings    the distinct lexemes back to back
+ *
+ * Fixed records can be looked up by index; varint records are smaller but only read in order.
+ */
+class TokenFile {
+  public:
+    static const uint32_t VARINT = 1;
+
+    /** One token, its lexeme pointing into the mapped file */
+    struct Token {
+      uint32_t name;        // Index into names()
+      uint64_t offset;      // Position of the lexeme in the scanned input
+      const char* lexeme;
+      uint32_t length;
+    };
+
+    class Cursor;
+    class Writer;
+
+  private:
+    MappedFile file;
+    uint32_t flags;
+    uint64_t count;
+    std::vector<std::string> token_names;
+    const char* lexemes;
+    uint32_t lexeme_count;
+    const char* records;
+    uint64_t records_size;
+    const char* strings;
+    uint64_t strings_size;
+
+    Token make_token(uint32_t name, uint32_t lexeme, uint64_t offset) const;
+
+  public:
+    /** Maps and checks a token file. Throws if it is not one */
+    explicit TokenFile(const std::string& path);
+    /** Writes symbols as a token file. Returns false if it could not be written */
+    static bool write(const std::string& path, const std::vector<Symbol>& symbols, bool varint = false);
+
+    size_t size() const { return static_cast<size_t>(count); }
+    const std::vector<std::string>& names() const { return token_names; }
+    bool random_access() const { return (flags & VARINT) == 0; }
+    /** Returns token index; only for files without the VARINT flag */
+    Token at(size_t index) const;
+    /** Calls visit for every token in order */
+    void for_each(const std::function<void(const Token&)>& visit) const;
+};
+
+
+/** Reads the tokens of a file in order, whether its records are fixed or varint */
+class TokenFile::Cursor {
+  private:
+    const TokenFile& file;
+    BinaryReader reader;
+    uint64_t index = 0;
+    uint64_t offset = 0;
+
+  public:
+    explicit Cursor(const TokenFile& file) : file(file), reader(file.records, file.records_size) {}
+    /** Reads the next token into token. Returns false after the last one */
+    bool next(Token& token);
+};
+
+
+
+/**
+ * Writes a token file one symbol at a time, e.g. while the lexer still scans. Only the distinct names and
+ * lexemes stay in memory; the records wait in a spool file next to the output until close() assembles it.
+ */
+class TokenFile::Writer {
+  private:
+    std::string path;
+    std::string spool_path;
+    bool varint;
+    BinaryWriter records;
+    std::unordered_map<std::string, uint32_t> name_ids, lexeme_ids;
+    std::vector<const std::string*> names, lexemes;
+    uint64_t count = 0;
+    uint64_t previous = 0;
+    bool closed = false;
+
+  public:
+    explicit Writer(const std::string& path, bool varint = false);
+    Writer(const Writer&) = delete;
+    Writer& operator=(const Writer&) = delete;
+    /** Removes the spool file if the token file was never assembled */
+    ~Writer();
+
+    void add(const Symbol& symbol);
+    /** Writes the token file and removes the spool file. Returns false if it could not be written */
+    bool close();
+};
+
+#endif
@@ -8,6 +8,18 @@ void custom_assert(bool condition, string message) {
   if (!condition) throw runtime_error(message);
 }
 
+/** Minimizes a copy of the unpruned dfa in parallel rounds and checks it gives the same DFA as the sequential minimizer */
+bool same_in_parallel(const DFA& dfa, const DFA& minimized) {
+  DFA copy = dfa;
+  DFA parallel = DFAMinimizer(copy, 4).minimize();
+  if (parallel.get_states() != minimized.get_states() || parallel.get_initial() != minimized.get_initial()) return false;
+  if (parallel.get_accepting() != minimized.get_accepting()) return false;
+  for (int state : minimized.get_states()) {
+    if (parallel.get_transitions_from(state) != minimized.get_transitions_from(state)) return false;
+  }
+  return true;
+}
+
 void dfa_minimizer_test_1() {
   cout << "\n\n------------------------- Test DFA Minimizer 1 -------------------------" << endl;
   DFA dfa1(
@@ -22,10 +34,12 @@ void dfa_minimizer_test_1() {
     0,
     {{3,1},{5,1}}
   );
+  DFA unminimized_dfa1 = dfa1;
   DFAMinimizer minimizer1(dfa1);
   DFA minimized_dfa1 = minimizer1.minimize();
   cout << "\n\nMinimization of DFA with 6 states (Expected minimal DFA has 2 states):\n";
   custom_assert(minimized_dfa1.get_states().size() == 2, "Test 1 failed.");
+  custom_assert(same_in_parallel(unminimized_dfa1, minimized_dfa1), "Test 1 failed in parallel.");
   minimized_dfa1.print_dfa();
 }
 
@@ -42,10 +56,12 @@ void dfa_minimizer_test_2() {
     0,
     {{1,1}}
   );
+  DFA unminimized_dfa2 = dfa2;
   DFAMinimizer minimizer2(dfa2);
   DFA minimized_dfa2 = minimizer2.minimize();
   cout << "\n\nMinimization of an irreducible DFA with 3 states (Expected minimal DFA has 3 states):\n";
   custom_assert(minimized_dfa2.get_states().size() == 3, "Test 2 failed.");
+  custom_assert(same_in_parallel(unminimized_dfa2, minimized_dfa2), "Test 2 failed in parallel.");
   minimized_dfa2.print_dfa();
 }
 
@@ -62,10 +78,12 @@ void dfa_minimizer_test_3() {
     0,
     {{2,2}}
   );
+  DFA unminimized_dfa3 = dfa3;
   DFAMinimizer minimizer3(dfa3);
   DFA minimized_dfa3 = minimizer3.minimize();
   cout << "\n\nMinimization of a DFA with 3 states (Expected minimal DFA has 2 states):\n";
   custom_assert(minimized_dfa3.get_states().size() == 2, "Test 3 failed.");
+  custom_assert(same_in_parallel(unminimized_dfa3, minimized_dfa3), "Test 3 failed in parallel.");
   minimized_dfa3.print_dfa();
 }
 
@@ -84,10 +102,12 @@ void dfa_minimizer_test_4() {
     0,
     {{1,1}}
   );
+  DFA unminimized_dfa4 = dfa4;
   DFAMinimizer minimizer4(dfa4);
   DFA minimized_dfa4 = minimizer4.minimize();
   cout << "DFA with unreachable states (Expected minimal DFA has 3 states):\n";
   custom_assert(minimized_dfa4.get_states().size() == 3, "Test 4 failed.");
+  custom_assert(same_in_parallel(unminimized_dfa4, minimized_dfa4), "Test 4 failed in parallel.");
   minimized_dfa4.print_dfa();
 }
 
@@ -105,10 +125,12 @@ void dfa_minimizer_test_5() {
     0,
     {{2,1},{3,2}}
   );
+  DFA unminimized_dfa5 = dfa5;
   DFAMinimizer minimizer5(dfa5);
   DFA minimized_dfa5 = minimizer5.minimize();
   cout << "Irreducible DFA with 2 accepting states of different tokens (Expected minimal DFA has 4 states):\n";
   custom_assert(minimized_dfa5.get_states().size() == 4, "Test 5 failed.");
+  custom_assert(same_in_parallel(unminimized_dfa5, minimized_dfa5), "Test 5 failed in parallel.");
   minimized_dfa5.print_dfa();
 }
 
@@ -126,10 +148,12 @@ void dfa_minimizer_test_6() {
     0,
     {{2,1},{3,1}}
   );
+  DFA unminimized_dfa6 = dfa6;
   DFAMinimizer minimizer6(dfa6);
   DFA minimized_dfa6 = minimizer6.minimize();
   cout << "Reduction of DFA with 2 accepting states of the same token (Expected minimal DFA has 2 states):\n";
   custom_assert(minimized_dfa6.get_states().size() == 2, "Test 6 failed.");
+  custom_assert(same_in_parallel(unminimized_dfa6, minimized_dfa6), "Test 6 failed in parallel.");
   minimized_dfa6.print_dfa();
 }
 
@@ -148,10 +172,12 @@ void dfa_minimizer_test_7() {
     0,
     {{4,1}}
   );
+  DFA unminimized_dfa7 = dfa7;
   DFAMinimizer minimizer7(dfa7);
   DFA minimized_dfa7 = minimizer7.minimize();
   cout << "Reduction of DFA with 5 states (Expected minimal DFA has 4 states):\n";
   custom_assert(minimized_dfa7.get_states().size() == 4, "Test 7 failed.");
+  custom_assert(same_in_parallel(unminimized_dfa7, minimized_dfa7), "Test 7 failed in parallel.");
   minimized_dfa7.print_dfa();
 }
 
@@ -174,10 +200,12 @@ void dfa_minimizer_test_8() {
     0,
     {{2,1}}
   );
+  DFA unminimized_dfa8 = dfa8;
   DFAMinimizer minimizer8(dfa8);
   DFA minimized_dfa8 = minimizer8.minimize();
   cout << "Reduction of DFA with 8 states (Expected minimal DFA has 5 states):\n";
   custom_assert(minimized_dfa8.get_states().size() == 5, "Test 8 failed.");
+  custom_assert(same_in_parallel(unminimized_dfa8, minimized_dfa8), "Test 8 failed in parallel.");
   minimized_dfa8.print_dfa();
 }
 
@@ -198,10 +226,12 @@ void dfa_minimizer_test_9() {
     0,
     {{2,1}, {3,1}, {4,1}}
   );
+  DFA unminimized_dfa9 = dfa9;
   DFAMinimizer minimizer9(dfa9);
   DFA minimized_dfa9 = minimizer9.minimize();
   cout << "Reduction of DFA with 6 states including 3 accepting states (Expected minimal DFA has 3 states):\n";
   custom_assert(minimized_dfa9.get_states().size() == 3, "Test 9 failed.");
+  custom_assert(same_in_parallel(unminimized_dfa9, minimized_dfa9), "Test 9 failed in parallel.");
   minimized_dfa9.print_dfa();
 }
 
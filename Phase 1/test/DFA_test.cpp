@@ -27,7 +27,34 @@ void test_dfa_1() {
   dfa.print_dfa();
 }
 
+/** DFA over {a, b} accepting the single character c with token id token, state 0 dead */
+DFA single_character(char c, int token) {
+  DFA dfa({'a', 'b'});
+  for (int state = 0; state < 3; state++) dfa.add_state(state);
+  dfa.make_initial(1);
+  dfa.make_accepting(2, token);
+  for (char symbol : {'a', 'b'}) {
+    dfa.add_transition(0, symbol, 0);
+    dfa.add_transition(1, symbol, symbol == c ? 2 : 0);
+    dfa.add_transition(2, symbol, 0);
+  }
+  return dfa;
+}
+
+void test_dfa_2() {
+  // Start conditions side by side, sharing one dead state
+  DFA dfa = DFA::combine({single_character('a', 1), single_character('b', 2)});
+  custom_assert(dfa.get_mode_count() == 2, "Test 2 failed: wrong number of modes.");
+  custom_assert(dfa.get_initial() == dfa.get_initial(0), "Test 2 failed: mode 0 does not start at the initial state.");
+  custom_assert(dfa.get_states().size() == 5, "Test 2 failed: dead states not merged.");
+  custom_assert(dfa.accept(dfa.transition(dfa.get_initial(0), 'a')) == 1, "Test 2 failed: mode 0 rejects a.");
+  custom_assert(dfa.accept(dfa.transition(dfa.get_initial(0), 'b')) == -1, "Test 2 failed: mode 0 accepts b.");
+  custom_assert(dfa.accept(dfa.transition(dfa.get_initial(1), 'b')) == 2, "Test 2 failed: mode 1 rejects b.");
+  custom_assert(dfa.transition(dfa.get_initial(1), 'a') == dfa.get_dead_state(), "Test 2 failed: mode 1 accepts a.");
+}
+
 int main() {
   test_dfa_1();
+  test_dfa_2();
   cout << "DFA tests passed!" << endl;
 }
\ No newline at end of file
@@ -0,0 +1,77 @@
+#include <iostream>
+#include "RegexAST.h"
+#include "DerivativeAutomaton.h"
+#include <bits/stdc++.h>
+
+using namespace std;
+
+void custom_assert(bool condition, string message) {
+    if (!condition) throw runtime_error(message);
+}
+
+// Character ids as RegexAnalyzer assigns them
+const char A = -128, B = -127, C = -126;
+
+/** Runs the automaton over a string of character ids and returns the token of the state it ends in */
+int run(LexerAutomaton& automaton, const vector<char>& input) {
+    int state = automaton.initial();
+    for (char c : input) {
+        state = automaton.step(state, c);
+        if (automaton.is_dead(state)) return -1;
+    }
+    return automaton.accept(state);
+}
+
+
+// Lecture example (a|b)*abb
+void test_1() {
+    vector<pair<int, RegexAST>> tokens;
+    tokens.emplace_back(1, RegexAST::from_keywords({'(', A, '|', B, ')', '*', A, B, B}));
+    DerivativeAutomaton automaton(tokens, 1000);
+
+    custom_assert(run(automaton, {A, B, B}) == 1, "Test 1 failed: abb rejected.");
+    custom_assert(run(automaton, {B, A, A, B, B}) == 1, "Test 1 failed: baabb rejected.");
+    custom_assert(run(automaton, {A, B}) == -1, "Test 1 failed: ab accepted.");
+    custom_assert(run(automaton, {A, B, B, A}) == -1, "Test 1 failed: abba accepted.");
+    custom_assert(automaton.is_dead(automaton.step(automaton.initial(), C)), "Test 1 failed: c is not dead.");
+    cout << "Test 1 passed." << endl;
+}
+
+
+// A keyword (negative id) wins over an identifier matching the same lexeme
+void test_2() {
+    vector<pair<int, RegexAST>> tokens;
+    tokens.emplace_back(0, RegexAST::from_keywords({'(', A, '|', B, '|', C, ')', '+'}));
+    tokens.emplace_back(-10, RegexAST::from_keywords({A, B}));
+    DerivativeAutomaton automaton(tokens, 1000);
+
+    custom_assert(run(automaton, {A, B}) == -10, "Test 2 failed: keyword did not win.");
+    custom_assert(run(automaton, {A, B, C}) == 0, "Test 2 failed: identifier rejected.");
+    custom_assert(run(automaton, {}) == -1, "Test 2 failed: empty string accepted.");
+    cout << "Test 2 passed." << endl;
+}
+
+
+// A tiny cache is flushed over and over without changing what is accepted
+void test_3() {
+    vector<pair<int, RegexAST>> tokens;
+    tokens.emplace_back(2, RegexAST::from_keywords({A, '(', 'L', '|', B, ')', C, '?'}));
+    tokens.emplace_back(3, RegexAST::from_keywords({'(', A, B, '|', C, ')', '*', A, A}));
+    DerivativeAutomaton automaton(tokens, 4);
+
+    for (int round = 0; round < 3; ++round) {
+        custom_assert(run(automaton, {A}) == 2, "Test 3 failed: a rejected.");
+        custom_assert(run(automaton, {A, B, C}) == 2, "Test 3 failed: abc rejected.");
+        custom_assert(run(automaton, {A, C, C}) == -1, "Test 3 failed: acc accepted.");
+        custom_assert(run(automaton, {A, B, C, C, A, B, A, A}) == 3, "Test 3 failed: abccabaa rejected.");
+        custom_assert(run(automaton, {A, B, C, A}) == -1, "Test 3 failed: abca accepted.");
+    }
+    cout << "Test 3 passed." << endl;
+}
+
+int main(){
+    test_1();
+    test_2();
+    test_3();
+    return 0;
+}
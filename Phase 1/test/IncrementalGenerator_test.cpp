@@ -0,0 +1,68 @@
+#include <iostream>
+#include "IncrementalGenerator.h"
+#include <bits/stdc++.h>
+
+using namespace std;
+
+void custom_assert(bool condition, string message) {
+    if (!condition) throw runtime_error(message);
+}
+
+/** Runs the DFA over a string, mapping its characters to ids, and returns the token it ends in */
+int run(const DFA& dfa, const unordered_map<char, char>& ids, const string& input) {
+    int state = dfa.get_initial();
+    for (char c : input) state = dfa.transition(state, ids.at(c));
+    return dfa.accept(state);
+}
+
+/** Tokens (a|b)+ (id 0) and ab (id -10) over character ids given by ids */
+vector<pair<int, RegexAST>> tokens(const unordered_map<char, char>& ids) {
+    char a = ids.at('a'), b = ids.at('b');
+    vector<pair<int, RegexAST>> result;
+    result.emplace_back(0, RegexAST::from_keywords({'(', a, '|', b, ')', '+'}));
+    result.emplace_back(-10, RegexAST::from_keywords({a, b}));
+    return result;
+}
+
+vector<char> domain(const unordered_map<char, char>& ids) {
+    vector<char> result;
+    for (const auto& pair : ids) result.push_back(pair.second);
+    return result;
+}
+
+
+// The merged DFA prefers the token with the smaller id, like the other constructions
+void test_1() {
+    unordered_map<char, char> ids = {{'a', -128}, {'b', -127}, {'c', -126}};
+    remove("incremental_test_cache.bin");
+    IncrementalGenerator generator("incremental_test_cache.bin");
+    DFA dfa = generator.build(tokens(ids), ids, domain(ids));
+
+    custom_assert(run(dfa, ids, "ab") == -10, "Test 1 failed: keyword did not win.");
+    custom_assert(run(dfa, ids, "abba") == 0, "Test 1 failed: identifier rejected.");
+    custom_assert(run(dfa, ids, "") == -1, "Test 1 failed: empty string accepted.");
+    custom_assert(run(dfa, ids, "ac") == -1 && dfa.transition(dfa.get_initial(), ids['c']) == 0,
+                  "Test 1 failed: c does not lead to the dead state.");
+    custom_assert(generator.save(), "Test 1 failed: cache not written.");
+    cout << "Test 1 passed." << endl;
+}
+
+
+// Cached tokens are stored by character, so they still apply when the character ids change
+void test_2() {
+    unordered_map<char, char> ids = {{'c', -128}, {'b', -127}, {'a', -126}};
+    IncrementalGenerator generator("incremental_test_cache.bin");
+    DFA dfa = generator.build(tokens(ids), ids, domain(ids));
+
+    custom_assert(run(dfa, ids, "ab") == -10, "Test 2 failed: keyword did not win.");
+    custom_assert(run(dfa, ids, "bab") == 0, "Test 2 failed: identifier rejected.");
+    custom_assert(run(dfa, ids, "abc") == -1, "Test 2 failed: abc accepted.");
+    remove("incremental_test_cache.bin");
+    cout << "Test 2 passed." << endl;
+}
+
+int main(){
+    test_1();
+    test_2();
+    return 0;
+}
@@ -0,0 +1,89 @@
+#include <iostream>
+#include "InputBuffer.h"
+#include <bits/stdc++.h>
+
+using namespace std;
+
+void custom_assert(bool condition, string message) {
+    if (!condition) throw runtime_error(message);
+}
+
+/** Reads everything left in the buffer, releasing every character read */
+string read_all(InputBuffer& input) {
+    string result;
+    char c;
+    while (input.next(c)) {
+        result.push_back(c);
+        input.release(input.position());
+    }
+    return result;
+}
+
+
+// Input much longer than the buffer is read whole, NUL bytes included, when every character is released
+void test_1() {
+    string text;
+    for (int i = 0; i < 1000; i++) text.push_back(i % 7 == 0 ? '\0' : static_cast<char>('a' + i % 26));
+    istringstream stream(text);
+    InputBuffer input(stream, 16);
+    string result = read_all(input);
+    custom_assert(result == text, "Test 1 failed: input not read back unchanged.");
+    custom_assert(input.position() == text.size(), "Test 1 failed: wrong final position.");
+    cout << "Test 1 passed." << endl;
+}
+
+
+// A lexeme may cross from one half into the next, and be read again after seeking back
+void test_2() {
+    istringstream stream("abcdefghijklmnopqrstuvwxyz");
+    InputBuffer input(stream, 8);
+    input.seek(0);
+    char c;
+    for (int i = 0; i < 6; i++) input.next(c);
+    input.release(6);
+    for (int i = 0; i < 6; i++) input.next(c);
+    custom_assert(input.text(6, 12) == "ghijkl", "Test 2 failed: lexeme across halves.");
+    input.seek(6);
+    custom_assert(input.next(c) && c == 'g', "Test 2 failed: seek back across halves.");
+    input.release(12);
+    input.seek(12);
+    custom_assert(read_all(input) == "mnopqrstuvwxyz", "Test 2 failed: rest of the input.");
+    cout << "Test 2 passed." << endl;
+}
+
+
+// Reading more than a whole half past the released position would overwrite the lexeme
+void test_3() {
+    istringstream stream(string(64, 'x'));
+    InputBuffer input(stream, 8);
+    bool thrown = false;
+    char c;
+    try {
+        while (input.next(c)) {}
+    } catch (const runtime_error&) {
+        thrown = true;
+    }
+    custom_assert(thrown, "Test 3 failed: overlong lexeme not reported.");
+    cout << "Test 3 passed." << endl;
+}
+
+
+// Input already in memory is scanned in place, with no limit on how far a lexeme reaches
+void test_4() {
+    string text = string(100, 'x') + '\0' + "yz";
+    InputBuffer input(text.data(), text.size());
+    char c;
+    while (input.next(c)) {}
+    custom_assert(input.text(0, text.size()) == text, "Test 4 failed: wrong text.");
+    input.seek(100);
+    custom_assert(read_all(input) == string(1, '\0') + "yz", "Test 4 failed: NUL byte not read.");
+    cout << "Test 4 passed." << endl;
+}
+
+int main(){
+    test_1();
+    test_2();
+    test_3();
+    test_4();
+    return 0;
+}
@@ -0,0 +1,41 @@
+#include <iostream>
+#include "KeywordTable.h"
+#include <bits/stdc++.h>
+
+using namespace std;
+
+void custom_assert(bool condition, string message) {
+    if (!condition) throw runtime_error(message);
+}
+
+
+// Every keyword of a large set finds its own token id and nothing else is a keyword
+void test_1() {
+    vector<pair<string, int>> keywords;
+    for (int i = 0; i < 300; ++i) keywords.emplace_back("kw" + to_string(i * 7919 % 1000), -10 - i);
+    KeywordTable table(keywords);
+    for (const auto& keyword : keywords) {
+        custom_assert(table.lookup(keyword.first) == keyword.second, "Test 1 failed: " + keyword.first + " not found.");
+    }
+    custom_assert(table.lookup("kw") == -1, "Test 1 failed: prefix found.");
+    custom_assert(table.lookup("kw00") == -1, "Test 1 failed: non keyword found.");
+    custom_assert(table.lookup("") == -1, "Test 1 failed: empty lexeme found.");
+    cout << "Test 1 passed." << endl;
+}
+
+
+// Duplicates keep the smaller id and an empty table misses everything
+void test_2() {
+    KeywordTable table({{"if", -10}, {"else", -11}, {"if", -12}});
+    custom_assert(table.lookup("if") == -12, "Test 2 failed: duplicate did not keep the smaller id.");
+    custom_assert(table.lookup("else") == -11, "Test 2 failed: else not found.");
+    KeywordTable empty;
+    custom_assert(empty.empty() && empty.lookup("if") == -1, "Test 2 failed: empty table found a keyword.");
+    cout << "Test 2 passed." << endl;
+}
+
+int main(){
+    test_1();
+    test_2();
+    return 0;
+}
@@ -0,0 +1,71 @@
+#include <iostream>
+#include "NFA.h"
+#include "LazyDFA.h"
+#include <bits/stdc++.h>
+
+using namespace std;
+
+void custom_assert(bool condition, string message) {
+    if (!condition) throw runtime_error(message);
+}
+
+const char A = -128, B = -127;
+
+/** Runs the automaton over a string of character ids and returns the token of the state it ends in */
+int run(LexerAutomaton& automaton, const vector<char>& input) {
+    int state = automaton.initial();
+    for (char c : input) {
+        state = automaton.step(state, c);
+        if (automaton.is_dead(state)) return -1;
+    }
+    return automaton.accept(state);
+}
+
+/** Tokens a b* (id 1) and a b (id -10) joined by epsilon moves from state 0 */
+NFA build_nfa() {
+    NFA nfa(
+        {0, 1, 2, 3, 4},
+        {
+            {0, {{'\0', {1, 3}}}},
+            {1, {{A, {2}}}},
+            {2, {{B, {2}}}},
+            {3, {{A, {4}}}},
+        },
+        0,
+        {{2, 1}}
+    );
+    nfa.add_state(5);
+    nfa.add_transition(4, B, 5);
+    nfa.make_accepting(5, -10);
+    return nfa;
+}
+
+
+// Every token is recognized and the smaller id wins a tie
+void test_1() {
+    LazyDFA automaton(build_nfa(), 100);
+    custom_assert(run(automaton, {A}) == 1, "Test 1 failed: a rejected.");
+    custom_assert(run(automaton, {A, B}) == -10, "Test 1 failed: keyword did not win.");
+    custom_assert(run(automaton, {A, B, B}) == 1, "Test 1 failed: abb rejected.");
+    custom_assert(run(automaton, {B}) == -1, "Test 1 failed: b accepted.");
+    custom_assert(run(automaton, {}) == -1, "Test 1 failed: empty string accepted.");
+    cout << "Test 1 passed." << endl;
+}
+
+
+// A table that can only hold a few states is flushed repeatedly without changing what is accepted
+void test_2() {
+    LazyDFA automaton(build_nfa(), 4);
+    for (int round = 0; round < 3; ++round) {
+        custom_assert(run(automaton, {A, B}) == -10, "Test 2 failed: keyword did not win.");
+        custom_assert(run(automaton, {A, B, B, B}) == 1, "Test 2 failed: abbb rejected.");
+        custom_assert(run(automaton, {A, A}) == -1, "Test 2 failed: aa accepted.");
+    }
+    cout << "Test 2 passed." << endl;
+}
+
+int main(){
+    test_1();
+    test_2();
+    return 0;
+}
@@ -0,0 +1,268 @@
+#include <iostream>
+#include "LexicalAnalyzer.h"
+#include "IncrementalGenerator.h"
+#include "Stats.h"
+#include <bits/stdc++.h>
+
+using namespace std;
+
+void custom_assert(bool condition, string message) {
+    if (!condition) throw runtime_error(message);
+}
+
+// Rules written by the tests and the files the analyzer leaves next to them
+const string RULES = "lexical_analyzer_test.txt";
+const vector<string> GENERATED = {"lexical_analyzer_test_Token_IDs.txt", "lexical_analyzer_test_DFA_cache.bin",
+                                  "lexical_analyzer_test_minimized_DFA.txt"};
+
+// Every input is one character longer than a token, so each scan keeps reading past the token it returns
+const string ADVERSARIAL = "x: a\ny: a+ b";
+const string PROGRAM = "letter = a-z | A-Z\ndigit = 0 - 9\nid: letter (letter|digit)*\n"
+                       "num: digit+ | digit+ . digit+\nrelop: \\=\\= | !\\= | > | >\\= | < | <\\=\n"
+                       "{ if while }\n[; \\( \\)]";
+
+// Comments run from # to # across whitespace, and are dropped like the words that are not keywords
+const string COMMENTED = PROGRAM + "\ncomment: \\# (letter|digit|\\s)* \\#\n%ignore comment";
+const string WORDS = "letter = a-z\nword: letter+\nnum: (0-9)+\n{ if while }\n%ignore word";
+// Block comments are scanned in their own mode, where digits start no token and whitespace is comment text
+const string BLOCK_COMMENTS = "letter = a-z\nid: letter+\nnum: (0-9)+\nopen: /\\*\n%begin open COMMENT\n"
+                              "<COMMENT> text: (letter|\\s)+\n<COMMENT> close: \\*/\n%begin close INITIAL\n"
+                              "%ignore open text close";
+const vector<LexerOptions::Construction> CONSTRUCTIONS = {
+    LexerOptions::SUBSET, LexerOptions::LAZY, LexerOptions::DERIVATIVE,
+};
+
+LexicalAnalyzer make_analyzer(const string& rules, LexerOptions options = LexerOptions()) {
+    ofstream(RULES) << rules;
+    return LexicalAnalyzer(RULES, GENERATED.back(), options);
+}
+
+void clean_up() {
+    remove(RULES.c_str());
+    for (const string& file : GENERATED) remove(file.c_str());
+    remove(IncrementalGenerator::path_for(RULES).c_str());
+}
+
+/** Token names and offsets of a scan, "name@offset" each */
+vector<string> scan(const LexicalAnalyzer& analyzer, const string& input) {
+    InputBuffer buffer(input.data(), input.size());
+    vector<string> result;
+    for (const Symbol& symbol : analyzer.analyze(buffer)) {
+        result.push_back(symbol.token_name + "@" + to_string(symbol.offset));
+    }
+    return result;
+}
+
+/** Tokens of a scan with their lexemes, "name@offset:lexeme" each */
+vector<string> scan_lexemes(const LexicalAnalyzer& analyzer, const string& input) {
+    InputBuffer buffer(input.data(), input.size());
+    vector<string> result;
+    for (const Symbol& symbol : analyzer.analyze(buffer)) {
+        result.push_back(symbol.token_name + "@" + to_string(symbol.offset) + ":" + symbol.lexeme);
+    }
+    return result;
+}
+
+vector<string> expected_xs(size_t count, size_t from = 0) {
+    vector<string> result;
+    for (size_t i = 0; i < count; i++) result.push_back("x@" + to_string(from + i));
+    return result;
+}
+
+
+// Maximal munch on a long run gives one-character tokens, and the run only counts once for every token
+void test_1() {
+    LexicalAnalyzer analyzer = make_analyzer(ADVERSARIAL);
+    const size_t length = 200000;
+    auto started = chrono::steady_clock::now();
+    custom_assert(scan(analyzer, string(length, 'a')) == expected_xs(length), "Test 1 failed: run of a.");
+    // Rescanning the run for every token would take minutes
+    custom_assert(chrono::steady_clock::now() - started < chrono::seconds(30), "Test 1 failed: scan not linear.");
+
+    vector<string> tokens = expected_xs(3);
+    tokens.push_back("y@4");
+    for (string& token : expected_xs(2, 9)) tokens.push_back(token);
+    custom_assert(scan(analyzer, "aaa aaab aa") == tokens, "Test 1 failed: y after a failed y.");
+    clean_up();
+    cout << "Test 1 passed." << endl;
+}
+
+
+// Lazy automata that flush their states mid-scan give the tokens of the full DFA
+void test_2() {
+    vector<pair<string, string>> cases = {
+        {ADVERSARIAL, string(5000, 'a') + " " + string(300, 'a') + "b aab" + string(700, 'a')},
+        {PROGRAM, "if (count1 >= 3.14) while (x != y) ; id9 <= 12 if2 whilee ( 7 . )"},
+    };
+    for (const auto& spec : cases) {
+        vector<string> expected = scan(make_analyzer(spec.first), spec.second);
+        for (LexerOptions::Construction construction : {LexerOptions::LAZY, LexerOptions::DERIVATIVE}) {
+            LexerOptions options;
+            options.construction = construction;
+            options.lazy_cache_states = 4;
+            custom_assert(scan(make_analyzer(spec.first, options), spec.second) == expected,
+                          "Test 2 failed: lazy tokens differ.");
+        }
+    }
+    // The lazy automata really did renumber their states while scanning
+    stats::write_json("lexical_analyzer_test_stats.json");
+    ifstream stats_file("lexical_analyzer_test_stats.json");
+    string stats_text((istreambuf_iterator<char>(stats_file)), istreambuf_iterator<char>());
+    remove("lexical_analyzer_test_stats.json");
+    custom_assert(stats_text.find("\"lexer.lazy_flushes\"") != string::npos, "Test 2 failed: no flush.");
+    clean_up();
+    cout << "Test 2 passed." << endl;
+}
+
+
+
+// Every run of bytes that cannot start a token is one error, ended by whitespace or a byte that can
+void test_3() {
+    LexicalAnalyzer analyzer = make_analyzer(PROGRAM);
+    string input = "if ##$ x1\x01\xff;  .# 12 ## #while";
+    vector<string> expected = {
+        "if@0:if", "ERROR@3:##$", "id@7:x1", "ERROR@9:\x01\xff", ";@11:;", "ERROR@14:.#", "num@17:12",
+        "ERROR@20:##", "ERROR@23:#", "while@24:while",
+    };
+    custom_assert(scan_lexemes(analyzer, input) == expected, "Test 3 failed: wrong error runs.");
+    clean_up();
+    cout << "Test 3 passed." << endl;
+}
+
+
+// A run longer than the error limit is split, the next error starting where the last one stopped
+void test_4() {
+    LexicalAnalyzer analyzer = make_analyzer(PROGRAM);
+    string input = "x " + string(5000, '#') + " y";
+    vector<string> expected = {
+        "id@0:x", "ERROR@2:" + string(4096, '#'), "ERROR@4098:" + string(904, '#'), "id@5003:y",
+    };
+    custom_assert(scan_lexemes(analyzer, input) == expected, "Test 4 failed: long run not split.");
+    clean_up();
+    cout << "Test 4 passed." << endl;
+}
+
+// An ignored comment spans whitespace and leaves no Symbol, so the parser never sees it
+void test_5() {
+    string input = "if # skip 12 while # x1 #  # 7 #a#";
+    vector<string> expected = {"if@0:if", "id@21:x1", "num@29:7"};
+    for (LexerOptions::Construction construction : CONSTRUCTIONS) {
+        LexerOptions options;
+        options.construction = construction;
+        custom_assert(scan_lexemes(make_analyzer(COMMENTED, options), input) == expected,
+                      "Test 5 failed: comment not ignored.");
+        clean_up();
+    }
+    cout << "Test 5 passed." << endl;
+}
+
+
+// A keyword that an ignored token also matches is still emitted, whether or not keywords are hashed
+void test_6() {
+    string input = "foo if bar while 12 iff whil";
+    vector<string> expected = {"if@4:if", "while@11:while", "num@17:12"};
+    for (LexerOptions::Construction construction : CONSTRUCTIONS) {
+        for (bool keyword_hash : {false, true}) {
+            LexerOptions options;
+            options.construction = construction;
+            options.keyword_hash = keyword_hash;
+            custom_assert(scan_lexemes(make_analyzer(WORDS, options), input) == expected,
+                          "Test 6 failed: keyword ignored.");
+            clean_up();
+        }
+    }
+    cout << "Test 6 passed." << endl;
+}
+
+
+// %ignore naming no token fails when the lexer is built
+void test_7() {
+    for (LexerOptions::Construction construction : CONSTRUCTIONS) {
+        LexerOptions options;
+        options.construction = construction;
+        string error;
+        try {
+            make_analyzer(PROGRAM + "\n%ignore comment", options);
+        } catch (const runtime_error& e) {
+            error = e.what();
+        }
+        custom_assert(error == "%ignore names no token: comment", "Test 7 failed: unknown token accepted.");
+        clean_up();
+    }
+    cout << "Test 7 passed." << endl;
+}
+
+// Tokens switch the mode, and each mode has its own initial state and bytes that start a token
+void test_8() {
+    string input = "ab /* cd 12 e*/ 34 */";
+    // In the comment "12" is one error, since digits start no token there; outside it is a number, and a
+    // stray "*/" is two errors, since "/" starts a comment
+    vector<string> expected = {"id@0:ab", "ERROR@9:12", "num@16:34", "ERROR@19:*", "ERROR@20:/"};
+    vector<LexerOptions> variants;
+    for (LexerOptions::Construction construction : CONSTRUCTIONS) {
+        LexerOptions options;
+        options.construction = construction;
+        variants.push_back(options);
+    }
+    variants.push_back(LexerOptions());
+    variants.back().incremental = true;
+    for (const LexerOptions& options : variants) {
+        custom_assert(scan_lexemes(make_analyzer(BLOCK_COMMENTS, options), input) == expected,
+                      "Test 8 failed: wrong tokens in modes.");
+        clean_up();
+    }
+    cout << "Test 8 passed." << endl;
+}
+
+
+// The initial state of every mode survives the lexer cache
+void test_9() {
+    string input = "ab /* cd 12 e*/ 34 */";
+    vector<string> expected = scan_lexemes(make_analyzer(BLOCK_COMMENTS), input);
+    // Only a lexer built from the rules writes its DFA file
+    remove(GENERATED.back().c_str());
+    LexicalAnalyzer cached = make_analyzer(BLOCK_COMMENTS);
+    custom_assert(!ifstream(GENERATED.back()).is_open(), "Test 9 failed: cache not used.");
+    custom_assert(scan_lexemes(cached, input) == expected, "Test 9 failed: modes lost in the cache.");
+    clean_up();
+    cout << "Test 9 passed." << endl;
+}
+
+
+// %begin naming no token, or a mode without rules, fails when the lexer is built
+void test_10() {
+    vector<pair<string, string>> cases = {
+        {BLOCK_COMMENTS + "\n%begin shut INITIAL", "%begin names no token: shut"},
+        {BLOCK_COMMENTS + "\n%begin open STRING", "%begin names a mode without rules: STRING"},
+    };
+    for (const auto& spec : cases) {
+        for (LexerOptions::Construction construction : CONSTRUCTIONS) {
+            LexerOptions options;
+            options.construction = construction;
+            string error;
+            try {
+                make_analyzer(spec.first, options);
+            } catch (const runtime_error& e) {
+                error = e.what();
+            }
+            custom_assert(error == spec.second, "Test 10 failed: bad %begin accepted.");
+            clean_up();
+        }
+    }
+    cout << "Test 10 passed." << endl;
+}
+
+int main(){
+    stats::enable();
+    test_1();
+    test_2();
+    test_3();
+    test_4();
+    test_5();
+    test_6();
+    test_7();
+    test_8();
+    test_9();
+    test_10();
+    return 0;
+}
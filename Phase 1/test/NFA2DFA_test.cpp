@@ -254,10 +254,40 @@ void test_4(){
 
 }
 
+
+// Any number of threads builds the same DFA, state numbers included
+void test_5() {
+    // (a|b)*a(a|b)(a|b)(a|b) needs every subset of the last four positions
+    NFA nfa;
+    for (int state = 0; state <= 5; state++) nfa.add_state(state);
+    nfa.make_initial(0);
+    nfa.make_accepting(5, 1);
+    nfa.add_transition(0, 'a', 0);
+    nfa.add_transition(0, 'b', 0);
+    nfa.add_transition(0, 'a', 1);
+    for (int state = 1; state < 4; state++) {
+        nfa.add_transition(state, 'a', state + 1);
+        nfa.add_transition(state, 'b', state + 1);
+    }
+    nfa.add_transition(4, '\0', 5);
+
+    DFA sequential = NFA2DFA().convert(nfa, {'a', 'b'});
+    DFA parallel = NFA2DFA(3).convert(nfa, {'a', 'b'});
+    custom_assert(sequential.get_states().size() == 17, "Test 5 failed: expected 16 states and the dead state.");
+    custom_assert(parallel.get_states() == sequential.get_states(), "Test 5 failed: different states.");
+    custom_assert(parallel.get_accepting() == sequential.get_accepting(), "Test 5 failed: different accepting states.");
+    for (int state : sequential.get_states()) {
+        custom_assert(parallel.get_transitions_from(state) == sequential.get_transitions_from(state),
+                      "Test 5 failed: different transitions from state " + to_string(state) + ".");
+    }
+    cout << "Test 5 passed." << endl;
+}
+
 int main(){
     test_1();
     test_2();
     test_3();
     test_4();
+    test_5();
     return 0;
 }
\ No newline at end of file
@@ -0,0 +1,95 @@
+#include <iostream>
+#include "RegexAST.h"
+#include "Regex2DFA.h"
+#include "DFAMinimizer.h"
+#include <bits/stdc++.h>
+
+using namespace std;
+
+void custom_assert(bool condition, string message) {
+    if (!condition) throw runtime_error(message);
+}
+
+// Character ids as RegexAnalyzer assigns them
+const char A = -128, B = -127, C = -126;
+
+/** Runs the DFA over a string of character ids and returns the token of the state it ends in */
+int run(const DFA& dfa, const vector<char>& input) {
+    int state = dfa.get_initial();
+    for (char c : input) state = dfa.transition(state, c);
+    return dfa.accept(state);
+}
+
+
+// "a b*" accepts a, ab, abb ... and nothing else
+void test_1() {
+    vector<pair<int, RegexAST>> tokens;
+    tokens.emplace_back(1, RegexAST::from_keywords({A, B, '*'}));
+    Regex2DFA converter;
+    DFA dfa = converter.convert(tokens, {A, B});
+
+    custom_assert(dfa.validate(), "Test 1 failed: DFA is not complete.");
+    custom_assert(run(dfa, {A}) == 1, "Test 1 failed: a rejected.");
+    custom_assert(run(dfa, {A, B, B}) == 1, "Test 1 failed: abb rejected.");
+    custom_assert(run(dfa, {}) == -1, "Test 1 failed: empty string accepted.");
+    custom_assert(run(dfa, {B}) == -1, "Test 1 failed: b accepted.");
+    custom_assert(run(dfa, {A, B, A}) == -1, "Test 1 failed: aba accepted.");
+    // Dead state, initial state and the state after a
+    custom_assert(dfa.get_states().size() == 3, "Test 1 failed: expected 3 states.");
+    cout << "Test 1 passed." << endl;
+}
+
+
+// Lecture example (a|b)*abb, every state has a live move so the minimal DFA has 4 states and no dead state
+void test_2() {
+    vector<pair<int, RegexAST>> tokens;
+    tokens.emplace_back(1, RegexAST::from_keywords({'(', A, '|', B, ')', '*', A, B, B}));
+    Regex2DFA converter;
+    DFA dfa = converter.convert(tokens, {A, B});
+
+    custom_assert(run(dfa, {A, B, B}) == 1, "Test 2 failed: abb rejected.");
+    custom_assert(run(dfa, {B, A, A, B, B}) == 1, "Test 2 failed: baabb rejected.");
+    custom_assert(run(dfa, {A, B}) == -1, "Test 2 failed: ab accepted.");
+    DFAMinimizer minimizer(dfa);
+    custom_assert(minimizer.minimize().get_states().size() == 4, "Test 2 failed: expected 4 minimized states.");
+    cout << "Test 2 passed." << endl;
+}
+
+
+// A keyword (negative id) wins over an identifier matching the same lexeme
+void test_3() {
+    vector<pair<int, RegexAST>> tokens;
+    tokens.emplace_back(0, RegexAST::from_keywords({'(', A, '|', B, '|', C, ')', '+'}));
+    tokens.emplace_back(-10, RegexAST::from_keywords({A, B}));
+    Regex2DFA converter;
+    DFA dfa = converter.convert(tokens, {A, B, C});
+
+    custom_assert(run(dfa, {A, B}) == -10, "Test 3 failed: keyword did not win.");
+    custom_assert(run(dfa, {A, B, C}) == 0, "Test 3 failed: identifier rejected.");
+    custom_assert(run(dfa, {A}) == 0, "Test 3 failed: identifier rejected.");
+    cout << "Test 3 passed." << endl;
+}
+
+
+// Epsilon and optional parts: a (\L | b) c?
+void test_4() {
+    vector<pair<int, RegexAST>> tokens;
+    tokens.emplace_back(2, RegexAST::from_keywords({A, '(', 'L', '|', B, ')', C, '?'}));
+    Regex2DFA converter;
+    DFA dfa = converter.convert(tokens, {A, B, C});
+
+    custom_assert(run(dfa, {A}) == 2, "Test 4 failed: a rejected.");
+    custom_assert(run(dfa, {A, B}) == 2, "Test 4 failed: ab rejected.");
+    custom_assert(run(dfa, {A, C}) == 2, "Test 4 failed: ac rejected.");
+    custom_assert(run(dfa, {A, B, C}) == 2, "Test 4 failed: abc rejected.");
+    custom_assert(run(dfa, {A, C, C}) == -1, "Test 4 failed: acc accepted.");
+    cout << "Test 4 passed." << endl;
+}
+
+int main(){
+    test_1();
+    test_2();
+    test_3();
+    test_4();
+    return 0;
+}
@@ -0,0 +1,129 @@
+#include <iostream>
+#include "RegexParser.h"
+#include "Regex2DFA.h"
+#include <bits/stdc++.h>
+
+using namespace std;
+
+void custom_assert(bool condition, string message) {
+    if (!condition) throw runtime_error(message);
+}
+
+// Character ids are handed out the way RegexAnalyzer does, starting at -128
+unordered_map<char, char> ids;
+unordered_map<string, shared_ptr<const RegexAST>> definitions;
+
+RegexParser make_parser() {
+    return RegexParser(
+        [](char c, bool) {
+            if (!ids.count(c)) ids[c] = static_cast<char>(-128 + static_cast<int>(ids.size()));
+            return ids[c];
+        },
+        [](const string& name) -> shared_ptr<const RegexAST> {
+            auto found = definitions.find(name);
+            return found == definitions.end() ? nullptr : found->second;
+        });
+}
+
+/** Returns true if the expression matches the whole string */
+bool matches(const string& regex, const string& input) {
+    RegexParser parser = make_parser();
+    vector<pair<int, RegexAST>> tokens;
+    tokens.emplace_back(0, parser.parse(regex));
+    vector<char> domain;
+    for (auto const& pair : ids) domain.push_back(pair.second);
+    DFA dfa = Regex2DFA().convert(tokens, domain);
+    int state = dfa.get_initial();
+    for (char c : input) {
+        if (!ids.count(c)) return false;
+        state = dfa.transition(state, ids[c]);
+    }
+    return dfa.accept(state) == 0;
+}
+
+bool rejected(const string& regex) {
+    try {
+        make_parser().parse(regex);
+    } catch (const runtime_error&) {
+        return true;
+    }
+    return false;
+}
+
+
+// Precedence: postfix binds tighter than concatenation, which binds tighter than union
+void test_1() {
+    custom_assert(matches("a b*|c", "abb"), "Test 1 failed: abb rejected.");
+    custom_assert(matches("a b*|c", "c"), "Test 1 failed: c rejected.");
+    custom_assert(!matches("a b*|c", "abc"), "Test 1 failed: abc accepted.");
+    custom_assert(matches("(a b)+c?", "ababc"), "Test 1 failed: ababc rejected.");
+    custom_assert(!matches("(a b)+c?", "c"), "Test 1 failed: c accepted.");
+    cout << "Test 1 passed." << endl;
+}
+
+
+// Counted repetition
+void test_2() {
+    custom_assert(matches("a{3}", "aaa") && !matches("a{3}", "aa") && !matches("a{3}", "aaaa"),
+                  "Test 2 failed: a{3}.");
+    custom_assert(matches("a{2,4}", "aa") && matches("a{2,4}", "aaaa") && !matches("a{2,4}", "aaaaa"),
+                  "Test 2 failed: a{2,4}.");
+    custom_assert(matches("(a b){2,}", "ababab") && !matches("(a b){2,}", "ab"), "Test 2 failed: (a b){2,}.");
+    custom_assert(matches("a{0,1}b", "b") && matches("a{0,1}b", "ab"), "Test 2 failed: a{0,1}b.");
+    custom_assert(rejected("a{3,2}"), "Test 2 failed: a{3,2} accepted.");
+    cout << "Test 2 passed." << endl;
+}
+
+
+// Character classes, negation and escapes
+void test_3() {
+    custom_assert(matches("[a-c_]+", "a_cb") && !matches("[a-c_]+", "ad"), "Test 3 failed: [a-c_]+.");
+    custom_assert(matches("[^0-9]", "x") && !matches("[^0-9]", "5"), "Test 3 failed: [^0-9].");
+    custom_assert(matches("\\+\\*", "+*"), "Test 3 failed: escaped operators.");
+    custom_assert(matches("a(\\L|b)", "a") && matches("a(\\L|b)", "ab"), "Test 3 failed: epsilon.");
+    custom_assert(rejected("[]") && rejected("(a") && rejected("a)") && rejected("a|"), "Test 3 failed: malformed rule accepted.");
+    cout << "Test 3 passed." << endl;
+}
+
+
+// Definition names are replaced by their trees, single letters and ranges are characters
+void test_4() {
+    definitions["digit"] = make_shared<const RegexAST>(make_parser().parse("0-9"));
+    custom_assert(matches("digit+ . digit+", "12.5"), "Test 4 failed: 12.5 rejected.");
+    custom_assert(matches("digit+(\\L|E digit+)", "1E5"), "Test 4 failed: 1E5 rejected.");
+    custom_assert(rejected("digits"), "Test 4 failed: undefined definition accepted.");
+    cout << "Test 4 passed." << endl;
+}
+
+
+// Literal expressions are recognized as fixed strings, through definitions too
+void test_5() {
+    definitions["eq"] = make_shared<const RegexAST>(make_parser().parse("= ="));
+    vector<char> symbols;
+    custom_assert(make_parser().parse("! eq").fixed_string(symbols), "Test 5 failed: != = not fixed.");
+    custom_assert(symbols == vector<char>({ids['!'], ids['='], ids['=']}), "Test 5 failed: wrong symbols.");
+    custom_assert(make_parser().parse("a\\L b").fixed_string(symbols) && symbols.size() == 2,
+                  "Test 5 failed: epsilon in a fixed string.");
+    custom_assert(!make_parser().parse("a b?").fixed_string(symbols), "Test 5 failed: ab? is fixed.");
+    custom_assert(!make_parser().parse("a|b").fixed_string(symbols), "Test 5 failed: a|b is fixed.");
+    custom_assert(!make_parser().parse("\\L").fixed_string(symbols), "Test 5 failed: empty string is fixed.");
+    cout << "Test 5 passed." << endl;
+}
+
+
+// \s is a space, so rules such as comments can span the whitespace that otherwise separates tokens
+void test_6() {
+    custom_assert(matches("/ / (a|\\s|\\t)*", "// a\ta"), "Test 6 failed: comment with whitespace rejected.");
+    custom_assert(!matches("/ / (a|\\s)*", "// a\ta"), "Test 6 failed: tab taken as a space.");
+    cout << "Test 6 passed." << endl;
+}
+
+int main(){
+    test_1();
+    test_2();
+    test_3();
+    test_4();
+    test_5();
+    test_6();
+    return 0;
+}
@@ -0,0 +1,86 @@
+#include <iostream>
+#include "RegexParser.h"
+#include "TaggedNFA.h"
+#include <bits/stdc++.h>
+
+using namespace std;
+
+void custom_assert(bool condition, string message) {
+    if (!condition) throw runtime_error(message);
+}
+
+// Characters stand for their own ids
+vector<string> tag_names;
+
+TaggedNFA make_nfa(const string& regex) {
+    tag_names.clear();
+    RegexParser parser(
+        [](char c, bool) { return c; },
+        [](const string&) -> shared_ptr<const RegexAST> { return nullptr; },
+        [](const string& name) {
+            auto found = find(tag_names.begin(), tag_names.end(), name);
+            if (found != tag_names.end()) return static_cast<int>(found - tag_names.begin());
+            tag_names.push_back(name);
+            return static_cast<int>(tag_names.size()) - 1;
+        });
+    RegexAST ast = parser.parse(regex);
+    return TaggedNFA(ast, tag_names);
+}
+
+/** Returns the tags of the whole input, or an empty vector if it does not match */
+vector<size_t> match(const TaggedNFA& nfa, const string& input) {
+    TaggedNFA::Run run;
+    nfa.start(run);
+    for (char c : input) {
+        if (!nfa.step(run, c)) return {};
+    }
+    vector<size_t> submatches;
+    if (nfa.matched(run)) nfa.submatches(run, submatches);
+    return submatches;
+}
+
+
+// Integer, fraction and exponent of a number split in one pass
+void test_1() {
+    TaggedNFA nfa = make_nfa("[0-9]+ @fraction (\\L | . [0-9]+) @exponent (\\L | E [0-9]+)");
+    custom_assert(nfa.get_tag_names().size() == 2, "Test 1 failed: wrong tags.");
+    custom_assert(match(nfa, "3.14E2") == vector<size_t>({1, 4}), "Test 1 failed: 3.14E2.");
+    custom_assert(match(nfa, "42") == vector<size_t>({2, 2}), "Test 1 failed: 42.");
+    custom_assert(match(nfa, "7E5") == vector<size_t>({1, 1}), "Test 1 failed: 7E5.");
+    custom_assert(match(nfa, "1.").empty(), "Test 1 failed: 1. matched.");
+    cout << "Test 1 passed." << endl;
+}
+
+
+// Repetitions are greedy, and a tag on a path not taken stays unset
+void test_2() {
+    TaggedNFA nfa = make_nfa("(a @last)* b | @other a* c");
+    custom_assert(match(nfa, "aaab") == vector<size_t>({3, TaggedNFA::UNSET}), "Test 2 failed: aaab.");
+    custom_assert(match(nfa, "aac") == vector<size_t>({TaggedNFA::UNSET, 0}), "Test 2 failed: aac.");
+    TaggedNFA split = make_nfa("a* @middle a*");
+    custom_assert(match(split, "aaaa") == vector<size_t>({4}), "Test 2 failed: first a* not greedy.");
+    cout << "Test 2 passed." << endl;
+}
+
+
+// An NFA restored from its states matches like the original
+void test_3() {
+    TaggedNFA nfa = make_nfa("[0-9]+ @fraction (\\L | . [0-9]+)");
+    TaggedNFA restored(nfa.get_states(), nfa.get_start(), nfa.get_tag_names());
+    custom_assert(match(restored, "12.5") == match(nfa, "12.5"), "Test 3 failed: restored NFA differs.");
+    bool thrown = false;
+    try {
+        TaggedNFA(nfa.get_states(), static_cast<int>(nfa.get_states().size()), nfa.get_tag_names());
+    } catch (const runtime_error&) {
+        thrown = true;
+    }
+    custom_assert(thrown, "Test 3 failed: bad start state accepted.");
+    cout << "Test 3 passed." << endl;
+}
+
+int main(){
+    test_1();
+    test_2();
+    test_3();
+    return 0;
+}
@@ -0,0 +1,117 @@
+#include <iostream>
+#include "TokenFile.h"
+#include <bits/stdc++.h>
+
+using namespace std;
+
+void custom_assert(bool condition, string message) {
+    if (!condition) throw runtime_error(message);
+}
+
+vector<Symbol> symbols() {
+    return {
+        {"int", "int", 0},
+        {"x", "id", 4},
+        {"=", "assign", 6},
+        {"x", "id", 8},
+        {"", "ERROR", 1ULL << 33},
+    };
+}
+
+/** Reads every token back as a symbol */
+vector<Symbol> read_back(const TokenFile& file) {
+    vector<Symbol> result;
+    file.for_each([&](const TokenFile::Token& token) {
+        result.push_back({string(token.lexeme, token.length), file.names()[token.name], token.offset});
+    });
+    return result;
+}
+
+bool same(const vector<Symbol>& a, const vector<Symbol>& b) {
+    if (a.size() != b.size()) return false;
+    for (size_t i = 0; i < a.size(); i++) {
+        if (a[i].lexeme != b[i].lexeme || a[i].token_name != b[i].token_name || a[i].offset != b[i].offset) return false;
+    }
+    return true;
+}
+
+
+// Fixed records read back in order and by index, with names and lexemes stored once
+void test_1() {
+    custom_assert(TokenFile::write("token_file_test.bin", symbols()), "Test 1 failed: file not written.");
+    TokenFile file("token_file_test.bin");
+    custom_assert(file.size() == 5 && file.random_access(), "Test 1 failed: wrong header.");
+    custom_assert(file.names().size() == 4, "Test 1 failed: names not interned.");
+    custom_assert(same(read_back(file), symbols()), "Test 1 failed: tokens differ.");
+    TokenFile::Token token = file.at(3);
+    custom_assert(string(token.lexeme, token.length) == "x" && token.offset == 8, "Test 1 failed: wrong token 3.");
+    custom_assert(token.lexeme == file.at(1).lexeme, "Test 1 failed: lexeme not interned.");
+    cout << "Test 1 passed." << endl;
+}
+
+
+// Varint records hold the same tokens in fewer bytes, but only in order
+void test_2() {
+    TokenFile::write("token_file_test_varint.bin", symbols(), true);
+    TokenFile file("token_file_test_varint.bin");
+    custom_assert(!file.random_access(), "Test 2 failed: varint flag missing.");
+    custom_assert(same(read_back(file), symbols()), "Test 2 failed: tokens differ.");
+    bool thrown = false;
+    try {
+        file.at(0);
+    } catch (const runtime_error&) {
+        thrown = true;
+    }
+    custom_assert(thrown, "Test 2 failed: random access allowed.");
+    remove("token_file_test.bin");
+    remove("token_file_test_varint.bin");
+    cout << "Test 2 passed." << endl;
+}
+
+
+// A cursor reads both kinds of records in order
+void test_3() {
+    for (bool varint : {false, true}) {
+        TokenFile::write("token_file_test.bin", symbols(), varint);
+        TokenFile file("token_file_test.bin");
+        TokenFile::Cursor cursor(file);
+        TokenFile::Token token;
+        vector<string> names;
+        while (cursor.next(token)) names.push_back(file.names()[token.name]);
+        custom_assert(names == vector<string>({"int", "id", "assign", "id", "ERROR"}), "Test 3 failed: wrong tokens.");
+        custom_assert(!cursor.next(token), "Test 3 failed: read past the end.");
+    }
+    remove("token_file_test.bin");
+    cout << "Test 3 passed." << endl;
+}
+
+
+// A token count whose record size overflows to the real one is rejected
+void test_4() {
+    TokenFile::write("token_file_test.bin", symbols());
+    string bytes;
+    {
+        ifstream in("token_file_test.bin", ios::binary);
+        bytes.assign(istreambuf_iterator<char>(in), istreambuf_iterator<char>());
+    }
+    uint64_t count = 5 + (1ULL << 60);      // count * 16 wraps around to 5 * 16
+    for (int i = 0; i < 8; i++) bytes[16 + i] = static_cast<char>((count >> (8 * i)) & 0xFF);
+    ofstream("token_file_test.bin", ios::binary) << bytes;
+    bool thrown = false;
+    try {
+        TokenFile file("token_file_test.bin");
+    } catch (const runtime_error&) {
+        thrown = true;
+    }
+    custom_assert(thrown, "Test 4 failed: overflowing count accepted.");
+    remove("token_file_test.bin");
+    cout << "Test 4 passed." << endl;
+}
+
+int main(){
+    test_1();
+    test_2();
+    test_3();
+    test_4();
+    return 0;
+}
@@ -0,0 +1,213 @@
+#include "CompiledGrammar.h"
+#include "ParsingTableGenerator.h"
+#include "BinaryFile.h"
+#include <algorithm>
+#include <cstring>
+#include <map>
+
+using namespace std;
+
+static const char GRAMMAR_CACHE_MAGIC[8] = {'L', 'L', '1', 'C', 'A', 'C', 'H', 'E'};
+static const uint32_t GRAMMAR_CACHE_VERSION = 1;
+
+const int CompiledGrammar::NO_ENTRY;
+const int CompiledGrammar::SYNCH_ENTRY;
+
+CompiledGrammar::CompiledGrammar(const Grammar &grammar, const SymbolSet &terminals, const SymbolSet &nonTerminals,
+                                 const string &startSym, const ParsingTable &parsingTable) {
+    // Number terminals first, then non-terminals, each in sorted order so the artifact is deterministic
+    vector<string> sortedTerminals(terminals.begin(), terminals.end());
+    vector<string> sortedNonTerminals(nonTerminals.begin(), nonTerminals.end());
+    sort(sortedTerminals.begin(), sortedTerminals.end());
+    sort(sortedNonTerminals.begin(), sortedNonTerminals.end());
+    for (const auto &terminal : sortedTerminals) intern(terminal);
+    terminalCount = static_cast<int>(symbols.size());
+    for (const auto &nonTerminal : sortedNonTerminals) intern(nonTerminal);
+    nonTerminalCount = static_cast<int>(symbols.size()) - terminalCount;
+    startSymbol = intern(startSym);
+
+    // Transformed grammar
+    vector<string> lhsOrder;
+    for (const auto &entry : grammar) lhsOrder.push_back(entry.first);
+    sort(lhsOrder.begin(), lhsOrder.end());
+    for (const auto &lhs : lhsOrder) {
+        for (const auto &rhs : grammar.at(lhs)) {
+            vector<int> ids;
+            for (const auto &symbol : rhs) ids.push_back(intern(symbol));
+            rules.emplace_back(intern(lhs), move(ids));
+        }
+    }
+
+    // Flatten the table, sharing identical right hand sides
+    map<vector<string>, int> productionIds;
+    table.assign(static_cast<size_t>(nonTerminalCount) * terminalCount, NO_ENTRY);
+    for (int nt = terminalCount; nt < terminalCount + nonTerminalCount; nt++) {
+        for (int t = 0; t < terminalCount; t++) {
+            vector<string> production = parsingTable.getProduction(symbols[nt], symbols[t]);
+            int &cell = table[(nt - terminalCount) * terminalCount + t];
+            if (production.empty()) continue;
+            if (production.size() == 1 && production[0] == ParsingTableGenerator::SYNCH) {
+                cell = SYNCH_ENTRY;
+                continue;
+            }
+            auto found = productionIds.find(production);
+            if (found == productionIds.end()) {
+                vector<int> ids;
+                for (const auto &symbol : production) ids.push_back(intern(symbol));
+                found = productionIds.emplace(production, static_cast<int>(productions.size())).first;
+                productions.push_back(move(ids));
+            }
+            cell = found->second;
+        }
+    }
+}
+
+int CompiledGrammar::intern(const string &symbol) {
+    auto found = symbolIds.find(symbol);
+    if (found != symbolIds.end()) return found->second;
+    int id = static_cast<int>(symbols.size());
+    symbols.push_back(symbol);
+    symbolIds[symbol] = id;
+    return id;
+}
+
+int CompiledGrammar::symbolId(const string &symbol) const {
+    auto found = symbolIds.find(symbol);
+    return found == symbolIds.end() ? -1 : found->second;
+}
+
+uint64_t CompiledGrammar::keyFor(const string &rules_file_path) {
+    uint64_t key = hash_file(rules_file_path);
+    return hash_bytes(reinterpret_cast<const char *>(&GRAMMAR_CACHE_VERSION), sizeof(GRAMMAR_CACHE_VERSION), key);
+}
+
+string CompiledGrammar::pathFor(const string &rules_file_path) {
+    return rules_file_path.substr(0, rules_file_path.find_last_of('.')) + "_LL1_cache.bin";
+}
+
+static void writeIds(BinaryWriter &writer, const vector<int> &ids) {
+    writer.write_u32(static_cast<uint32_t>(ids.size()));
+    for (int id : ids) writer.write_i32(id);
+}
+
+static vector<int> readIds(BinaryReader &reader, size_t symbolCount) {
+    vector<int> ids(reader.read_u32());
+    for (int &id : ids) {
+        id = reader.read_i32();
+        if (id < 0 || static_cast<size_t>(id) >= symbolCount) throw runtime_error("Symbol id out of range.");
+    }
+    return ids;
+}
+
+bool CompiledGrammar::save(const string &cache_path, uint64_t key) const {
+    BinaryWriter writer(cache_path);
+    writer.write_bytes(GRAMMAR_CACHE_MAGIC, sizeof(GRAMMAR_CACHE_MAGIC));
+    writer.write_u32(GRAMMAR_CACHE_VERSION);
+    writer.write_u64(key);
+
+    writer.write_u32(static_cast<uint32_t>(symbols.size()));
+    for (const auto &symbol : symbols) writer.write_string(symbol);
+    writer.write_i32(terminalCount);
+    writer.write_i32(nonTerminalCount);
+    writer.write_i32(startSymbol);
+
+    writer.write_u32(static_cast<uint32_t>(rules.size()));
+    for (const auto &rule : rules) {
+        writer.write_i32(rule.first);
+        writeIds(writer, rule.second);
+    }
+    writer.write_u32(static_cast<uint32_t>(productions.size()));
+    for (const auto &production : productions) writeIds(writer, production);
+
+    writer.align(4);
+    for (int cell : table) writer.write_i32(cell);
+    writer.close();
+    if (!writer.ok()) {
+        cerr << "Failed to write parser cache: " << cache_path << endl;
+        return false;
+    }
+    return true;
+}
+
+bool CompiledGrammar::load(const string &cache_path, uint64_t key, CompiledGrammar &compiled) {
+    try {
+        MappedFile file(cache_path);
+        BinaryReader reader(file.data(), file.size());
+        if (memcmp(reader.read_bytes(sizeof(GRAMMAR_CACHE_MAGIC)), GRAMMAR_CACHE_MAGIC, sizeof(GRAMMAR_CACHE_MAGIC)) != 0)
+            return false;
+        if (reader.read_u32() != GRAMMAR_CACHE_VERSION || reader.read_u64() != key) return false;
+
+        CompiledGrammar result;
+        uint32_t symbolCount = reader.read_u32();
+        for (uint32_t i = 0; i < symbolCount; i++) result.intern(reader.read_string());
+        result.terminalCount = reader.read_i32();
+        result.nonTerminalCount = reader.read_i32();
+        result.startSymbol = reader.read_i32();
+        if (result.terminalCount < 0 || result.nonTerminalCount < 0 ||
+            static_cast<size_t>(result.terminalCount + result.nonTerminalCount) > symbolCount ||
+            result.startSymbol < 0 || static_cast<uint32_t>(result.startSymbol) >= symbolCount)
+            return false;
+
+        uint32_t ruleCount = reader.read_u32();
+        for (uint32_t i = 0; i < ruleCount; i++) {
+            int lhs = reader.read_i32();
+            if (lhs < 0 || static_cast<uint32_t>(lhs) >= symbolCount) return false;
+            result.rules.emplace_back(lhs, readIds(reader, symbolCount));
+        }
+        uint32_t productionCount = reader.read_u32();
+        for (uint32_t i = 0; i < productionCount; i++) result.productions.push_back(readIds(reader, symbolCount));
+
+        reader.align(4);
+        result.table.resize(static_cast<size_t>(result.nonTerminalCount) * result.terminalCount);
+        for (int &cell : result.table) {
+            cell = reader.read_i32();
+            if (cell < SYNCH_ENTRY || cell >= static_cast<int>(productionCount)) return false;
+        }
+        if (!reader.at_end()) return false;
+        compiled = move(result);
+        return true;
+    } catch (const exception &) {
+        // Missing or corrupt cache, the caller regenerates it
+        return false;
+    }
+}
+
+ParsingTable CompiledGrammar::toParsingTable() const {
+    ParsingTable parsingTable;
+    for (int nt = terminalCount; nt < terminalCount + nonTerminalCount; nt++) {
+        for (int t = 0; t < terminalCount; t++) {
+            int cell = entry(nt, t);
+            if (cell == NO_ENTRY) continue;
+            if (cell == SYNCH_ENTRY) {
+                parsingTable.addProduction(symbols[nt], symbols[t], {ParsingTableGenerator::SYNCH});
+                continue;
+            }
+            vector<string> production;
+            for (int id : productions[cell]) production.push_back(symbols[id]);
+            parsingTable.addProduction(symbols[nt], symbols[t], production);
+        }
+    }
+    return parsingTable;
+}
+
+Grammar CompiledGrammar::getGrammar() const {
+    Grammar grammar;
+    for (const auto &rule : rules) {
+        vector<string> rhs;
+        for (int id : rule.second) rhs.push_back(symbols[id]);
+        grammar[symbols[rule.first]].push_back(move(rhs));
+    }
+    return grammar;
+}
+
+SymbolSet CompiledGrammar::getTerminals() const {
+    return SymbolSet(symbols.begin(), symbols.begin() + terminalCount);
+}
+
+SymbolSet CompiledGrammar::getNonTerminals() const {
+    return SymbolSet(symbols.begin() + terminalCount, symbols.begin() + terminalCount + nonTerminalCount);
+}
+
+string CompiledGrammar::getStartSym() const {
+    return symbols[startSymbol];
+}
@@ -0,0 +1,74 @@
+#ifndef DFA_CPP_COMPILEDGRAMMAR_H
+#define DFA_CPP_COMPILEDGRAMMAR_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include "ParsingDataStructs.h"
+#include "ParsingTable.h"
+
+/**
+ * Dense, numbered form of a transformed LL(1) grammar and its parsing table.
+ * Symbols are numbered terminals first (including EPSILON and END), then non-terminals, so a table cell
+ * is addressed by (nonTerminal - terminalCount) * terminalCount + terminal.
+ * This is also the on-disk format of the parser compile cache.
+ */
+class CompiledGrammar {
+private:
+    std::vector<std::string> symbols;
+    std::unordered_map<std::string, int> symbolIds;
+    int terminalCount = 0;
+    int nonTerminalCount = 0;
+    int startSymbol = -1;
+    // Transformed grammar as (lhs, rhs) pairs
+    std::vector<std::pair<int, std::vector<int>>> rules;
+    // Distinct right hand sides referenced by the table
+    std::vector<std::vector<int>> productions;
+    // nonTerminalCount x terminalCount matrix of production indices, NO_ENTRY or SYNCH_ENTRY
+    std::vector<int> table;
+
+    /** Returns the id of a symbol, numbering it if it was not seen before */
+    int intern(const std::string &symbol);
+
+public:
+    static const int NO_ENTRY = -1, SYNCH_ENTRY = -2;
+
+    CompiledGrammar() = default;
+    /** Numbers the grammar symbols and flattens the parsing table */
+    CompiledGrammar(const Grammar &grammar, const SymbolSet &terminals, const SymbolSet &nonTerminals,
+                    const std::string &startSym, const ParsingTable &parsingTable);
+
+    /** Returns the cache key for a rules file: a hash of its contents and of the format version */
+    static uint64_t keyFor(const std::string &rules_file_path);
+    /** Returns the default cache path for a rules file */
+    static std::string pathFor(const std::string &rules_file_path);
+    /** Loads the artifact at cache_path. Returns false if it is missing, stale or corrupt */
+    static bool load(const std::string &cache_path, uint64_t key, CompiledGrammar &compiled);
+    /** Writes the artifact to cache_path under key. Returns false if the file could not be written */
+    bool save(const std::string &cache_path, uint64_t key) const;
+
+    /** Rebuilds the string keyed parsing table */
+    ParsingTable toParsingTable() const;
+    /** Rebuilds the transformed grammar */
+    Grammar getGrammar() const;
+    /** Returns the terminals including EPSILON and END */
+    SymbolSet getTerminals() const;
+    SymbolSet getNonTerminals() const;
+    std::string getStartSym() const;
+
+    const std::vector<std::string> &getSymbols() const { return symbols; }
+    int getTerminalCount() const { return terminalCount; }
+    int getNonTerminalCount() const { return nonTerminalCount; }
+    int getStartSymbolId() const { return startSymbol; }
+    /** Returns the id of a symbol or -1 if it is not part of the grammar */
+    int symbolId(const std::string &symbol) const;
+    const std::vector<std::vector<int>> &getProductions() const { return productions; }
+    /** Returns the table cell for a non-terminal id and a terminal id */
+    int entry(int nonTerminal, int terminal) const {
+        return table[(nonTerminal - terminalCount) * terminalCount + terminal];
+    }
+};
+
+
+#endif //DFA_CPP_COMPILEDGRAMMAR_H
@@ -3,101 +3,234 @@
 //
 
 
+#include <algorithm>
+#include <cstdio>
 #include <iostream>
 #include <stack>
 #include <fstream>
 #include "Parser.h"
+#include "Stats.h"
+#include "OutputWriter.h"
+#include "BinaryFile.h"
 
 using namespace std;
 
-void Parser::parse(const vector<string>& input, const string &derivation_path) {
-    stack<string> parseStack;
-
-
+void Parser::parse(const vector<string>& input, const string &derivation_path) const {
     // validate the input contains the end token
     if(input[input.size() - 1] != END){
         cerr << "Error: input should end with $";
         return;
     }
-    string temp = "";
+    VectorTokenStream tokens(input);
+    parse(tokens, derivation_path);
+}
+
+namespace {
+    /** Writes one row of the derivation table, input being the joined input column */
+    void writeStep(OutputWriter &out, const ParseResult::DerivationStep &step, const char *input, size_t inputSize) {
+        out << "Stack: " << step.stack << "\n | Input: ";
+        out.write(input, inputSize);
+        if (!step.inputIndex.empty()) out << "\n | InputIndex: " << step.inputIndex;
+        out << "\n | Action: " << step.action << '\n';
+    }
+
+    /** Keeps everything a parse produces in a result */
+    class ResultCollector : public ParseListener {
+    private:
+        ParseResult &result;
+
+    public:
+        explicit ResultCollector(ParseResult &result) : result(result) {}
+        void token(const string &token) override { result.input.push_back(token); }
+        void step(ParseResult::DerivationStep &&step) override { result.derivationSteps.push_back(move(step)); }
+        void leftMostStep(string &&step) override { result.leftMostDerivation.push_back(move(step)); }
+        void message(string &&message) override { result.messages.push_back(move(message)); }
+    };
+
+    /**
+     * Writes the derivation reports while the parse runs. Every row of the table repeats the whole input, which
+     * is only known at the end, so the rows and the input wait in spool files next to the table until finish()
+     */
+    class ReportWriter : public ParseListener {
+    private:
+        string tablePath, leftMostPath, inputSpoolPath, stepSpoolPath;
+        bool quiet;
+        OutputWriter leftMost;
+        OutputWriter inputSpool;
+        BinaryWriter stepSpool;
+
+    public:
+        ReportWriter(const string &tablePath, const string &leftMostPath, bool quiet)
+                : tablePath(tablePath), leftMostPath(leftMostPath), inputSpoolPath(tablePath + ".input"),
+                  stepSpoolPath(tablePath + ".steps"), quiet(quiet), leftMost(leftMostPath, true),
+                  inputSpool(inputSpoolPath, true), stepSpool(stepSpoolPath) {
+            leftMost << "Derivation Steps:\n";
+        }
+
+        void token(const string &token) override { inputSpool << token << ' '; }
+        void step(ParseResult::DerivationStep &&step) override {
+            stepSpool.write_string(step.stack);
+            stepSpool.write_string(step.inputIndex);
+            stepSpool.write_string(step.action);
+        }
+        void leftMostStep(string &&step) override { leftMost << step << '\n'; }
+        void message(string &&message) override {
+            if (!quiet) cerr << message << endl;
+        }
+
+        /** Writes the table from the spool files and removes them */
+        void finish() {
+            if (!leftMost.is_open()) {
+                cerr << "Error: Could not open file " << leftMostPath << " for writing." << endl;
+            } else {
+                leftMost.close();
+                if (!quiet) cout << "Derivation Steps written to " << leftMostPath << endl;
+            }
+            bool spooled = inputSpool.close() && stepSpool.ok();
+            stepSpool.close();
+            OutputWriter table(tablePath, true);
+            if (!table.is_open() || !spooled) {
+                cerr << "Error: Could not open file " << tablePath << " for writing." << endl;
+            } else {
+                MappedFile input(inputSpoolPath), steps(stepSpoolPath);
+                BinaryReader reader(steps.data(), steps.size());
+                table << "Derivation Steps:\n";
+                ParseResult::DerivationStep step;
+                while (!reader.at_end()) {
+                    step.stack = reader.read_string();
+                    step.inputIndex = reader.read_string();
+                    step.action = reader.read_string();
+                    writeStep(table, step, input.data(), input.size());
+                }
+                table.close();
+                if (!quiet) cout << "Derivation Steps written to " << tablePath << endl;
+            }
+            remove(inputSpoolPath.c_str());
+            remove(stepSpoolPath.c_str());
+        }
+    };
+}
+
+ParseResult Parser::parse(TokenStream& tokens, const string &derivation_path, bool quiet) const {
+    string derivation_table_path = derivation_path.substr(0, derivation_path.find_last_of('.')) + "_table.txt";
+    string derivation_left_most_path = derivation_path.substr(0, derivation_path.find_last_of('.')) + "_left_most.txt";
+    ReportWriter reports(derivation_table_path, derivation_left_most_path, quiet);
+    ParseResult result = parse(tokens, reports);
+    reports.finish();
+    return result;
+}
+
+ParseResult Parser::parse(TokenStream& tokens) const {
+    ParseResult result;
+    ResultCollector collector(result);
+    ParseResult outcome = parse(tokens, collector);
+    result.accepted = outcome.accepted;
+    result.errorCount = outcome.errorCount;
+    return result;
+}
+
+ParseResult Parser::parse(TokenStream& tokens, ParseListener& listener) const {
+    stats::ScopedTimer timer("parser.parse");
+    size_t maxStackDepth = 0;
+    size_t steps = 0;
+    ParseResult result;
+    stack<string> parseStack;
+
+    ParseResult::DerivationStep temp;
     parseStack.push(END);
     parseStack.push(startSymbol);
 
+    // The current input token, unless the stream is exhausted. Only it is kept, the listener gets every token
+    string current;
+    bool hasCurrent = tokens.next(current);
+    if (hasCurrent) listener.token(current);
     size_t inputIndex = 0;
-    derivationSteps.clear();
-    leftMostDerivation.clear();
+    auto advance = [&]() {
+        inputIndex++;
+        hasCurrent = tokens.next(current);
+        if (hasCurrent) listener.token(current);
+    };
 
     string leftDerivation = startSymbol;
-    leftMostDerivation.push_back(leftDerivation);
+    listener.leftMostStep(string(leftDerivation));
 
     while (!parseStack.empty()) {
-        if (inputIndex < input.size()) {
-            temp += "Stack: " + joinStack(parseStack, " ") + "\n | Input: " + join(input, " ")
-                    + "\n | InputIndex: " + input[inputIndex] + " " + to_string(inputIndex)
-                    + "\n | Action: ";
-        }else{
-            temp += "Stack: " + joinStack(parseStack, " ") + "\n | Input: " + join(input, " ")
-                    + "\n | Action: ";
+        maxStackDepth = max(maxStackDepth, parseStack.size());
+        temp.stack = joinStack(parseStack, " ");
+        if (hasCurrent) {
+            temp.inputIndex = current + " " + to_string(inputIndex);
         }
         string top = parseStack.top();
         parseStack.pop();
         // case if the stack is empty and there remains inputs
-        if (top == END || inputIndex == input.size()) {
-            if(inputIndex == input.size() - 1 && top == input[inputIndex]){
-                cerr << "Input is accepted" << endl;
-                temp += "accept";
+        if (top == END || !hasCurrent) {
+            // The current token must also be the last one
+            bool lastToken = hasCurrent;
+            string token;
+            if (lastToken && tokens.next(token)) {
+                listener.token(token);
+                lastToken = false;
+            }
+            if(lastToken && top == current){
+                listener.message("Input is accepted");
+                result.accepted = true;
+                temp.action = "accept";
             }else{
                 // case if the stack is empty and there remains inputs
                 // case if the input is empty and stack not empty
-                cerr << "Error: input is not accepted" << endl;
-                temp += "reject";
+                listener.message("Error: input is not accepted");
+                temp.action = "reject";
             }
-            derivationSteps.push_back(temp);
-            temp = "";
+            listener.step(move(temp));
+            steps++;
+            temp = ParseResult::DerivationStep();
             break;
         }
 
         if (terminals.find(top) != terminals.end()) {
             // terminals
-            if (inputIndex < input.size() && input[inputIndex] == top) {
-                temp += "match " + top;
-                inputIndex++;
+            if (current == top) {
+                temp.action = "match " + top;
+                advance();
             } else {
                 // case if the terminal in the stack does not match the input token action remove from the stack
                 // Missing terminal handling
-                leftMostDerivation.push_back("Current derivation (after inserting " + top + "): \n" + leftDerivation);
-                cerr <<"Error: missing "+ top +", inserted to the input" << endl;
-                temp +="Error: missing "+ top +", inserted to the input" ;
+                listener.leftMostStep("Current derivation (after inserting " + top + "): \n" + leftDerivation);
+                temp.action = "Error: missing "+ top +", inserted to the input" ;
+                listener.message(string(temp.action));
+                result.errorCount++;
             }
         } else {
             // non-terminals
-            vector<string> production = parsingTable.getProduction(top, input[inputIndex]);
+            vector<string> production = parsingTable.getProduction(top, current);
             if (production.empty()) {
                 // case of error recovery action remove from the input token action discard the input token
-                cerr << "Error:(illegal "+ top +" ), discard " + input[inputIndex] + " )" << endl;
-                temp += "Error:(illegal "+ top +" ), discard " + input[inputIndex] + " )";
-                leftMostDerivation.push_back("Current derivation (after deleting " + input[inputIndex] + "): \n" + leftDerivation);
+                temp.action = "Error:(illegal "+ top +" ), discard " + current + " )";
+                listener.message(string(temp.action));
+                result.errorCount++;
+                listener.leftMostStep("Current derivation (after deleting " + current + "): \n" + leftDerivation);
                 parseStack.push(top);
-                inputIndex++;
+                advance();
             } else if(production.size() == 1 && production[0] == SYNCH){
                 // if production sync then error recovery action remove from stack
-                cerr << "Error: M["+ top +", "+ input[inputIndex] +"] = synch, "+ top +" has been popped" << endl;
-                temp += "Error, M["+ top +", "+ input[inputIndex] +"] = synch, "+ top +" has been popped";
+                listener.message("Error: M["+ top +", "+ current +"] = synch, "+ top +" has been popped");
+                result.errorCount++;
+                temp.action = "Error, M["+ top +", "+ current +"] = synch, "+ top +" has been popped";
 
                 // Update the current derivation for the leftmost derivation
                 size_t pos = leftDerivation.find(top);
                 if (pos != string::npos) {
                     leftDerivation.replace(pos, top.length() + 1, join(production, " ", true));
-                    leftMostDerivation.push_back("Current derivation: \n" + leftDerivation);
+                    listener.leftMostStep("Current derivation: \n" + leftDerivation);
                 }
             } else {
-                temp += top + " -> " + join(production, " ");
+                temp.action = top + " -> " + join(production, " ");
 
                 // Update the current derivation for the leftmost derivation
                 size_t pos = leftDerivation.find(top);
                 if (pos != string::npos) {
                     leftDerivation.replace(pos, top.length() + 1, join(production, " ", true));
-                    leftMostDerivation.push_back("Current derivation: \n" + leftDerivation);
+                    listener.leftMostStep("Current derivation: \n" + leftDerivation);
                 }
 
                 for (auto it = production.rbegin(); it != production.rend(); ++it) {
@@ -107,57 +240,77 @@ void Parser::parse(const vector<string>& input, const string &derivation_path) {
                 }
             }
         }
-        derivationSteps.push_back(temp);
-        temp = "";
+        listener.step(move(temp));
+        steps++;
+        temp = ParseResult::DerivationStep();
     }
-    string derivation_table_path = derivation_path.substr(0, derivation_path.find_last_of('.')) + "_table.txt";
-    string derivation_left_most_path = derivation_path.substr(0, derivation_path.find_last_of('.')) + "_left_most.txt";
-    printLeftDerivation(derivation_left_most_path);
-    printDerivation(derivation_table_path);
+    // Whatever the parser did not get to is still part of the input column
+    string token;
+    while (tokens.next(token)) listener.token(token);
+    stats::count("parser.steps", static_cast<long long>(steps));
+    stats::count("parser.errors", static_cast<long long>(result.errorCount));
+    stats::maximum("parser.max_stack_depth", static_cast<long long>(maxStackDepth));
+    return result;
+}
+
+string ParseResult::formatStep(const DerivationStep &step, const string &joinedInput) const {
+    string result = "Stack: " + step.stack + "\n | Input: " + joinedInput;
+    if (!step.inputIndex.empty()) result += "\n | InputIndex: " + step.inputIndex;
+    return result + "\n | Action: " + step.action;
 }
 
-void Parser::printDerivation(const string &derivation_path) const {
-    ofstream output_file(derivation_path);
+void ParseResult::printDerivation(const string &derivation_path, bool quiet) const {
+    OutputWriter output_file(derivation_path, true);
     if (!output_file.is_open()) {
         cerr << "Error: Could not open file "
              << derivation_path
              << " for writing." << endl;
         return;
     }
-    output_file << "Derivation Steps:" << endl;
+    string joinedInput;
+    for (const auto& token : input) joinedInput += token + " ";
+    output_file << "Derivation Steps:\n";
     for (const auto& step : derivationSteps) {
-        output_file << step << endl;
+        writeStep(output_file, step, joinedInput.data(), joinedInput.size());
     }
-    cout << "Derivation Steps written to " << derivation_path << endl;
+    if (!quiet) cout << "Derivation Steps written to " << derivation_path << endl;
     output_file.close();
 }
 
 
-void Parser::printLeftDerivation() const {
+void ParseResult::printLeftDerivation() const {
     for (const auto& step : leftMostDerivation) {
         cout << step << endl;
     }
 }
 
-void Parser::printDerivation() const {
+void ParseResult::printDerivation() const {
+    string joinedInput;
+    for (const auto& token : input) joinedInput += token + " ";
     for (const auto& step : derivationSteps) {
-        cout << step << endl;
+        cout << formatStep(step, joinedInput) << endl;
     }
 }
 
-void Parser::printLeftDerivation(const string &left_most_derivation_path) const {
-    ofstream output_file(left_most_derivation_path);
+void ParseResult::printLeftDerivation(const string &left_most_derivation_path, bool quiet) const {
+    OutputWriter output_file(left_most_derivation_path, true);
     if (!output_file.is_open()) {
         cerr << "Error: Could not open file "
              << left_most_derivation_path
              << " for writing." << endl;
         return;
     }
-    output_file << "Derivation Steps:" << endl;
+    output_file << "Derivation Steps:\n";
     for (const auto& step : leftMostDerivation) {
-        output_file << step << endl;
+        output_file << step << '\n';
     }
-    cout << "Derivation Steps written to " << left_most_derivation_path << endl;
+    if (!quiet) cout << "Derivation Steps written to " << left_most_derivation_path << endl;
     output_file.close();
 }
 
+
+void ParseResult::printMessages() const {
+    for (const auto& message : messages) {
+        cerr << message << endl;
+    }
+}
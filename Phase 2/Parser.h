@@ -10,13 +10,54 @@
 #include <stack>
 #include "ParsingTable.h"
 #include "ParsingTableGenerator.h"
+#include "TokenStream.h"
 
+/** Everything one parse produces. Parser itself is immutable, so each parse owns one of these */
+struct ParseResult {
+    /** One row of the derivation table. The input column is the same for every row, so it is joined when printing */
+    struct DerivationStep {
+        std::string stack;
+        std::string inputIndex; // Empty once the input is exhausted
+        std::string action;
+    };
+
+    std::vector<std::string> input;
+    std::vector<DerivationStep> derivationSteps;
+    std::vector<std::string> leftMostDerivation;
+    // Error and acceptance messages in the order they happened
+    std::vector<std::string> messages;
+    bool accepted = false;
+    size_t errorCount = 0;
+
+    /** Write the reports to a file, announcing it on stdout unless quiet */
+    void printLeftDerivation(const std::string &left_most_derivation_path, bool quiet = false) const;
+    void printDerivation(const std::string &derivation_path, bool quiet = false) const;
+    void printLeftDerivation() const;
+    void printDerivation() const;
+    /** Writes the messages to stderr */
+    void printMessages() const;
+
+private:
+    std::string formatStep(const DerivationStep &step, const std::string &joinedInput) const;
+};
+
+/** Receives what a parse produces, in order, while it runs */
+class ParseListener {
+public:
+    virtual ~ParseListener() = default;
+    /** Every token read from the stream, including the ones after the parse stopped */
+    virtual void token(const std::string &token) = 0;
+    virtual void step(ParseResult::DerivationStep &&step) = 0;
+    virtual void leftMostStep(std::string &&step) = 0;
+    /** Error and acceptance messages */
+    virtual void message(std::string &&message) = 0;
+};
+
+/** LL(1) table driven parser. It only holds the table, so one instance can be shared by any number of threads */
 class Parser {
 private:
     ParsingTable parsingTable;
     std::string startSymbol;
-    std::vector<std::string> derivationSteps;
-    std::vector<std::string> leftMostDerivation;
     std::unordered_set<std::string> synchronizationPoints = {";", "}", "$"};
     std::string EPSILON = "\0";
     std::string END = "$";
@@ -24,7 +65,7 @@ private:
     SymbolSet terminals;
     SymbolSet nonTerminals;
 
-    std::string join(const std::vector<std::string>& vec, const std::string& delimiter, const bool& isLeftDerivation = false) {
+    std::string join(const std::vector<std::string>& vec, const std::string& delimiter, const bool& isLeftDerivation = false) const {
         std::string result;
         if(isLeftDerivation){
             for (const auto & str : vec) {
@@ -43,7 +84,7 @@ private:
         }
         return result;
     }
-    std::string joinStack(const std::stack<std::string>& stack, const std::string& delimiter) {
+    std::string joinStack(const std::stack<std::string>& stack, const std::string& delimiter) const {
         std::stack<std::string> tempStack = stack; // Create a copy of the stack
         std::string result;
 
@@ -71,11 +112,18 @@ public:
         SYNCH = ParsingTableGenerator::SYNCH;
     }
 
-    void parse(const std::vector<std::string>& input, const std::string &derivation_path);
-    void printLeftDerivation(const std::string &left_most_derivation_path) const;
-    void printDerivation(const std::string &derivation_path) const;
-    void printLeftDerivation() const;
-    void printDerivation() const;
+    /** Parses a token list that ends with $ and writes the derivation reports */
+    void parse(const std::vector<std::string>& input, const std::string &derivation_path) const;
+    /**
+     * Parses tokens as they arrive and writes the derivation reports as it goes, so memory does not grow with
+     * the input. The stream should end with $. Unless quiet, messages go to stderr and the report paths to
+     * stdout. Only accepted and errorCount are set in the result.
+     */
+    ParseResult parse(TokenStream& tokens, const std::string &derivation_path, bool quiet = false) const;
+    /** Parses tokens as they arrive, keeping everything in the result. The stream should end with $ */
+    ParseResult parse(TokenStream& tokens) const;
+    /** Parses tokens as they arrive, handing everything to listener. Only accepted and errorCount are set in the result */
+    ParseResult parse(TokenStream& tokens, ParseListener& listener) const;
 };
 
 #endif //DFA_CPP_PARSER_H
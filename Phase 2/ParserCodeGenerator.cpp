@@ -0,0 +1,288 @@
+#include "ParserCodeGenerator.h"
+#include "ParsingTableGenerator.h"
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <set>
+#include <stdexcept>
+
+using namespace std;
+
+ParserCodeGenerator::ParserCodeGenerator(const CompiledGrammar &compiled) : compiled(compiled) {
+    const auto &symbols = compiled.getSymbols();
+    terminalIndex.assign(symbols.size(), -1);
+    nonTerminalIndex.assign(symbols.size(), -1);
+
+    // END is always token 0, EPSILON is not a token
+    int end = compiled.symbolId(ParsingTableGenerator::END);
+    if (end < 0 || end >= compiled.getTerminalCount())
+        throw runtime_error("Compiled grammar has no end marker.");
+    terminals.push_back(end);
+    for (int t = 0; t < compiled.getTerminalCount(); t++) {
+        if (t != end && symbols[t] != ParsingTableGenerator::EPSILON) terminals.push_back(t);
+    }
+    for (int nt = compiled.getTerminalCount(); nt < compiled.getTerminalCount() + compiled.getNonTerminalCount(); nt++)
+        nonTerminals.push_back(nt);
+    for (size_t i = 0; i < terminals.size(); i++) terminalIndex[terminals[i]] = static_cast<int>(i);
+    for (size_t i = 0; i < nonTerminals.size(); i++) nonTerminalIndex[nonTerminals[i]] = static_cast<int>(i);
+
+    // Enum names, made unique if two symbols sanitize to the same identifier
+    set<string> used;
+    for (int t : terminals) {
+        string name = "TOKEN_" + (t == end ? string("END") : identifierFor(symbols[t]));
+        string unique = name;
+        for (int n = 2; used.count(unique); n++) unique = name + "_" + to_string(n);
+        used.insert(unique);
+        tokenEnumNames.push_back(unique);
+    }
+}
+
+string ParserCodeGenerator::identifierFor(const string &symbol) {
+    static const map<char, string> names = {
+            {'(', "LPAREN"}, {')', "RPAREN"}, {'{', "LBRACE"}, {'}', "RBRACE"}, {'[', "LBRACKET"},
+            {']', "RBRACKET"}, {';', "SEMICOLON"}, {',', "COMMA"}, {'=', "EQUALS"}, {'+', "PLUS"},
+            {'-', "MINUS"}, {'*', "STAR"}, {'/', "SLASH"}, {'<', "LESS"}, {'>', "GREATER"}, {'!', "BANG"},
+            {'&', "AMP"}, {'|', "PIPE"}, {'.', "DOT"}, {':', "COLON"}, {'$', "DOLLAR"}, {'%', "PERCENT"}};
+    string identifier;
+    for (char c : symbol) {
+        if (isalnum(static_cast<unsigned char>(c)) || c == '_') {
+            identifier += c;
+            continue;
+        }
+        if (!identifier.empty() && identifier.back() != '_') identifier += '_';
+        auto found = names.find(c);
+        if (found != names.end()) {
+            identifier += found->second;
+        } else {
+            char hex[8];
+            snprintf(hex, sizeof(hex), "X%02X", static_cast<unsigned char>(c));
+            identifier += hex;
+        }
+        identifier += '_';
+    }
+    while (!identifier.empty() && identifier.back() == '_') identifier.pop_back();
+    if (identifier.empty() || isdigit(static_cast<unsigned char>(identifier[0]))) identifier = "S" + identifier;
+    return identifier;
+}
+
+string ParserCodeGenerator::literalFor(const string &symbol) {
+    string literal = "\"";
+    for (char c : symbol) {
+        if (c == '"' || c == '\\') {
+            literal += '\\';
+            literal += c;
+        } else if (isprint(static_cast<unsigned char>(c))) {
+            literal += c;
+        } else {
+            char octal[8];
+            snprintf(octal, sizeof(octal), "\\%03o", static_cast<unsigned char>(c));
+            literal += octal;
+        }
+    }
+    return literal + "\"";
+}
+
+void ParserCodeGenerator::writeTokensHeader(ostream &out, const string &name, const string &) const {
+    const auto &symbols = compiled.getSymbols();
+    out << "// Generated by Parse_Generator. Do not edit.\n"
+        << "#ifndef " << name << "_TOKENS_H\n#define " << name << "_TOKENS_H\n\n"
+        << "namespace " << name << " {\n\n"
+        << "/** Terminals of the grammar, shared by the scanner and the parser */\n"
+        << "enum Token {\n";
+    for (size_t i = 0; i < terminals.size(); i++)
+        out << "    " << tokenEnumNames[i] << " = " << i << ", // " << literalFor(symbols[terminals[i]]) << "\n";
+    out << "    TOKEN_COUNT = " << terminals.size() << "\n};\n\n"
+        << "/** Returns the grammar name of a token (the token name the lexical rules give it) */\n"
+        << "const char *token_name(int token);\n"
+        << "/** Returns the token with a grammar name, or -1 if the grammar has no such terminal */\n"
+        << "int token_from_name(const char *name);\n\n"
+        << "}\n\n#endif\n";
+}
+
+void ParserCodeGenerator::writeParserHeader(ostream &out, const string &name, const string &fileBase) const {
+    const auto &symbols = compiled.getSymbols();
+    out << "// Generated by Parse_Generator. Do not edit.\n"
+        << "#ifndef " << name << "_PARSER_H\n#define " << name << "_PARSER_H\n\n"
+        << "#include <cstddef>\n#include \"" << fileBase << "_tokens.h\"\n\n"
+        << "namespace " << name << " {\n\n"
+        << "enum NonTerminal {\n";
+    set<string> used;
+    for (size_t i = 0; i < nonTerminals.size(); i++) {
+        string enumName = "NT_" + identifierFor(symbols[nonTerminals[i]]);
+        string unique = enumName;
+        for (int n = 2; used.count(unique); n++) unique = enumName + "_" + to_string(n);
+        used.insert(unique);
+        out << "    " << unique << " = " << i << ", // " << literalFor(symbols[nonTerminals[i]]) << "\n";
+    }
+    out << "    NON_TERMINAL_COUNT = " << nonTerminals.size() << "\n};\n\n"
+        << "/** Called for every production applied, in leftmost derivation order */\n"
+        << "typedef void (*ProductionCallback)(int non_terminal, int production, void *user);\n"
+        << "/** Called for every syntax error with a description and the index of the current token */\n"
+        << "typedef void (*ErrorCallback)(const char *message, std::size_t position, void *user);\n\n"
+        << "struct ParseCallbacks {\n"
+        << "    ProductionCallback on_production;\n"
+        << "    ErrorCallback on_error;\n"
+        << "    void *user;\n"
+        << "};\n\n"
+        << "/** Parses tokens[0, count), which must end with TOKEN_END. Returns true if the input is accepted */\n"
+        << "bool parse(const int *tokens, std::size_t count, const ParseCallbacks *callbacks = nullptr);\n"
+        << "/** Returns the grammar name of a non-terminal */\n"
+        << "const char *non_terminal_name(int non_terminal);\n\n"
+        << "}\n\n#endif\n";
+}
+
+void ParserCodeGenerator::writeParserSource(ostream &out, const string &name, const string &fileBase) const {
+    const auto &symbols = compiled.getSymbols();
+    const auto &productions = compiled.getProductions();
+    const int tokenCount = static_cast<int>(terminals.size());
+
+    out << "// Generated by Parse_Generator. Do not edit.\n"
+        << "#include \"" << fileBase << "_parser.h\"\n"
+        << "#include <cstring>\n#include <string>\n#include <vector>\n\n"
+        << "namespace " << name << " {\n\n"
+        << "namespace {\n\n"
+        << "const int NO_ENTRY = -1, SYNCH_ENTRY = -2;\n\n";
+
+    // Names, sorted copy for token_from_name
+    out << "const char *const TOKEN_NAMES[TOKEN_COUNT] = {";
+    for (int t : terminals) out << "\n    " << literalFor(symbols[t]) << ",";
+    out << "\n};\n\n";
+    vector<pair<string, int>> sortedTokens;
+    for (size_t i = 0; i < terminals.size(); i++) sortedTokens.emplace_back(symbols[terminals[i]], static_cast<int>(i));
+    sort(sortedTokens.begin(), sortedTokens.end());
+    out << "struct NamedToken {\n    const char *name;\n    int token;\n};\n\n"
+        << "const NamedToken TOKENS_BY_NAME[TOKEN_COUNT] = {";
+    for (const auto &entry : sortedTokens) out << "\n    {" << literalFor(entry.first) << ", " << entry.second << "},";
+    out << "\n};\n\n";
+    out << "const char *const NON_TERMINAL_NAMES[NON_TERMINAL_COUNT > 0 ? NON_TERMINAL_COUNT : 1] = {";
+    for (int nt : nonTerminals) out << "\n    " << literalFor(symbols[nt]) << ",";
+    out << "\n};\n\n";
+
+    // Productions, flattened with their symbols in reverse order so the driver can push them directly.
+    // Stack symbols are tokens [0, TOKEN_COUNT) and non-terminals TOKEN_COUNT + n.
+    out << "const int PRODUCTION_OFFSETS[] = {";
+    size_t offset = 0;
+    vector<int> flattened;
+    for (const auto &production : productions) {
+        out << (flattened.size() % 16 == 0 ? "\n    " : " ") << offset << ",";
+        for (auto it = production.rbegin(); it != production.rend(); ++it) {
+            if (symbols[*it] == ParsingTableGenerator::EPSILON) continue;
+            if (terminalIndex[*it] >= 0) flattened.push_back(terminalIndex[*it]);
+            else if (nonTerminalIndex[*it] >= 0) flattened.push_back(tokenCount + nonTerminalIndex[*it]);
+            else throw runtime_error("Production uses a symbol that is neither a terminal nor a non-terminal: " + symbols[*it]);
+        }
+        offset = flattened.size();
+    }
+    out << "\n    " << offset << "\n};\n\n";
+    out << "const int PRODUCTION_SYMBOLS[] = {";
+    for (size_t i = 0; i < flattened.size(); i++) out << (i % 16 == 0 ? "\n    " : " ") << flattened[i] << ",";
+    out << "\n    -1 // sentinel\n};\n\n";
+
+    // Parsing table rows per non-terminal
+    const char *cellType = productions.size() < 32767 ? "short" : "int";
+    out << "const " << cellType << " TABLE[NON_TERMINAL_COUNT > 0 ? NON_TERMINAL_COUNT : 1][TOKEN_COUNT] = {";
+    for (int nt : nonTerminals) {
+        out << "\n    {";
+        for (int t = 0; t < tokenCount; t++) out << (t ? ", " : "") << compiled.entry(nt, terminals[t]);
+        out << "}, // " << literalFor(symbols[nt]);
+    }
+    out << "\n};\n\n";
+
+    out << "void report(const ParseCallbacks *callbacks, const std::string &message, std::size_t position) {\n"
+        << "    if (callbacks && callbacks->on_error) callbacks->on_error(message.c_str(), position, callbacks->user);\n"
+        << "}\n\n"
+        << "std::string symbol_name(int symbol) {\n"
+        << "    return symbol < TOKEN_COUNT ? TOKEN_NAMES[symbol] : NON_TERMINAL_NAMES[symbol - TOKEN_COUNT];\n"
+        << "}\n\n"
+        << "std::string token_text(int token) {\n"
+        << "    return token >= 0 && token < TOKEN_COUNT ? TOKEN_NAMES[token] : \"<unknown>\";\n"
+        << "}\n\n"
+        << "}\n\n";
+
+    out << "const char *token_name(int token) {\n"
+        << "    return token >= 0 && token < TOKEN_COUNT ? TOKEN_NAMES[token] : nullptr;\n"
+        << "}\n\n"
+        << "int token_from_name(const char *name) {\n"
+        << "    int low = 0, high = TOKEN_COUNT - 1;\n"
+        << "    while (low <= high) {\n"
+        << "        int mid = (low + high) / 2;\n"
+        << "        int cmp = std::strcmp(TOKENS_BY_NAME[mid].name, name);\n"
+        << "        if (cmp == 0) return TOKENS_BY_NAME[mid].token;\n"
+        << "        if (cmp < 0) low = mid + 1; else high = mid - 1;\n"
+        << "    }\n"
+        << "    return -1;\n"
+        << "}\n\n"
+        << "const char *non_terminal_name(int non_terminal) {\n"
+        << "    return non_terminal >= 0 && non_terminal < NON_TERMINAL_COUNT ? NON_TERMINAL_NAMES[non_terminal] : nullptr;\n"
+        << "}\n\n";
+
+    int start = nonTerminalIndex[compiled.getStartSymbolId()];
+    if (start < 0) throw runtime_error("Start symbol is not a non-terminal.");
+    out << "bool parse(const int *tokens, std::size_t count, const ParseCallbacks *callbacks) {\n"
+        << "    if (count == 0 || tokens[count - 1] != TOKEN_END) {\n"
+        << "        report(callbacks, \"input should end with $\", 0);\n"
+        << "        return false;\n"
+        << "    }\n"
+        << "    std::vector<int> stack;\n"
+        << "    stack.push_back(TOKEN_END);\n"
+        << "    stack.push_back(TOKEN_COUNT + " << start << ");\n"
+        << "    std::size_t position = 0;\n"
+        << "    while (!stack.empty()) {\n"
+        << "        int top = stack.back();\n"
+        << "        stack.pop_back();\n"
+        << "        if (top == TOKEN_END || position == count) {\n"
+        << "            bool accepted = position == count - 1 && top == tokens[position];\n"
+        << "            if (!accepted) report(callbacks, \"input is not accepted\", position);\n"
+        << "            return accepted;\n"
+        << "        }\n"
+        << "        int token = tokens[position];\n"
+        << "        if (top < TOKEN_COUNT) {\n"
+        << "            if (token == top) {\n"
+        << "                position++;\n"
+        << "            } else {\n"
+        << "                report(callbacks, \"missing \" + symbol_name(top) + \", inserted to the input\", position);\n"
+        << "            }\n"
+        << "            continue;\n"
+        << "        }\n"
+        << "        int non_terminal = top - TOKEN_COUNT;\n"
+        << "        int cell = token >= 0 && token < TOKEN_COUNT ? TABLE[non_terminal][token] : NO_ENTRY;\n"
+        << "        if (cell == NO_ENTRY) {\n"
+        << "            report(callbacks, \"illegal \" + symbol_name(top) + \", discard \" + token_text(token), position);\n"
+        << "            stack.push_back(top);\n"
+        << "            position++;\n"
+        << "        } else if (cell == SYNCH_ENTRY) {\n"
+        << "            report(callbacks, \"M[\" + symbol_name(top) + \", \" + token_text(token) + \"] = synch, \" + symbol_name(top) + \" has been popped\", position);\n"
+        << "        } else {\n"
+        << "            if (callbacks && callbacks->on_production) callbacks->on_production(non_terminal, cell, callbacks->user);\n"
+        << "            stack.insert(stack.end(), PRODUCTION_SYMBOLS + PRODUCTION_OFFSETS[cell], PRODUCTION_SYMBOLS + PRODUCTION_OFFSETS[cell + 1]);\n"
+        << "        }\n"
+        << "    }\n"
+        << "    return false;\n"
+        << "}\n\n"
+        << "}\n";
+}
+
+void ParserCodeGenerator::emit(const string &prefix) const {
+    string base = prefix.substr(prefix.find_last_of("/\\") + 1);
+    string name = identifierFor(base);
+    const pair<string, void (ParserCodeGenerator::*)(ostream &, const string &, const string &) const> outputs[] = {
+            {prefix + "_tokens.h", &ParserCodeGenerator::writeTokensHeader},
+            {prefix + "_parser.h", &ParserCodeGenerator::writeParserHeader},
+            {prefix + "_parser.cpp", &ParserCodeGenerator::writeParserSource},
+    };
+    for (const auto &output : outputs) {
+        ofstream output_file(output.first);
+        if (!output_file.is_open()) {
+            cerr << "Error: Could not open file "
+                 << output.first
+                 << " for writing." << endl;
+            return;
+        }
+        (this->*output.second)(output_file, name, base);
+        output_file.close();
+        cout << "Generated parser source written to " << output.first << endl;
+    }
+}
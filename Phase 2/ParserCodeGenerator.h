@@ -0,0 +1,43 @@
+#ifndef DFA_CPP_PARSERCODEGENERATOR_H
+#define DFA_CPP_PARSERCODEGENERATOR_H
+
+#include <string>
+#include <vector>
+#include <ostream>
+#include "CompiledGrammar.h"
+
+/**
+ * Emits a standalone C++ LL(1) parser from a compiled grammar: a token enum header shared with the scanner,
+ * and a parser made of static tables plus a small stack driver with the same panic mode recovery as Parser.
+ * The generated code has no dependency on this project and needs no table construction at startup.
+ */
+class ParserCodeGenerator {
+private:
+    const CompiledGrammar &compiled;
+    // Grammar symbol id -> generated terminal / non-terminal index (-1 if the symbol is not one)
+    std::vector<int> terminalIndex;
+    std::vector<int> nonTerminalIndex;
+    std::vector<int> terminals;
+    std::vector<int> nonTerminals;
+    std::vector<std::string> tokenEnumNames;
+
+    /** Returns a C++ identifier for a grammar symbol */
+    static std::string identifierFor(const std::string &symbol);
+    /** Returns a C++ string literal for a grammar symbol */
+    static std::string literalFor(const std::string &symbol);
+    /** The tokens header includes nothing, fileBase only keeps the signature shared by the writers */
+    void writeTokensHeader(std::ostream &out, const std::string &name, const std::string &fileBase) const;
+    void writeParserHeader(std::ostream &out, const std::string &name, const std::string &fileBase) const;
+    void writeParserSource(std::ostream &out, const std::string &name, const std::string &fileBase) const;
+
+public:
+    explicit ParserCodeGenerator(const CompiledGrammar &compiled);
+    /**
+     * Writes <prefix>_tokens.h, <prefix>_parser.h and <prefix>_parser.cpp.
+     * The generated code lives in a namespace named after the last path component of prefix.
+     */
+    void emit(const std::string &prefix) const;
+};
+
+
+#endif //DFA_CPP_PARSERCODEGENERATOR_H
@@ -4,14 +4,64 @@
 
 
 # include "ParserGenerator.h"
+# include "ParserCodeGenerator.h"
+# include "WorkStealingPool.h"
+# include "Stats.h"
 
 using namespace std;
 
-void ParserGenerator::generateParser(const vector<string>& input, const string &output_file_path) {
+ParserGenerator::ParserGenerator(const string &rules_file_path) {
+    // Reuse the compiled grammar if the rules file hasn't changed since it was cached
+    stats::ScopedTimer timer("parser.build");
+    uint64_t cacheKey = CompiledGrammar::keyFor(rules_file_path);
+    string cachePath = CompiledGrammar::pathFor(rules_file_path);
+    if (CompiledGrammar::load(cachePath, cacheKey, compiled)) {
+        cout << "Parser loaded from cache " << cachePath << endl;
+        stats::count("parser.cache_hits");
+        SymbolSet terminals = compiled.getTerminals();
+        SymbolSet grammarTerminals = terminals;
+        grammarTerminals.erase(ParsingTableGenerator::EPSILON);
+        grammarTerminals.erase(ParsingTableGenerator::END);
+        parserRulesReader.loadGrammar(compiled.getGrammar(), grammarTerminals,
+                                      compiled.getNonTerminals(), compiled.getStartSym());
+        generator = nullptr;
+        table = compiled.toParsingTable();
+        parser = new Parser(table, compiled.getStartSym(), terminals, compiled.getNonTerminals());
+        return;
+    }
+
+    parserRulesReader.readRules(rules_file_path);
+    generator = new ParsingTableGenerator(parserRulesReader.getGrammar(),
+                                           parserRulesReader.getTerminals(),
+                                           parserRulesReader.getNonTerminals(),
+                                       parserRulesReader.getStartingSymbol());
+    table = generator->getTable();
+    parser = new Parser(*generator);
+    compiled = CompiledGrammar(parserRulesReader.getGrammar(), generator->getTerminals(),
+                               generator->getNonTerminals(), generator->getStartSym(), table);
+    if (compiled.save(cachePath, cacheKey))
+        cout << "Parser cache written to " << cachePath << endl;
+}
+
+void ParserGenerator::generateParser(const vector<string>& input, const string &output_file_path) const {
     string derivation_path = output_file_path.substr(0, output_file_path.find_last_of('.')) + "_derivation.txt";
     parser->parse(input, derivation_path);
 }
 
+ParseResult ParserGenerator::generateParser(TokenStream& input, const string &output_file_path, bool quiet) const {
+    string derivation_path = output_file_path.substr(0, output_file_path.find_last_of('.')) + "_derivation.txt";
+    return parser->parse(input, derivation_path, quiet);
+}
+
+vector<ParseResult> ParserGenerator::parseBatch(const vector<vector<string>>& inputs, unsigned threads) const {
+    vector<ParseResult> results(inputs.size());
+    WorkStealingPool(threads).for_each(inputs.size(), [&](size_t index, unsigned) {
+        VectorTokenStream tokens(inputs[index]);
+        results[index] = parser->parse(tokens);
+    });
+    return results;
+}
+
 void ParserGenerator::printAll(const string &rules_file_path) {
     string grammar_file_path = rules_file_path.substr(0, rules_file_path.find_last_of('.')) + "_grammar.txt";
     string terminals_file_path = rules_file_path.substr(0, rules_file_path.find_last_of('.')) + "_terminals.txt";
@@ -21,4 +71,7 @@ void ParserGenerator::printAll(const string &rules_file_path) {
     parserRulesReader.printTerminals(terminals_file_path);
     parserRulesReader.printNonTerminals(non_terminals_file_path);
     table.printTable(parsing_table_file_path);
-}
\ No newline at end of file
+}
+void ParserGenerator::emitParser(const string &output_prefix) const {
+    ParserCodeGenerator(compiled).emit(output_prefix);
+}
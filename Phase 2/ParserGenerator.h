@@ -8,26 +8,29 @@
 #include "ParserRulesReader.h"
 #include "ParsingTableGenerator.h"
 #include "Parser.h"
+#include "CompiledGrammar.h"
 
 class ParserGenerator {
 private:
     ParserRulesReader parserRulesReader;
     ParsingTableGenerator* generator;
     ParsingTable table;
+    CompiledGrammar compiled;
     Parser* parser;
 
 public:
-    ParserGenerator(const std::string &rules_file_path){
-        parserRulesReader.readRules(rules_file_path);
-        generator = new ParsingTableGenerator(parserRulesReader.getGrammar(),
-                                               parserRulesReader.getTerminals(),
-                                               parserRulesReader.getNonTerminals(),
-                                           parserRulesReader.getStartingSymbol());
-        table = generator->getTable();
-        parser = new Parser(*generator);
-    }
-    void generateParser(const std::vector<string>& input, const std::string &derivation_path);
+    /** Builds (or loads from the compile cache) the LL(1) table for a rules file */
+    ParserGenerator(const std::string &rules_file_path);
+    void generateParser(const std::vector<string>& input, const std::string &derivation_path) const;
+    /** Parses tokens while they are still being produced, e.g. by a lexer on another thread */
+    ParseResult generateParser(TokenStream& input, const std::string &derivation_path, bool quiet = false) const;
+    /** Parses independent token lists in parallel on a work stealing pool (0 threads = one per core) */
+    std::vector<ParseResult> parseBatch(const std::vector<std::vector<std::string>>& inputs, unsigned threads = 0) const;
+    /** The parser only holds the table, so it can be shared by any number of threads */
+    const Parser& getParser() const { return *parser; }
     void printAll(const std::string &rules_file_path);
+    /** Emits a standalone table driven C++ parser (see ParserCodeGenerator) with the given path prefix */
+    void emitParser(const std::string &output_prefix) const;
 };
 
 
@@ -3,6 +3,8 @@
 //
 
 #include "ParserRulesReader.h"
+#include "Stats.h"
+#include "OutputWriter.h"
 #include <fstream>
 #include <iostream>
 #include <regex>
@@ -11,6 +13,7 @@
 ParserRulesReader::ParserRulesReader() = default;
 
 void ParserRulesReader::readRules(string rulesFilePath) {
+    stats::ScopedTimer timer("parser.read_rules");
     this->rulesFilePath = std::move(rulesFilePath);
     readRulesFile();
     bool notLL1 = generateLL1Grammar();
@@ -24,6 +27,13 @@ void ParserRulesReader::readRules(string rulesFilePath) {
 
 }
 
+void ParserRulesReader::loadGrammar(Grammar g, SymbolSet t, SymbolSet nt, string startSym) {
+    grammar = std::move(g);
+    terminals = std::move(t);
+    nonTerminals = std::move(nt);
+    startingSymbol = std::move(startSym);
+}
+
 void ParserRulesReader::readRulesFile() {
     std::ifstream file(rulesFilePath);
     if (!file.is_open()) {
@@ -293,7 +303,7 @@ void ParserRulesReader::printGrammar() {
 }
 
 void ParserRulesReader::printGrammar(const string &grammar_file_path) {
-    ofstream output_file(grammar_file_path);
+    OutputWriter output_file(grammar_file_path);
     if (!output_file.is_open()) {
         cerr << "Error: Could not open file "
              << grammar_file_path
@@ -301,8 +311,8 @@ void ParserRulesReader::printGrammar(const string &grammar_file_path) {
         return;
     }
 
-    output_file << "Start Symbol: " << startingSymbol << endl;
-    output_file << "Grammar:" << endl;
+    output_file << "Start Symbol: " << startingSymbol << '\n';
+    output_file << "Grammar:\n";
     for (auto const& entry : grammar) {
         output_file << entry.first << " -> ";
         for (auto const& rule : entry.second) {
@@ -311,7 +321,7 @@ void ParserRulesReader::printGrammar(const string &grammar_file_path) {
             }
             output_file << "| ";
         }
-        output_file << endl;
+        output_file << '\n';
     }
     cout << "Grammar written to " << grammar_file_path << endl;
     output_file.close();
@@ -325,7 +335,7 @@ void ParserRulesReader::printTerminals() {
 }
 
 void ParserRulesReader::printTerminals(const string &terminals_file_path) {
-    ofstream output_file(terminals_file_path);
+    OutputWriter output_file(terminals_file_path);
     if (!output_file.is_open()) {
         cerr << "Error: Could not open file "
              << terminals_file_path
@@ -333,9 +343,9 @@ void ParserRulesReader::printTerminals(const string &terminals_file_path) {
         return;
     }
 
-    output_file << "Terminals: " << endl;
+    output_file << "Terminals: \n";
     for (auto const& terminal : terminals) {
-        output_file << terminal << endl;
+        output_file << terminal << '\n';
     }
     cout << "Terminals written to " << terminals_file_path << endl;
     output_file.close();
@@ -349,7 +359,7 @@ void ParserRulesReader::printNonTerminals() {
 }
 
 void ParserRulesReader::printNonTerminals(const string &non_terminals_file_path) {
-    ofstream output_file(non_terminals_file_path);
+    OutputWriter output_file(non_terminals_file_path);
     if (!output_file.is_open()) {
         cerr << "Error: Could not open file "
              << non_terminals_file_path
@@ -357,9 +367,9 @@ void ParserRulesReader::printNonTerminals(const string &non_terminals_file_path)
         return;
     }
 
-    output_file << "Non-Terminals: " << endl;
+    output_file << "Non-Terminals: \n";
     for (auto const& nonTerminal : nonTerminals) {
-        output_file << nonTerminal << endl;
+        output_file << nonTerminal << '\n';
     }
     cout << "Non-Terminals written to " << non_terminals_file_path << endl;
     output_file.close();
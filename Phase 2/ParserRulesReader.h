@@ -28,6 +28,8 @@ public:
     explicit ParserRulesReader();
     /** Reads the rules from the file and generates the grammar and the terminals and non-terminals */
     void readRules(string rulesFilePath);
+    /** Restores an already transformed grammar (e.g. from the compile cache) instead of reading a rules file */
+    void loadGrammar(Grammar g, SymbolSet t, SymbolSet nt, string startSym);
     /** Prints the grammar */
     void printGrammar();
     void printGrammar(const std::string &grammar_file_path);
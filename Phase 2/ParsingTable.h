@@ -9,6 +9,7 @@
 #include <iostream>
 #include <fstream>
 #include "ParsingDataStructs.h"
+#include "OutputWriter.h"
 
 class ParsingTable {
 private:
@@ -57,20 +58,20 @@ public:
     }
 
     void printTable(const std::string &non_terminals_file_path){
-        std::ofstream output_file(non_terminals_file_path);
+        OutputWriter output_file(non_terminals_file_path);
         if (!output_file.is_open()) {
             std::cerr << "Error: Could not open file "
                  << non_terminals_file_path
                  << " for writing." << std::endl;
             return;
         }
-        output_file << "Parsing Table:" << std::endl;
+        output_file << "Parsing Table:\n";
         for (auto i : table){
             output_file << i.first << " -> ";
             for (auto j : i.second){
                 output_file << j << " ";
             }
-            output_file << std::endl;
+            output_file << '\n';
         }
         std::cout << "Parsing Table written to " << non_terminals_file_path << std::endl;
         output_file.close();
@@ -1,4 +1,5 @@
 #include "ParsingTableGenerator.h"
+#include "Stats.h"
 using namespace std;
 
 // Define constants
@@ -127,6 +128,7 @@ bool ParsingTableGenerator::updateFollow(const string &lhs, const vector<string>
 
 // Compute the parsing table
 void ParsingTableGenerator::computeTable() {
+    stats::ScopedTimer timer("parser.compute_table");
 
     // Compute FIRST and FOLLOW sets for all symbols if not already computed
     if (firstSets.empty()) getFirstSets();
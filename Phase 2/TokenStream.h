@@ -0,0 +1,73 @@
+#ifndef DFA_CPP_TOKENSTREAM_H
+#define DFA_CPP_TOKENSTREAM_H
+
+#include <string>
+#include <vector>
+#include "SpscRing.h"
+#include "TokenFile.h"
+
+/**
+ * Source of token names for the parser. The parser pulls one token at a time, so it can run
+ * on a token list that already exists or concurrently with the lexer producing it.
+ */
+class TokenStream {
+public:
+    virtual ~TokenStream() = default;
+    /** Stores the next token in token. Returns false at the end of the input */
+    virtual bool next(std::string &token) = 0;
+};
+
+/** Tokens that were already scanned into a vector */
+class VectorTokenStream : public TokenStream {
+private:
+    const std::vector<std::string> &tokens;
+    size_t position = 0;
+
+public:
+    explicit VectorTokenStream(const std::vector<std::string> &tokens) : tokens(tokens) {}
+
+    bool next(std::string &token) override {
+        if (position == tokens.size()) return false;
+        token = tokens[position++];
+        return true;
+    }
+};
+
+/** Tokens handed over by a lexer running on another thread */
+class RingTokenStream : public TokenStream {
+private:
+    SpscRing<std::string> &ring;
+
+public:
+    explicit RingTokenStream(SpscRing<std::string> &ring) : ring(ring) {}
+
+    bool next(std::string &token) override {
+        return ring.pop(token);
+    }
+};
+
+/** Tokens of a binary token file written by an earlier scan, read from its memory map */
+class TokenFileStream : public TokenStream {
+private:
+    const TokenFile &file;
+    TokenFile::Cursor cursor;
+    bool ended = false;
+
+public:
+    explicit TokenFileStream(const TokenFile &file) : file(file), cursor(file) {}
+
+    /** Ends with the "$" the parser expects after the last token */
+    bool next(std::string &token) override {
+        TokenFile::Token record;
+        if (cursor.next(record)) {
+            token = file.names()[record.name];
+            return true;
+        }
+        if (ended) return false;
+        ended = true;
+        token = "$";
+        return true;
+    }
+};
+
+#endif //DFA_CPP_TOKENSTREAM_H
@@ -0,0 +1,128 @@
+#include <iostream>
+#include "Daemon.h"
+#include "BinaryFile.h"
+#include "UnixSocket.h"
+#include <bits/stdc++.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+using namespace std;
+
+void custom_assert(bool condition, string message) {
+    if (!condition) throw runtime_error(message);
+}
+
+// Rules and grammar written by the tests, and the files the generators leave next to them
+const string LEXER_RULES = "daemon_test_lexer.txt";
+const string GRAMMAR = "daemon_test_grammar.txt";
+const string SOCKET = "daemon_test.sock";
+const vector<string> GENERATED = {"daemon_test_lexer_Token_IDs.txt", "daemon_test_lexer_DFA_cache.bin",
+                                  "daemon_test_lexer_minimized_DFA.txt", "daemon_test_grammar_LL1_cache.bin"};
+
+void clean_up() {
+    for (const string& file : {LEXER_RULES, GRAMMAR, SOCKET}) remove(file.c_str());
+    for (const string& file : GENERATED) remove(file.c_str());
+}
+
+/** Connects to the daemon, waiting for it to listen */
+UnixSocket connect_to_daemon() {
+    for (int attempt = 0;; attempt++) {
+        try {
+            return UnixSocket::connect(SOCKET);
+        } catch (const exception&) {
+            if (attempt == 100) throw;
+            this_thread::sleep_for(chrono::milliseconds(50));
+        }
+    }
+}
+
+/** Runs work on another thread and returns whether it finished within ten seconds; if not, leaves it running */
+bool finishes(const function<void()>& work) {
+    auto done = make_shared<promise<void>>();
+    future<void> finished = done->get_future();
+    thread([work, done]() {
+        work();
+        done->set_value();
+    }).detach();
+    return finished.wait_for(chrono::seconds(10)) == future_status::ready;
+}
+
+/** Token lexemes of a TOKENIZE reply */
+vector<string> lexemes(const UnixSocket& daemon) {
+    uint8_t kind;
+    string reply;
+    custom_assert(daemon.receive_frame(kind, reply) && kind == Daemon::OK, "No tokens in the reply.");
+    BinaryReader reader(reply.data(), reply.size());
+    vector<string> names(reader.read_u32());
+    for (string& name : names) name = reader.read_string();
+    vector<string> result(reader.read_u32());
+    for (string& lexeme : result) {
+        reader.read_u32();
+        lexeme = reader.read_string();
+    }
+    return result;
+}
+
+
+// A client that stops inside a frame holds no worker: with one worker, other requests and SHUTDOWN are answered
+void test_1(const Daemon& daemon) {
+    auto served = make_shared<promise<int>>();
+    future<int> status = served->get_future();
+    thread([&daemon, served]() { served->set_value(daemon.serve(SOCKET)); }).detach();
+    UnixSocket client = connect_to_daemon();
+    // One byte of a frame header, then nothing
+    int stalled = socket(AF_UNIX, SOCK_STREAM, 0);
+    sockaddr_un address{};
+    address.sun_family = AF_UNIX;
+    strcpy(address.sun_path, SOCKET.c_str());
+    custom_assert(connect(stalled, reinterpret_cast<sockaddr*>(&address), sizeof(address)) == 0,
+                  "Test 1 failed: no connection.");
+    custom_assert(write(stalled, "\x01", 1) == 1, "Test 1 failed: nothing sent.");
+    this_thread::sleep_for(chrono::milliseconds(200));
+
+    vector<string> tokens;
+    bool answered = finishes([&]() {
+        client.send_frame(Daemon::TOKENIZE, "x 12 y");
+        tokens = lexemes(client);
+    });
+    custom_assert(answered, "Test 1 failed: request waited on the stalled client.");
+    custom_assert(tokens == vector<string>({"x", "12", "y"}), "Test 1 failed: wrong tokens.");
+    client.send_frame(Daemon::SHUTDOWN, "");
+    custom_assert(status.wait_for(chrono::seconds(10)) == future_status::ready,
+                  "Test 1 failed: SHUTDOWN waited on the stalled client.");
+    custom_assert(status.get() == 0, "Test 1 failed: daemon failed.");
+    // The daemon closed the stalled connection too
+    char byte;
+    custom_assert(read(stalled, &byte, 1) == 0, "Test 1 failed: stalled connection left open.");
+    close(stalled);
+    cout << "Test 1 passed." << endl;
+}
+
+
+// Requests sent together are answered in order, the second from the bytes left over by the first
+void test_2(const Daemon& daemon) {
+    thread server([&]() { daemon.serve(SOCKET); });
+    UnixSocket client = connect_to_daemon();
+    client.send_frame(Daemon::TOKENIZE, "a b");
+    client.send_frame(Daemon::TOKENIZE, "7");
+    custom_assert(lexemes(client) == vector<string>({"a", "b"}), "Test 2 failed: first reply.");
+    custom_assert(lexemes(client) == vector<string>({"7"}), "Test 2 failed: second reply.");
+    client.send_frame(Daemon::SHUTDOWN, "");
+    server.join();
+    cout << "Test 2 passed." << endl;
+}
+
+int main() {
+    ofstream(LEXER_RULES) << "letter = a-z\ndigit = 0 - 9\nid: letter (letter|digit)*\nnum: digit+";
+    ofstream(GRAMMAR) << "# LIST ::= 'id' LIST | 'num' LIST | '\\L'";
+    {
+        LexicalAnalyzer lexical_analyzer(LEXER_RULES, GENERATED[2]);
+        ParserGenerator parserGenerator(GRAMMAR);
+        Daemon daemon(lexical_analyzer, parserGenerator, 1);
+        test_1(daemon);
+        test_2(daemon);
+    }
+    clean_up();
+    return 0;
+}